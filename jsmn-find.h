@@ -15,6 +15,9 @@ extern "C" {
 #include "oa_hash.h"
 #undef OA_HASH_HEADER
 
+#include <limits.h>
+#include <stdint.h>
+
 #define JSMNF_PAIR_ATTRS_const                                                \
     /** JSON object or array pair attributes */                               \
     OA_HASH_ATTRS(const);                                                     \
@@ -23,7 +26,9 @@ extern "C" {
     /** key attributes */                                                     \
     const jsmntok_t *const k;                                                 \
     /** value attribute */                                                    \
-    const jsmntok_t *const v
+    const jsmntok_t *const v;                                                 \
+    /** @ref jsmnf_pair_flags bitmask */                                      \
+    const unsigned flags
 #define JSMNF_PAIR_ATTRS_mut                                                  \
     /** JSON object or array pair attributes */                               \
     OA_HASH_ATTRS(mut);                                                       \
@@ -32,22 +37,54 @@ extern "C" {
     /** key attributes */                                                     \
     jsmntok_t *k;                                                             \
     /** value attribute */                                                    \
-    jsmntok_t *v
+    jsmntok_t *v;                                                             \
+    /** @ref jsmnf_pair_flags bitmask */                                      \
+    unsigned flags
 #define JSMNF_PAIR_ATTRS(_qualifier) JSMNF_PAIR_ATTRS_##_qualifier
 
 typedef struct jsmnf_pair {
     JSMNF_PAIR_ATTRS(const);
 } jsmnf_pair;
 
+/** @brief @ref jsmnf_pair flags, set by the loaders */
+enum jsmnf_pair_flags {
+    /** key string contains escape sequences */
+    JSMNF_KEY_ESCAPED = 1 << 0,
+    /** value string contains escape sequences */
+    JSMNF_VALUE_ESCAPED = 1 << 1
+};
+
+/** @brief Allocator hooks, see jsmnf_init_allocator() */
+typedef struct jsmnf_allocator {
+    /** allocate `size` bytes, or return NULL */
+    void *(*alloc)(void *ctx, size_t size);
+    /** resize `ptr` from `old_size` to `new_size` bytes, or return NULL and
+     *      leave `ptr` untouched */
+    void *(*resize)(void *ctx, void *ptr, size_t old_size, size_t new_size);
+    /** release `ptr`, which may be NULL */
+    void (*release)(void *ctx, void *ptr);
+    /** user context given to the hooks */
+    void *ctx;
+} jsmnf_allocator;
+
 /** @brief Bucket @ref jsmnf_pair loader, keeps track of pair array
  *      position */
 typedef struct jsmnf_loader {
     /** jsmnf_loader can be cast to jsmn_parser */
     jsmn_parser parser;
     /** next pair to allocate */
-    unsigned pairnext;
+    size_t pairnext;
     /** root pair */
     const jsmnf_pair *root;
+    /** optional arena for unescaped object keys, see jsmnf_init_keys() */
+    char *keys;
+    /** key arena size */
+    size_t keys_len;
+    /** next key arena byte to allocate */
+    size_t keysnext;
+    /** allocator of the allocating entry points, see
+     *      jsmnf_init_allocator() */
+    const jsmnf_allocator *allocator;
 } jsmnf_loader;
 
 /** @brief JSON table, not supposed to be accessed by user */
@@ -58,6 +95,23 @@ typedef struct jsmnf_table {
     const struct oa_hash_entry ___;
 } jsmnf_table;
 
+/** @brief Pairs storage for tokens kept apart from a @ref jsmnf_table, not
+ *      supposed to be accessed by user */
+typedef struct jsmnf_index {
+    /** @private */
+    const struct jsmnf_pair _;
+    const struct oa_hash_entry __;
+} jsmnf_index;
+
+/** @brief Key path to be kept by jsmnf_load_projected() */
+typedef struct jsmnf_keypath {
+    /** array of key path strings, from least to highest depth, array
+     *      indexes are given as decimal strings and `"*"` matches any key */
+    char *const *keys;
+    /** the depth level of the last `keys` key */
+    unsigned depth;
+} jsmnf_keypath;
+
 /**
  * @brief Initialize a @ref jsmnf_loader
  *
@@ -65,6 +119,38 @@ typedef struct jsmnf_table {
  */
 JSMN_API void jsmnf_init(jsmnf_loader *loader);
 
+/**
+ * @brief Provide an arena for unescaped object keys
+ *
+ * Keys containing escape sequences are unescaped into `keys` as they are
+ *      loaded, so that jsmnf_find() matches them by their unescaped form,
+ *      without an arena they are matched by their raw bytes instead
+ * @note an arena as large as the JSON string is always enough
+ * @note keys that are duplicates once unescaped match the last member, as
+ *      with jsmnf_find()
+ *
+ * @param[in,out] loader the @ref jsmnf_loader initialized with jsmnf_init()
+ * @param[in] keys the key arena, must outlive the loaded pairs
+ * @param[in] size the key arena size
+ */
+JSMN_API void jsmnf_init_keys(jsmnf_loader *loader,
+                              char keys[],
+                              size_t size);
+
+/**
+ * @brief Route the allocations made on behalf of a loader to `allocator`
+ *
+ * Loaders default to `JSMNF_MALLOC()`, `JSMNF_REALLOC()` and `JSMNF_FREE()`,
+ *      which are `malloc()`, `realloc()` and `free()` unless defined
+ *      otherwise before including the implementation
+ *
+ * @param[in,out] loader the @ref jsmnf_loader initialized with jsmnf_init()
+ * @param[in] allocator the allocator hooks, must outlive `loader`, or NULL
+ *      for the default allocator
+ */
+JSMN_API void jsmnf_init_allocator(jsmnf_loader *loader,
+                                   const jsmnf_allocator *allocator);
+
 /**
  * @brief Populate the @ref jsmnf_pair pairs from jsmn tokens
  *
@@ -83,9 +169,62 @@ JSMN_API long jsmnf_load(jsmnf_loader *loader,
                          jsmnf_table table[],
                          const size_t table_len);
 
+/**
+ * @brief Populate the @ref jsmnf_pair pairs of the JSON subtrees selected by
+ *      a projection only
+ *
+ * Subtrees that aren't part of a `paths` key path are skipped without
+ *      consuming pairs, a matched key path keeps its whole subtree and its
+ *      ancestors keep only the matched members
+ * @note array elements outside of the projection are kept as empty slots
+ *      (`v` is `NULL`) so that indexes are preserved
+ *
+ * @param[in,out] loader the @ref jsmnf_loader initialized with jsmnf_init()
+ * @param[in] js the JSON data string
+ * @param[in] tokens jsmn tokens parsed from `js`, must outlive `index`
+ * @param[in] num_tokens amount of tokens
+ * @param[in] paths the key paths to be kept, or `NULL` to keep everything
+ * @param[in] num_paths amount of key paths
+ * @param[out] index jsmnf_index pairs array
+ * @param[in] index_len maximum amount of pairs provided
+ * @return a `enum jsmnerr` value for error or the amount of `pairs` used
+ */
+JSMN_API long jsmnf_load_projected(jsmnf_loader *loader,
+                                   const char js[],
+                                   const jsmntok_t tokens[],
+                                   const unsigned num_tokens,
+                                   const jsmnf_keypath paths[],
+                                   const unsigned num_paths,
+                                   jsmnf_index index[],
+                                   const size_t index_len);
+
+/**
+ * @brief Populate the @ref jsmnf_pair pairs of already parsed jsmn tokens
+ *
+ * Unlike jsmnf_load() the tokens are kept apart from the pairs, so tokens
+ *      from jsmn_parse_auto() can be indexed without being parsed again,
+ *      and either storage can grow without moving the other
+ *
+ * @param[in,out] loader the @ref jsmnf_loader initialized with jsmnf_init()
+ * @param[in] js the JSON data string
+ * @param[in] tokens jsmn tokens parsed from `js`, must outlive `index`
+ * @param[in] num_tokens amount of tokens
+ * @param[out] index jsmnf_index pairs array
+ * @param[in] index_len maximum amount of pairs provided
+ * @return a `enum jsmnerr` value for error or the amount of `pairs` used
+ */
+JSMN_API long jsmnf_load_tokens(jsmnf_loader *loader,
+                                const char js[],
+                                const jsmntok_t tokens[],
+                                const unsigned num_tokens,
+                                jsmnf_index index[],
+                                const size_t index_len);
+
 /**
  * @brief Find a @ref jsmnf_pair token by its associated key
  *
+ * @note duplicate keys match the last member, and empty keys are kept in
+ *      `head->fields` but never matched
  * @param[in] head a @ref jsmnf_pair object or array loaded at jsmnf_init()
  * @param[in] key the key too be matched
  * @param[in] length length of the key too be matched
@@ -119,7 +258,9 @@ JSMN_API const jsmnf_pair *jsmnf_find_path(const jsmnf_pair *const head,
  * @param[in] js the JSON data string
  * @param[in] len the raw JSON string length
  * @param[out] p_table pointer to @ref jsmnf_table to be dynamically increased
- *      @note must be `free()`'d once done being used
+ *      with the loader's allocator
+ *      @note must be released with the loader's allocator once done being
+ *      used
  * @param[in,out] table_len maximum amount of pairs provided
  * @return a `enum jsmnerr` value for error or the amount of `pairs` used
  */
@@ -129,6 +270,70 @@ JSMN_API long jsmnf_load_auto(jsmnf_loader *loader,
                               jsmnf_table **p_table,
                               size_t *num_pairs);
 
+/**
+ * @brief jsmnf_load_tokens() counterpart that automatically allocates the
+ *      necessary amount of pairs
+ *
+ * @param[in,out] loader the @ref jsmnf_loader initialized with jsmnf_init()
+ * @param[in] js the JSON data string
+ * @param[in] tokens jsmn tokens parsed from `js`, must outlive `*p_index`
+ * @param[in] num_tokens amount of tokens
+ * @param[out] p_index pointer to @ref jsmnf_index to be dynamically
+ *      increased with the loader's allocator
+ *      @note must be released with the loader's allocator once done being
+ *      used
+ * @param[in,out] index_len maximum amount of pairs provided
+ * @return a `enum jsmnerr` value for error or the amount of `pairs` used
+ */
+JSMN_API long jsmnf_load_tokens_auto(jsmnf_loader *loader,
+                                     const char js[],
+                                     const jsmntok_t tokens[],
+                                     const unsigned num_tokens,
+                                     jsmnf_index **p_index,
+                                     size_t *index_len);
+
+/**
+ * @brief jsmnf_load_auto() counterpart that tokenizes and indexes a file
+ *      straight from a read-only memory mapping
+ *
+ * The mapping is hinted for sequential access while it's being tokenized,
+ *      no NUL-terminator is needed as the JSON string is never read past
+ *      its length
+ * @note where mmap() is unavailable, or with `JSMNF_NO_MMAP` defined, the
+ *      file is read into memory from the loader's allocator instead
+ *
+ * @param[in,out] loader the @ref jsmnf_loader initialized with jsmnf_init()
+ * @param[in] path the JSON file to be loaded
+ * @param[out] p_js the mapped JSON string
+ * @param[out] p_len the mapped JSON string length
+ * @param[out] p_table pointer to @ref jsmnf_table to be dynamically increased
+ *      with the loader's allocator
+ *      @note must be jsmnf_close_file()'d once done being used, even if the
+ *      file fails to load
+ * @param[in,out] table_len maximum amount of pairs provided
+ * @return a `enum jsmnerr` value for error or the amount of `pairs` used,
+ *      `JSMNF_ERROR_IO` if the file couldn't be read
+ */
+JSMN_API long jsmnf_load_file(jsmnf_loader *loader,
+                              const char path[],
+                              const char **p_js,
+                              size_t *p_len,
+                              jsmnf_table **p_table,
+                              size_t *table_len);
+
+/**
+ * @brief Unmap a file loaded by jsmnf_load_file() and free its table
+ *
+ * @param[in] loader the @ref jsmnf_loader given to jsmnf_load_file()
+ * @param[in] js the mapped JSON string, or NULL if the file failed to load
+ * @param[in] len the mapped JSON string length
+ * @param[in] table the @ref jsmnf_table to be freed
+ */
+JSMN_API void jsmnf_close_file(jsmnf_loader *loader,
+                               const char js[],
+                               size_t len,
+                               jsmnf_table *table);
+
 /**
  * @brief `jsmn_parse()` counterpart that automatically allocates the necessary
  *      amount of tokens necessary for parsing the JSON string
@@ -137,7 +342,8 @@ JSMN_API long jsmnf_load_auto(jsmnf_loader *loader,
  * @param[in] js the JSON data string
  * @param[in] len the raw JSON string length
  * @param[out] p_tokens pointer to `jsmntok_t` to be dynamically increased
- *      @note must be `free()`'d once done being used
+ *      with the default allocator
+ *      @note must be `JSMNF_FREE()`'d once done being used
  * @param[in,out] num_tokens amount of tokens
  * @return a `enum jsmnerr` value for error or the amount of `tokens` used
  */
@@ -162,515 +368,6492 @@ JSMN_API long jsmnf_unescape(char buf[],
                              const char src[],
                              size_t length);
 
-#ifndef JSMN_HEADER
+/**
+ * @brief Validate a UTF-8 string
+ *
+ * @param[in] src source string to be validated, such as a raw string token
+ * @param[in] length source string length
+ * @return `length` if valid or `JSMN_ERROR_INVAL` otherwise
+ */
+JSMN_API long jsmnf_utf8_validate(const char src[], size_t length);
 
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
+/**
+ * @brief Unescape a string token in place, unescaped strings are never longer
+ *      than their escaped form
+ *
+ * The token's `end` is updated to the unescaped length, bytes left between
+ *      the new and the previous `end` are unspecified
+ * @note on failure the token's bytes may have been partially rewritten
+ *
+ * @param[in,out] js the mutable JSON data string
+ * @param[in,out] tok string token within `js`
+ * @return length of unescaped string if successful or a negative jsmn error
+ *      code on failure
+ */
+JSMN_API long jsmnf_unescape_inplace(char js[], jsmntok_t *tok);
 
-#define OA_HASH_STATIC
-#include "oa_hash.h"
-#undef OA_HASH_STATIC
+/**
+ * @brief Unescape in place every string key and value of a loaded document
+ *
+ * Objects whose keys are changed get their fields rehashed, so that
+ *      jsmnf_find() matches the unescaped keys afterwards
+ * @note strings without escape sequences are neither scanned nor UTF-8
+ *      validated, see jsmnf_utf8_validate()
+ *
+ * @param[in,out] loader the @ref jsmnf_loader populated by a successful load
+ * @param[in,out] js the mutable JSON data string the document was loaded from
+ * @return a `enum jsmnerr` value for error or the amount of strings unescaped
+ */
+JSMN_API long jsmnf_unescape_all(jsmnf_loader *loader, char js[]);
 
-struct _jsmnf_pair_mut {
-    JSMNF_PAIR_ATTRS(mut);
+/**
+ * @brief Check whether a pair's value can be used as-is, with no unescaping
+ *
+ * @param[in] pair the @ref jsmnf_pair to be checked
+ * @return non-zero if the value isn't a string with escape sequences
+ */
+JSMN_API int jsmnf_is_raw(const jsmnf_pair *pair);
+
+/** @brief JSONPath query opcodes, see jsmnf_query_compile() */
+enum jsmnf_query_opcode {
+    /** match object member by name (`.name` or `['name']`) */
+    JSMNF_QUERY_NAME = 0,
+    /** match array element by index (`[n]`, negative counts from the end) */
+    JSMNF_QUERY_INDEX,
+    /** match every object member or array element (`.*` or `[*]`) */
+    JSMNF_QUERY_WILDCARD,
+    /** apply the next opcode to the node and all its descendants (`..`) */
+    JSMNF_QUERY_DESCEND,
+    /** match the children that satisfy a filter (`[?(@.key op value)]`) */
+    JSMNF_QUERY_FILTER
 };
 
-JSMN_API void
-jsmnf_init(jsmnf_loader *loader)
-{
-    jsmn_init(&loader->parser);
-    loader->pairnext = 0;
-}
+/** @brief JSONPath filter comparison operators */
+enum jsmnf_query_cmp {
+    /** no comparison, check for `@.key` existence only */
+    JSMNF_QUERY_EXISTS = 0,
+    JSMNF_QUERY_EQ, /**< `==` */
+    JSMNF_QUERY_NE, /**< `!=` */
+    JSMNF_QUERY_LT, /**< `<` */
+    JSMNF_QUERY_LE, /**< `<=` */
+    JSMNF_QUERY_GT, /**< `>` */
+    JSMNF_QUERY_GE /**< `>=` */
+};
 
-static long
-_jsmnf_load_pairs(struct jsmnf_loader *loader,
-                  const char js[],
-                  struct _jsmnf_pair_mut *curr,
-                  const size_t num_tokens,
-                  struct _jsmnf_pair_mut pairs[],
-                  struct oa_hash_entry buckets[],
-                  const size_t table_len)
-{
-    int offset = 0;
+/** @brief Compiled JSONPath instruction, spans point to the expression
+ *      given to jsmnf_query_compile() */
+typedef struct jsmnf_query_op {
+    /** instruction opcode */
+    enum jsmnf_query_opcode code;
+    /** member name for @ref JSMNF_QUERY_NAME, or dot-separated member path
+     *      relative to `@` for @ref JSMNF_QUERY_FILTER */
+    const char *key;
+    /** `key` length */
+    size_t key_len;
+    /** element index for @ref JSMNF_QUERY_INDEX */
+    long index;
+    /** comparison operator for @ref JSMNF_QUERY_FILTER */
+    enum jsmnf_query_cmp cmp;
+    /** literal compared against for @ref JSMNF_QUERY_FILTER, JSON strings
+     *      are kept without their quotes */
+    const char *literal;
+    /** `literal` length */
+    size_t literal_len;
+    /** whether `literal` is a string */
+    int literal_is_string;
+} jsmnf_query_op;
 
-    if (!num_tokens) return 0;
+/**
+ * @brief Compile a JSONPath expression subset into a sequence of
+ *      @ref jsmnf_query_op instructions
+ *
+ * Supports `$`, `.name`, `['name']`, `[n]`, `.*`, `[*]`, `..` and
+ *      `[?(@.key op value)]` filters, where `op` is one of `==`, `!=`, `<`,
+ *      `<=`, `>`, `>=` and `value` a number, string, `true`, `false` or
+ *      `null` (the comparison may be omitted to check for existence)
+ *
+ * @param[in] expr the JSONPath expression, must outlive `ops`
+ * @param[in] len the expression length
+ * @param[out] ops the compiled instructions
+ * @param[in] max_ops maximum amount of instructions provided
+ * @return a `enum jsmnerr` value for error or the amount of `ops` used
+ */
+JSMN_API long jsmnf_query_compile(const char expr[],
+                                  size_t len,
+                                  jsmnf_query_op ops[],
+                                  size_t max_ops);
 
-    switch (curr->v->type) {
-    case JSMN_STRING:
-    case JSMN_PRIMITIVE:
-        break;
-    case JSMN_OBJECT:
-    case JSMN_ARRAY: {
-        const unsigned value_size = (unsigned)curr->v->size,
-                       top_idx = loader->pairnext + (1 + value_size),
-                       bottom_idx = loader->pairnext;
-        int ret;
+/**
+ * @brief Evaluate compiled JSONPath instructions against a loaded tree
+ *
+ * @param[in] ops instructions compiled with jsmnf_query_compile()
+ * @param[in] num_ops amount of instructions
+ * @param[in] root the @ref jsmnf_pair the expression's `$` refers to
+ * @param[in] js the JSON data string, used by filter comparisons
+ * @param[out] results matched pairs in document order, may be `NULL` for
+ *      counting matches only
+ * @param[in] max_results maximum amount of results provided
+ * @return a `enum jsmnerr` value for error or the amount of `results` matched
+ */
+JSMN_API long jsmnf_query(const jsmnf_query_op ops[],
+                          size_t num_ops,
+                          const jsmnf_pair *root,
+                          const char js[],
+                          const jsmnf_pair *results[],
+                          size_t max_results);
 
-        if (value_size > (table_len - bottom_idx)
-            || top_idx > (table_len - bottom_idx))
-        {
-            return JSMN_ERROR_NOMEM;
-        }
+/** @brief Forward-only cursor over the raw JSON bytes, values are only
+ *      tokenized once loaded with jsmnf_cursor_load()
+ * @note the cursor refers to itself and must not be copied */
+typedef struct jsmnf_cursor {
+    /** the JSON data string */
+    const char *js;
+    /** the raw JSON string length */
+    size_t len;
+    /** current position in `js` */
+    size_t pos;
+    /** nesting level of the current value */
+    unsigned depth;
+    /** whether the current value has been stepped over */
+    int consumed;
+    /** key of the current value, zeroed for array elements and the root */
+    jsmntok_t key;
+    /** current value, `end` is `-1` for objects and arrays until they are
+     *      skipped or loaded, `size` is only known once they are loaded */
+    jsmntok_t tok;
+    /** current value as a pair, for use with the @ref jsmnf_pair helpers */
+    const jsmnf_pair pair;
+} jsmnf_cursor;
 
-        loader->pairnext = top_idx;
+/**
+ * @brief Initialize a @ref jsmnf_cursor positioned at the root value
+ *
+ * @param[out] cursor jsmnf_cursor to be initialized
+ * @param[in] js the JSON data string
+ * @param[in] len the raw JSON string length
+ * @return a `enum jsmnerr` value for error, `1` if positioned at the root
+ *      value or `0` if `js` is empty
+ */
+JSMN_API long jsmnf_cursor_init(jsmnf_cursor *cursor,
+                                const char js[],
+                                const size_t len);
 
-        oa_hash_init((struct oa_hash *)curr, &buckets[bottom_idx],
-                     top_idx - bottom_idx);
-        if (curr == NULL) {
-            abort();
-        }
-        if (JSMN_OBJECT == curr->v->type) {
-            while (curr->length < value_size) {
-                struct _jsmnf_pair_mut *fields = pairs + bottom_idx,
-                                       *element = fields + curr->length;
-                element->k = curr->v + 1 + (offset++);
-                if (element->k->size > 0) {
-                    element->v = curr->v + 1 + offset;
-                    oa_hash_set((struct oa_hash *)curr, js + element->k->start,
-                                element->k->end - element->k->start, element);
-                    if ((ret = _jsmnf_load_pairs(loader, js, element,
-                                                 num_tokens - offset, pairs,
-                                                 buckets, table_len))
-                        < 0)
-                    {
-                        return ret;
-                    }
-                    curr->fields = (struct jsmnf_pair *)fields;
-                    offset += ret;
-                }
-                else {
-                    oa_hash_set((struct oa_hash *)curr, js + element->k->start,
-                                element->k->end - element->k->start, NULL);
-                }
-            }
-        }
-        else if (JSMN_ARRAY == curr->v->type) {
-            for (; curr->length < value_size; ++curr->length) {
-                static jsmntok_t empty_key = { 0 };
-                struct oa_hash_entry *entry = curr->buckets + curr->length;
-                struct _jsmnf_pair_mut *fields = pairs + bottom_idx,
-                                       *element = fields + curr->length;
-                entry->state = OA_HASH_ENTRY_OCCUPIED;
-                entry->value = element;
-                element->v = curr->v + 1 + offset;
-                element->k = &empty_key;
-                if ((ret = _jsmnf_load_pairs(loader, js, element,
-                                             num_tokens - offset, pairs,
-                                             buckets, table_len))
-                    < 0)
-                {
-                    return ret;
-                }
-                curr->fields = (struct jsmnf_pair *)fields;
-                offset += ret;
-            }
-        }
-        break;
-    }
-    default:
-    case JSMN_UNDEFINED:
-        return JSMN_ERROR_INVAL;
-    }
+/**
+ * @brief Step into the current object or array value
+ *
+ * @param[in,out] cursor the @ref jsmnf_cursor
+ * @return a `enum jsmnerr` value for error, `1` if positioned at its first
+ *      member or `0` if it is empty (in which case it has been stepped over)
+ */
+JSMN_API long jsmnf_cursor_enter(jsmnf_cursor *cursor);
 
-    return offset + 1;
-}
+/**
+ * @brief Step over the current value without tokenizing it
+ *
+ * @param[in,out] cursor the @ref jsmnf_cursor
+ * @return a `enum jsmnerr` value for error, `1` if positioned at the next
+ *      member or `0` if the enclosing object or array has been stepped over
+ *      as well
+ */
+JSMN_API long jsmnf_cursor_skip(jsmnf_cursor *cursor);
 
-JSMN_API long
-jsmnf_load(struct jsmnf_loader *loader,
-           const char js[],
-           const size_t len,
-           struct jsmnf_table table[],
-           const size_t table_len)
-{
-    struct jsmntok *tokens = (struct jsmntok *)table;
-    struct _jsmnf_pair_mut
-        *pairs = (struct _jsmnf_pair_mut *)(((char *)tokens)
-                                            + (table_len * sizeof *tokens)),
-        *mut_root = &pairs[0];
-    struct oa_hash_entry *buckets =
-        (struct oa_hash_entry *)(((char *)pairs)
-                                 + (table_len * sizeof *pairs));
-    long ret;
+/**
+ * @brief Step forward to the current object's member matching `key`,
+ *      starting from the current member
+ *
+ * @param[in,out] cursor the @ref jsmnf_cursor positioned within an object
+ * @param[in] key the key to be matched against the raw key bytes
+ * @param[in] length length of the key to be matched
+ * @return a `enum jsmnerr` value for error, `1` if found or `0` if not
+ *      encountered (in which case the object has been stepped over)
+ */
+JSMN_API long jsmnf_cursor_find_field(jsmnf_cursor *cursor,
+                                      const char key[],
+                                      const size_t length);
 
-    if (loader->pairnext == 0) { /* first run, initialize pairs */
-        /* initialize tokens if not already initialized */
-        if (loader->parser.toknext == 0) {
-            memset(tokens, 0, table_len * sizeof *tokens);
-            if ((ret = jsmn_parse(&loader->parser, js, len, tokens, table_len))
-                < 0)
-            {
-                return jsmn_init(&loader->parser), ret;
-            }
-        }
-        memset(pairs, 0, table_len * sizeof *pairs);
-        memset(buckets, 0, table_len * sizeof *buckets);
-        mut_root->v = tokens + loader->pairnext++;
-        loader->root = (struct jsmnf_pair *)mut_root;
-    }
-    if ((ret = _jsmnf_load_pairs(loader, js, mut_root, loader->parser.toknext,
-                                 pairs, buckets, table_len))
-        < 0)
-    {
-        /* TODO: rather than reseting pairnext keep the last 'bucket' ptr
-         * stored, so it can continue from there in the next try */
-        loader->pairnext = 0;
-        loader->root = NULL;
-    }
-    return ret;
-}
+/**
+ * @brief Tokenize and populate the @ref jsmnf_pair pairs of the current
+ *      value only, tokens positions are relative to the cursor's `js`
+ *
+ * @param[in,out] cursor the @ref jsmnf_cursor
+ * @param[out] loader the @ref jsmnf_loader to be (re)initialized, its
+ *      `root` will be the current value
+ * @param[out] table jsmnf_table pairs array
+ * @param[in] table_len maximum amount of pairs provided
+ * @return a `enum jsmnerr` value for error or the amount of `pairs` used
+ */
+JSMN_API long jsmnf_cursor_load(jsmnf_cursor *cursor,
+                                jsmnf_loader *loader,
+                                jsmnf_table table[],
+                                const size_t table_len);
 
-JSMN_API const struct jsmnf_pair *
-jsmnf_find(const struct jsmnf_pair *head,
-           const char key[],
-           const size_t length)
-{
-    if (!head || !head->v) return NULL;
-    if (!key && !length) return head;
+/** @brief jsmn-find error codes that complement `enum jsmnerr` */
+enum jsmnf_err {
+    /** the value doesn't fit in the requested type, or the JSON string is
+     *      too large for jsmn's `int` token offsets */
+    JSMNF_ERROR_RANGE = -4,
+    /** a file couldn't be read or written */
+    JSMNF_ERROR_IO = -5
+};
 
-    if (JSMN_OBJECT == head->v->type) {
-        return oa_hash_get((struct oa_hash *)head, key, length);
-    }
-    if (JSMN_ARRAY == head->v->type) {
-        char *endptr;
-        const unsigned idx = (unsigned)strtoul(key, &endptr, 10);
-        if (endptr != key && (idx < head->length)
-            && head->buckets[idx].state == OA_HASH_ENTRY_OCCUPIED)
-        {
-            return head->buckets[idx].value;
-        }
-    }
-    return NULL;
-}
+/**
+ * @brief Parse a pair's integer value as a signed 64-bit integer
+ *
+ * @param[in] pair the @ref jsmnf_pair holding a JSON integer
+ * @param[in] js the JSON data string
+ * @param[out] p_value the parsed value
+ * @return `0` if successful, `JSMN_ERROR_INVAL` if the value isn't a JSON
+ *      integer or `JSMNF_ERROR_RANGE` if it doesn't fit in `int64_t`
+ */
+JSMN_API int jsmnf_get_i64(const jsmnf_pair *pair,
+                           const char js[],
+                           int64_t *p_value);
 
-JSMN_API const struct jsmnf_pair *
-jsmnf_find_path(const struct jsmnf_pair *head,
+/**
+ * @brief Parse a pair's integer value as an unsigned 64-bit integer
+ *
+ * @param[in] pair the @ref jsmnf_pair holding a JSON integer
+ * @param[in] js the JSON data string
+ * @param[out] p_value the parsed value
+ * @return `0` if successful, `JSMN_ERROR_INVAL` if the value isn't a JSON
+ *      integer or `JSMNF_ERROR_RANGE` if it doesn't fit in `uint64_t`
+ */
+JSMN_API int jsmnf_get_u64(const jsmnf_pair *pair,
+                           const char js[],
+                           uint64_t *p_value);
+
+/**
+ * @brief Parse a pair's number value as a double
+ *
+ * @param[in] pair the @ref jsmnf_pair holding a JSON number
+ * @param[in] js the JSON data string
+ * @param[out] p_value the parsed value, correctly rounded as long as the C
+ *      library's strtod() is, regardless of the locale
+ * @return `0` if successful, `JSMN_ERROR_INVAL` if the value isn't a JSON
+ *      number or `JSMNF_ERROR_RANGE` if its magnitude is too large for a
+ *      double
+ */
+JSMN_API int jsmnf_get_double(const jsmnf_pair *pair,
+                              const char js[],
+                              double *p_value);
+
+/**
+ * @brief Parse a pair's `true` or `false` value
+ *
+ * @param[in] pair the @ref jsmnf_pair holding a JSON boolean
+ * @param[in] js the JSON data string
+ * @param[out] p_value `1` for `true` or `0` for `false`
+ * @return `0` if successful or `JSMN_ERROR_INVAL` if the value isn't a JSON
+ *      boolean
+ */
+JSMN_API int jsmnf_get_bool(const jsmnf_pair *pair,
+                            const char js[],
+                            int *p_value);
+
+/**
+ * @brief Get a pair's string value, unescaping it only if needed
+ *
+ * @param[in] pair the @ref jsmnf_pair holding a JSON string
+ * @param[in] js the JSON data string
+ * @param[out] buf destination buffer, untouched if the value is raw
+ * @param[in] bufsize destination buffer size
+ * @param[out] p_str `js` span of a raw value, or `buf` otherwise
+ * @return length of the string if successful or a negative jsmn error code
+ *      on failure, `JSMN_ERROR_INVAL` if the value isn't a JSON string
+ * @see jsmnf_is_raw()
+ */
+JSMN_API long jsmnf_get_string(const jsmnf_pair *pair,
+                               const char js[],
+                               char buf[],
+                               size_t bufsize,
+                               const char **p_str);
+
+/**
+ * @brief Decode an array of JSON numbers into a contiguous buffer of doubles
+ *
+ * @param[in] head a @ref jsmnf_pair array
+ * @param[in] js the JSON data string
+ * @param[out] buf destination buffer
+ * @param[in] bufsize destination buffer amount of elements
+ * @return a `enum jsmnerr` value for error or the amount of elements
+ *      decoded, which is less than `head->length` if the element at that
+ *      index isn't a number that fits the destination type
+ */
+JSMN_API long jsmnf_array_to_f64(const jsmnf_pair *head,
+                                 const char js[],
+                                 double buf[],
+                                 size_t bufsize);
+
+/**
+ * @brief Decode an array of JSON integers into a contiguous buffer of signed
+ *      64-bit integers
+ * @see jsmnf_array_to_f64()
+ */
+JSMN_API long jsmnf_array_to_i64(const jsmnf_pair *head,
+                                 const char js[],
+                                 int64_t buf[],
+                                 size_t bufsize);
+
+/**
+ * @brief Decode an array of JSON integers into a contiguous buffer of signed
+ *      32-bit integers
+ * @see jsmnf_array_to_f64()
+ */
+JSMN_API long jsmnf_array_to_i32(const jsmnf_pair *head,
+                                 const char js[],
+                                 int32_t buf[],
+                                 size_t bufsize);
+
+/** @brief Compact JSON index node, see jsmnf_compact_load() */
+typedef struct jsmnf_node {
+    /** JSON type, a `jsmntype_t` value */
+    uint16_t type;
+    /** `JSMNF_VALUE_ESCAPED` if the string contains escape sequences */
+    uint16_t flags;
+    /** start position in the JSON string */
+    uint32_t start;
+    /** end position in the JSON string */
+    uint32_t end;
+    /** amount of object members or array elements, `1` for object keys */
+    uint32_t size;
+    /** @private offset of its children words */
+    uint32_t fields;
+} jsmnf_node;
+
+/** @brief Compact JSON index, the optionally embedded JSON string, nodes and
+ *      their children and hash buckets words are laid out right after it,
+ *      addressed by 32-bit offsets
+ *
+ * Holding no pointers, it can be moved with `memcpy()`, `realloc()`'d or
+ *      placed in shared memory as a single block of jsmnf_compact_size()
+ *      bytes */
+typedef struct jsmnf_compact {
+    /** amount of nodes, the first one being the root */
+    uint32_t num_nodes;
+    /** @private amount of 32-bit words following the nodes */
+    uint32_t num_words;
+    /** length of the JSON string embedded by jsmnf_compact_load_doc() */
+    uint32_t js_len;
+    /** @private bytes taken by the embedded JSON string, `0` if none */
+    uint32_t js_size;
+} jsmnf_compact;
+
+/** @brief Size that is always enough for the compact index of `num_tokens`
+ *      jsmn tokens */
+#define JSMNF_COMPACT_SIZE(num_tokens)                                        \
+    (sizeof(jsmnf_compact) + 32 * (size_t)(num_tokens))
+
+/**
+ * @brief Parse a JSON string into a compact index, which takes less than 32
+ *      bytes per token, as opposed to the over 100 bytes per token of a
+ *      @ref jsmnf_table
+ *
+ * The jsmn tokens are parsed into `table` and rewritten in place as nodes
+ * @note keys are matched by their raw bytes
+ *
+ * @param[in] js the JSON data string, must outlive `table`
+ * @param[in] len the raw JSON string length
+ * @param[out] table 4-byte aligned memory for the index
+ * @param[in] size `table` size in bytes, see JSMNF_COMPACT_SIZE()
+ * @return a `enum jsmnerr` value for error or the amount of bytes used
+ */
+JSMN_API long jsmnf_compact_load(const char js[],
+                                 size_t len,
+                                 jsmnf_compact *table,
+                                 size_t size);
+
+/**
+ * @brief jsmnf_compact_load() counterpart that copies the JSON string into
+ *      `table` too, making it a self-contained document
+ *
+ * @param[in] js the JSON data string
+ * @param[in] len the raw JSON string length
+ * @param[out] table 4-byte aligned memory for the index
+ * @param[in] size `table` size in bytes, `JSMNF_COMPACT_SIZE()` plus `len`
+ *      and `4` is always enough
+ * @return a `enum jsmnerr` value for error or the amount of bytes used
+ * @see jsmnf_compact_js()
+ */
+JSMN_API long jsmnf_compact_load_doc(const char js[],
+                                     size_t len,
+                                     jsmnf_compact *table,
+                                     size_t size);
+
+/**
+ * @brief jsmnf_compact_load_doc() counterpart that automatically grows the
+ *      index, tokenizing resumes from where it stopped after each growth
+ *
+ * @param[in] allocator the allocator hooks, or NULL for the default
+ *      allocator, see jsmnf_init_allocator()
+ * @param[in] js the JSON data string
+ * @param[in] len the raw JSON string length
+ * @param[in,out] p_table pointer to the index to be dynamically increased
+ *      @note must be released with `allocator` once done being used
+ * @param[in,out] size `*p_table` size in bytes
+ * @return a `enum jsmnerr` value for error or the amount of bytes used
+ */
+JSMN_API long jsmnf_compact_load_auto(const jsmnf_allocator *allocator,
+                                      const char js[],
+                                      size_t len,
+                                      jsmnf_compact **p_table,
+                                      size_t *size);
+
+/**
+ * @brief Get the amount of bytes taken by a compact index
+ *
+ * @param[in] table the index populated by jsmnf_compact_load()
+ * @return the size of the block to be copied for moving `table`
+ */
+JSMN_API size_t jsmnf_compact_size(const jsmnf_compact *table);
+
+/**
+ * @brief Get the JSON string embedded in a compact index
+ *
+ * @param[in] table the index populated by jsmnf_compact_load_doc()
+ * @return the NUL-terminated JSON string of `js_len` length, or NULL if
+ *      none was embedded
+ */
+JSMN_API const char *jsmnf_compact_js(const jsmnf_compact *table);
+
+/**
+ * @brief Get the root node of a compact index
+ *
+ * @param[in] table the index populated by jsmnf_compact_load()
+ * @return the root node, or NULL if the index is empty
+ */
+JSMN_API const jsmnf_node *jsmnf_compact_root(const jsmnf_compact *table);
+
+/**
+ * @brief jsmnf_find() counterpart for a compact index
+ *
+ * @param[in] table the index populated by jsmnf_compact_load()
+ * @param[in] head an object or array node of `table`
+ * @param[in] js the JSON data string
+ * @param[in] key the key too be matched
+ * @param[in] length length of the key too be matched
+ * @return the value node matched to `key`, or NULL if not encountered
+ */
+JSMN_API const jsmnf_node *jsmnf_compact_find(const jsmnf_compact *table,
+                                              const jsmnf_node *head,
+                                              const char js[],
+                                              const char key[],
+                                              size_t length);
+
+/**
+ * @brief jsmnf_find_path() counterpart for a compact index
+ *
+ * @param[in] table the index populated by jsmnf_compact_load()
+ * @param[in] head an object or array node of `table`
+ * @param[in] js the JSON data string
+ * @param[in] path an array of key path strings, from least to highest depth
+ * @param[in] depth the depth level of the last `path` key
+ * @return the value node matched to `path`, or NULL if not encountered
+ */
+JSMN_API const jsmnf_node *jsmnf_compact_find_path(const jsmnf_compact *table,
+                                                   const jsmnf_node *head,
+                                                   const char js[],
+                                                   char *const path[],
+                                                   unsigned depth);
+
+/**
+ * @brief Get an object member or array element value node by its position
+ * @note the key of an object member is the node right before its value
+ *
+ * @param[in] table the index populated by jsmnf_compact_load()
+ * @param[in] head an object or array node of `table`
+ * @param[in] index the member or element position
+ * @return the value node, or NULL if out of bounds
+ */
+JSMN_API const jsmnf_node *jsmnf_compact_field(const jsmnf_compact *table,
+                                               const jsmnf_node *head,
+                                               size_t index);
+
+/**
+ * @brief Persist a compact index and its embedded JSON string, so that it
+ *      can be served by jsmnf_open_indexed() with no parsing
+ * @note the file is only readable on hosts of the same byte order
+ *
+ * @param[in] table the index populated by jsmnf_compact_load_doc()
+ * @param[in] path the file to be written
+ * @return `0` if successful, `JSMN_ERROR_INVAL` if `table` has no embedded
+ *      JSON string or `JSMNF_ERROR_IO` if the file couldn't be written
+ */
+JSMN_API long jsmnf_save_indexed(const jsmnf_compact *table,
+                                 const char path[]);
+
+/**
+ * @brief Map a file written by jsmnf_save_indexed(), its version, checksum
+ *      and node offsets are verified before it is served
+ *
+ * @param[in] path the file to be mapped
+ * @param[out] p_table the mapped index, the JSON string is given by
+ *      jsmnf_compact_js()
+ *      @note must be jsmnf_close_indexed()'d once done being used
+ * @return `0` if successful, `JSMN_ERROR_INVAL` if the file isn't a valid
+ *      index or `JSMNF_ERROR_IO` if it couldn't be read
+ */
+JSMN_API long jsmnf_open_indexed(const char path[],
+                                 const jsmnf_compact **p_table);
+
+/**
+ * @brief Unmap an index opened by jsmnf_open_indexed()
+ *
+ * @param[in] table the index to be unmapped
+ */
+JSMN_API void jsmnf_close_indexed(const jsmnf_compact *table);
+
+/** @brief Per-request document owning a single arena for its JSON copy,
+ *      tokens, pairs, buckets and unescaped strings */
+typedef struct jsmnf_doc {
+    /** loader of the document, its root is the document's root pair */
+    jsmnf_loader loader;
+    /** the loaded JSON string, either the caller's or the arena copy */
+    const char *js;
+    /** the loaded JSON string length */
+    size_t len;
+    /** @private the arena */
+    char *arena;
+    /** @private `arena` size in bytes, kept across jsmnf_doc_reset() */
+    size_t size;
+    /** @private region of unescaped strings within `arena` */
+    char *strings;
+    /** @private `strings` size in bytes */
+    size_t strings_len;
+    /** @private next `strings` byte to allocate */
+    size_t stringsnext;
+} jsmnf_doc;
+
+/**
+ * @brief Initialize an empty @ref jsmnf_doc
+ *
+ * @param[out] doc the document to be initialized
+ * @param[in] allocator the allocator hooks of the arena, must outlive `doc`,
+ *      or NULL for the default allocator, see jsmnf_init_allocator()
+ */
+JSMN_API void jsmnf_doc_init(jsmnf_doc *doc,
+                             const jsmnf_allocator *allocator);
+
+/**
+ * @brief Load a JSON string into a @ref jsmnf_doc
+ *
+ * The arena only grows when the document doesn't fit the capacity reached
+ *      by the previous ones, so a reused document settles into loading
+ *      with no allocations at all
+ *
+ * @param[in,out] doc the document initialized with jsmnf_doc_init()
+ * @param[in] js the JSON data string
+ * @param[in] len the raw JSON string length
+ * @param[in] copy if non-zero `js` is copied into the arena, otherwise it
+ *      must outlive the loaded pairs
+ * @return a `enum jsmnerr` value for error or the amount of pairs used
+ */
+JSMN_API long jsmnf_doc_load(jsmnf_doc *doc,
+                             const char js[],
+                             size_t len,
+                             int copy);
+
+/**
+ * @brief Get a string value of a @ref jsmnf_doc, unescaped into the arena if
+ *      it has escape sequences
+ *
+ * @param[in,out] doc the document the pair belongs to
+ * @param[in] pair the string value pair
+ * @param[out] p_str the string, valid until the document is reset
+ * @return a `enum jsmnerr` value for error or the string length
+ */
+JSMN_API long jsmnf_doc_string(jsmnf_doc *doc,
+                               const jsmnf_pair *pair,
+                               const char **p_str);
+
+/**
+ * @brief Drop the loaded document, keeping the arena for the next one
+ *
+ * @param[in,out] doc the document to be reset
+ */
+JSMN_API void jsmnf_doc_reset(jsmnf_doc *doc);
+
+/**
+ * @brief Release the arena of a @ref jsmnf_doc
+ *
+ * @param[in,out] doc the document to be freed, left as if just initialized
+ */
+JSMN_API void jsmnf_doc_free(jsmnf_doc *doc);
+
+/** @brief Standalone copy of a JSON subtree, see jsmnf_clone_subtree() */
+typedef struct jsmnf_clone {
+    /** root pair of the cloned subtree */
+    const jsmnf_pair *root;
+    /** the subtree's JSON string, quotes included for a string, token
+     *      offsets are relative to it */
+    const char *js;
+    /** the subtree's JSON string length */
+    size_t len;
+    /** @private the allocator the clone was allocated with */
+    const jsmnf_allocator *allocator;
+} jsmnf_clone;
+
+/**
+ * @brief Copy a subtree's JSON string, tokens, pairs and buckets into a single
+ *      tightly sized block
+ *
+ * The clone doesn't reference the document it was taken from, so the
+ *      document's JSON string and storage can be released right away
+ * @note members skipped by jsmnf_load_projected() are indexed in the clone,
+ *      and escaped keys are matched by their unescaped form as with
+ *      jsmnf_init_keys()
+ *
+ * @param[in] pair the pair of the subtree's value
+ * @param[in] js the JSON data string `pair` was loaded from
+ * @param[in] allocator the allocator hooks, must outlive the clone, or NULL
+ *      for the default allocator, see jsmnf_init_allocator()
+ * @param[out] p_clone the clone, to be released with jsmnf_clone_free()
+ * @return a `enum jsmnerr` value for error or the clone size in bytes
+ */
+JSMN_API long jsmnf_clone_subtree(const jsmnf_pair *pair,
+                                  const char js[],
+                                  const jsmnf_allocator *allocator,
+                                  jsmnf_clone **p_clone);
+
+/**
+ * @brief Release a @ref jsmnf_clone
+ *
+ * @param[in] clone the clone returned by jsmnf_clone_subtree(), or NULL
+ */
+JSMN_API void jsmnf_clone_free(jsmnf_clone *clone);
+
+/**
+ * @brief Sink of serialized JSON, see jsmnf_write()
+ *
+ * @param[in] ctx user context given to jsmnf_write()
+ * @param[in] data the serialized bytes
+ * @param[in] len amount of bytes
+ * @return 0 to continue, or a negative value to stop serializing
+ */
+typedef int (*jsmnf_sink)(void *ctx, const char data[], size_t len);
+
+/** @brief jsmnf_write() flags */
+enum jsmnf_write_flags {
+    /** indent nested values and put a member or element per line */
+    JSMNF_WRITE_PRETTY = 1 << 0
+};
+
+/**
+ * @brief Serialize a @ref jsmnf_pair and its subtree
+ *
+ * Output is minified unless `JSMNF_WRITE_PRETTY` is given, keys and scalars
+ *      are written as their raw tokens, and stretches of `js` that are
+ *      already minified are handed to `sink` as a single span
+ * @note members dropped by jsmnf_load_projected() are left out, and its empty
+ *      array slots are written as `null`
+ * @note strings unescaped in place aren't valid JSON anymore, so documents
+ *      must be serialized before jsmnf_unescape_all()
+ *
+ * @param[in] pair the pair of the value to be serialized
+ * @param[in] js the JSON data string `pair` was loaded from
+ * @param[in] flags `enum jsmnf_write_flags` bitmask
+ * @param[in] sink the callback receiving the serialized bytes, in order
+ * @param[in] ctx user context given to `sink`
+ * @return a `enum jsmnerr` value or the negative value returned by `sink`
+ *      for error, or the amount of bytes written
+ */
+JSMN_API long jsmnf_write(const jsmnf_pair *pair,
+                          const char js[],
+                          unsigned flags,
+                          jsmnf_sink sink,
+                          void *ctx);
+
+/**
+ * @brief jsmnf_write() counterpart that serializes into a buffer
+ *
+ * @param[in] pair the pair of the value to be serialized
+ * @param[in] js the JSON data string `pair` was loaded from
+ * @param[in] flags `enum jsmnf_write_flags` bitmask
+ * @param[out] buf the buffer to write to, not NUL-terminated
+ * @param[in] bufsize `buf` size in bytes
+ * @return a `enum jsmnerr` value for error or the amount of bytes written
+ */
+JSMN_API long jsmnf_write_buf(const jsmnf_pair *pair,
+                              const char js[],
+                              unsigned flags,
+                              char buf[],
+                              size_t bufsize);
+
+#ifndef JSMNF_WRITER_MAX_DEPTH
+/** @brief maximum nesting of the objects and arrays of a @ref jsmnf_writer */
+#define JSMNF_WRITER_MAX_DEPTH 128
+#endif
+
+/** @brief JSON builder writing into a fixed or growable buffer */
+typedef struct jsmnf_writer {
+    /** the output buffer */
+    char *buf;
+    /** `buf` size in bytes */
+    size_t size;
+    /** amount of bytes written to `buf` */
+    size_t len;
+    /** @private allocator growing `buf`, NULL for a fixed buffer */
+    const jsmnf_allocator *allocator;
+    /** @private first error encountered, later calls do nothing */
+    int error;
+    /** @private amount of open objects and arrays */
+    unsigned depth;
+    /** @private bit set for each open object, by depth */
+    unsigned char objects[(JSMNF_WRITER_MAX_DEPTH + CHAR_BIT - 1) / CHAR_BIT];
+    /** @private whether the next value or key is preceded by a comma */
+    int comma;
+} jsmnf_writer;
+
+/**
+ * @brief Initialize a @ref jsmnf_writer that writes into a fixed buffer
+ *
+ * Writing past `size` fails with `JSMN_ERROR_NOMEM`, see
+ *      jsmnf_writer_finish()
+ *
+ * @param[out] writer the writer to be initialized
+ * @param[in] buf the output buffer, not NUL-terminated
+ * @param[in] size `buf` size in bytes
+ */
+JSMN_API void jsmnf_writer_init(jsmnf_writer *writer, char buf[], size_t size);
+
+/**
+ * @brief Initialize a @ref jsmnf_writer that writes into a buffer grown as
+ *      needed
+ *
+ * @param[out] writer the writer to be initialized
+ * @param[in] allocator the allocator hooks, must outlive `writer`, or NULL
+ *      for the default allocator, see jsmnf_init_allocator()
+ *      @note the buffer must be released with jsmnf_writer_free()
+ */
+JSMN_API void jsmnf_writer_init_auto(jsmnf_writer *writer,
+                                     const jsmnf_allocator *allocator);
+
+/**
+ * @brief Open an object
+ *
+ * @param[in,out] writer the @ref jsmnf_writer
+ * @return 0 or a `enum jsmnerr` value for error, which is also kept for
+ *      jsmnf_writer_finish()
+ */
+JSMN_API int jsmnf_writer_begin_object(jsmnf_writer *writer);
+
+/**
+ * @brief Close the innermost object
+ *
+ * @param[in,out] writer the @ref jsmnf_writer
+ * @return 0 or a `enum jsmnerr` value for error, `JSMN_ERROR_INVAL` if the
+ *      innermost container isn't an object
+ */
+JSMN_API int jsmnf_writer_end_object(jsmnf_writer *writer);
+
+/**
+ * @brief Open an array
+ *
+ * @param[in,out] writer the @ref jsmnf_writer
+ * @return 0 or a `enum jsmnerr` value for error
+ */
+JSMN_API int jsmnf_writer_begin_array(jsmnf_writer *writer);
+
+/**
+ * @brief Close the innermost array
+ *
+ * @param[in,out] writer the @ref jsmnf_writer
+ * @return 0 or a `enum jsmnerr` value for error, `JSMN_ERROR_INVAL` if the
+ *      innermost container isn't an array
+ */
+JSMN_API int jsmnf_writer_end_array(jsmnf_writer *writer);
+
+/**
+ * @brief Write an object member's key, to be followed by its value
+ *
+ * @param[in,out] writer the @ref jsmnf_writer
+ * @param[in] key the UTF-8 key, escaped as needed
+ * @param[in] len `key` length
+ * @return 0 or a `enum jsmnerr` value for error
+ */
+JSMN_API int jsmnf_writer_key(jsmnf_writer *writer,
+                              const char key[],
+                              size_t len);
+
+/**
+ * @brief Write a string value
+ *
+ * @param[in,out] writer the @ref jsmnf_writer
+ * @param[in] str the UTF-8 string, escaped as needed
+ * @param[in] len `str` length
+ * @return 0 or a `enum jsmnerr` value for error
+ */
+JSMN_API int jsmnf_writer_string(jsmnf_writer *writer,
+                                 const char str[],
+                                 size_t len);
+
+/**
+ * @brief Write an integer value
+ *
+ * @param[in,out] writer the @ref jsmnf_writer
+ * @param[in] value the integer
+ * @return 0 or a `enum jsmnerr` value for error
+ */
+JSMN_API int jsmnf_writer_i64(jsmnf_writer *writer, int64_t value);
+
+/**
+ * @brief Write an unsigned integer value
+ *
+ * @param[in,out] writer the @ref jsmnf_writer
+ * @param[in] value the unsigned integer
+ * @return 0 or a `enum jsmnerr` value for error
+ */
+JSMN_API int jsmnf_writer_u64(jsmnf_writer *writer, uint64_t value);
+
+/**
+ * @brief Write a number value with the fewest digits that parse back to it
+ *
+ * The decimal point is always `.`, whatever the locale's `LC_NUMERIC`
+ *
+ * @param[in,out] writer the @ref jsmnf_writer
+ * @param[in] value the number, `JSMN_ERROR_INVAL` if it isn't finite
+ * @return 0 or a `enum jsmnerr` value for error
+ */
+JSMN_API int jsmnf_writer_double(jsmnf_writer *writer, double value);
+
+/**
+ * @brief Write a boolean value
+ *
+ * @param[in,out] writer the @ref jsmnf_writer
+ * @param[in] value `true` if non-zero, `false` otherwise
+ * @return 0 or a `enum jsmnerr` value for error
+ */
+JSMN_API int jsmnf_writer_bool(jsmnf_writer *writer, int value);
+
+/**
+ * @brief Write a `null` value
+ *
+ * @param[in,out] writer the @ref jsmnf_writer
+ * @return 0 or a `enum jsmnerr` value for error
+ */
+JSMN_API int jsmnf_writer_null(jsmnf_writer *writer);
+
+/**
+ * @brief Get the outcome of a @ref jsmnf_writer
+ *
+ * @param[in] writer the @ref jsmnf_writer
+ * @return the first `enum jsmnerr` value encountered, `JSMN_ERROR_PART` if
+ *      objects or arrays are left open, or the amount of bytes written
+ */
+JSMN_API long jsmnf_writer_finish(const jsmnf_writer *writer);
+
+/**
+ * @brief Release the buffer of a @ref jsmnf_writer initialized with
+ *      jsmnf_writer_init_auto()
+ *
+ * @param[in,out] writer the @ref jsmnf_writer
+ */
+JSMN_API void jsmnf_writer_free(jsmnf_writer *writer);
+
+/** @brief Storage for a scalar value to be given to the overlay edits, see
+ *      jsmnf_scalar_init() */
+typedef struct jsmnf_scalar {
+    /** @private the value's token */
+    jsmntok_t tok;
+    /** the value's pair */
+    jsmnf_pair pair;
+} jsmnf_scalar;
+
+/** @brief An edit recorded by a @ref jsmnf_overlay, not supposed to be
+ *      accessed by user */
+typedef struct jsmnf_edit {
+    /** @private `enum _jsmnf_edit_type` value */
+    int type;
+    /** @private object or array the edit applies to */
+    const jsmnf_pair *container;
+    /** @private replaced or deleted member, NULL for added ones */
+    const jsmnf_pair *member;
+    /** @private key of an added object member */
+    const char *key;
+    /** @private `key` length */
+    size_t key_len;
+    /** @private the new value */
+    const jsmnf_pair *value;
+    /** @private the JSON string `value` was loaded from */
+    const char *value_js;
+} jsmnf_edit;
+
+/** @brief Copy-on-write edits over a loaded document, see
+ *      jsmnf_overlay_init() */
+typedef struct jsmnf_overlay {
+    /** root pair of the edited document */
+    const jsmnf_pair *root;
+    /** the JSON string of the edited document */
+    const char *js;
+    /** @private the edits array */
+    jsmnf_edit *edits;
+    /** @private amount of edits recorded */
+    size_t num_edits;
+    /** @private maximum amount of edits */
+    size_t max_edits;
+} jsmnf_overlay;
+
+/**
+ * @brief Load a scalar JSON value to be used by the overlay edits
+ *
+ * @param[out] scalar the value's storage, must outlive its use
+ * @param[in] text the JSON text of a single value, such as `42` or
+ *      `"foo"`, must outlive its use
+ * @param[in] len `text` length
+ * @return the value's pair, or NULL if `text` isn't a scalar JSON value
+ */
+JSMN_API const jsmnf_pair *jsmnf_scalar_init(jsmnf_scalar *scalar,
+                                             const char text[],
+                                             size_t len);
+
+/**
+ * @brief Initialize a @ref jsmnf_overlay with no edits
+ *
+ * The document is never modified, edits are recorded aside and only
+ *      applied by jsmnf_overlay_find() and jsmnf_overlay_write()
+ * @note edits apply to pairs of the document itself, and not to the pairs of
+ *      values added by other edits
+ *
+ * @param[out] overlay the overlay to be initialized
+ * @param[in] root the root pair of the loaded document
+ * @param[in] js the JSON string of the loaded document
+ * @param[in] edits the edits array, must outlive `overlay`
+ * @param[in] max_edits maximum amount of edits
+ */
+JSMN_API void jsmnf_overlay_init(jsmnf_overlay *overlay,
+                                 const jsmnf_pair *root,
+                                 const char js[],
+                                 jsmnf_edit edits[],
+                                 size_t max_edits);
+
+/**
+ * @brief Replace the value of an existing object member or array element
+ *
+ * @param[in,out] overlay the @ref jsmnf_overlay
+ * @param[in] container the object or array pair of the document
+ * @param[in] key the member's key, or the element's index as a decimal
+ *      string, as seen through the overlay
+ * @param[in] len `key` length
+ * @param[in] value the new value, must outlive `overlay`
+ * @param[in] value_js the JSON string `value` was loaded from
+ * @return 0, `JSMN_ERROR_INVAL` if there's no such member, or
+ *      `JSMN_ERROR_NOMEM` if the edits array is full
+ */
+JSMN_API int jsmnf_overlay_set(jsmnf_overlay *overlay,
+                               const jsmnf_pair *container,
+                               const char key[],
+                               size_t len,
+                               const jsmnf_pair *value,
+                               const char value_js[]);
+
+/**
+ * @brief Add an object member, or replace its value if it already exists
+ *
+ * @param[in,out] overlay the @ref jsmnf_overlay
+ * @param[in] object the object pair of the document
+ * @param[in] key the member's key, already escaped, must outlive `overlay`
+ * @param[in] len `key` length
+ * @param[in] value the new value, must outlive `overlay`
+ * @param[in] value_js the JSON string `value` was loaded from
+ * @return 0 or a `enum jsmnerr` value for error
+ */
+JSMN_API int jsmnf_overlay_insert(jsmnf_overlay *overlay,
+                                  const jsmnf_pair *object,
+                                  const char key[],
+                                  size_t len,
+                                  const jsmnf_pair *value,
+                                  const char value_js[]);
+
+/**
+ * @brief Delete an object member or array element
+ *
+ * @param[in,out] overlay the @ref jsmnf_overlay
+ * @param[in] container the object or array pair of the document
+ * @param[in] key the member's key, or the element's index as a decimal
+ *      string, as seen through the overlay
+ * @param[in] len `key` length
+ * @return 0 or a `enum jsmnerr` value for error
+ */
+JSMN_API int jsmnf_overlay_delete(jsmnf_overlay *overlay,
+                                  const jsmnf_pair *container,
+                                  const char key[],
+                                  size_t len);
+
+/**
+ * @brief Append an element to an array
+ *
+ * @param[in,out] overlay the @ref jsmnf_overlay
+ * @param[in] array the array pair of the document
+ * @param[in] value the new element, must outlive `overlay`
+ * @param[in] value_js the JSON string `value` was loaded from
+ * @return 0 or a `enum jsmnerr` value for error
+ */
+JSMN_API int jsmnf_overlay_append(jsmnf_overlay *overlay,
+                                  const jsmnf_pair *array,
+                                  const jsmnf_pair *value,
+                                  const char value_js[]);
+
+/**
+ * @brief jsmnf_find() counterpart that sees the edits of a @ref jsmnf_overlay
+ *
+ * @param[in] overlay the @ref jsmnf_overlay
+ * @param[in] head the object or array pair to search
+ * @param[in] key the key or decimal index to look for
+ * @param[in] length `key` length
+ * @param[in,out] p_js the JSON string of `head`, updated to the JSON string
+ *      of the returned pair when it comes from an edit
+ * @return the @ref jsmnf_pair found, or NULL if missing or deleted
+ */
+JSMN_API const jsmnf_pair *jsmnf_overlay_find(const jsmnf_overlay *overlay,
+                                              const jsmnf_pair *head,
+                                              const char key[],
+                                              size_t length,
+                                              const char **p_js);
+
+/**
+ * @brief Serialize a document with its overlay edits applied
+ *
+ * Regions of the document without edits are spliced as-is, whitespace
+ *      included, so unchanged subtrees reach `sink` as single spans and
+ *      the cost is proportional to the edits rather than the document
+ *
+ * @param[in] overlay the @ref jsmnf_overlay
+ * @param[in] sink the callback receiving the serialized bytes, in order
+ * @param[in] ctx user context given to `sink`
+ * @return a `enum jsmnerr` value or the negative value returned by `sink`
+ *      for error, or the amount of bytes written
+ */
+JSMN_API long jsmnf_overlay_write(const jsmnf_overlay *overlay,
+                                  jsmnf_sink sink,
+                                  void *ctx);
+
+/**
+ * @brief jsmnf_overlay_write() counterpart that serializes into a buffer
+ *
+ * @param[in] overlay the @ref jsmnf_overlay
+ * @param[out] buf the buffer to write to, not NUL-terminated
+ * @param[in] bufsize `buf` size in bytes
+ * @return a `enum jsmnerr` value for error or the amount of bytes written
+ */
+JSMN_API long jsmnf_overlay_write_buf(const jsmnf_overlay *overlay,
+                                      char buf[],
+                                      size_t bufsize);
+
+/** @brief Differences reported by jsmnf_diff() */
+enum jsmnf_diff_op {
+    /** the member is only in the second document */
+    JSMNF_DIFF_ADD,
+    /** the member is only in the first document */
+    JSMNF_DIFF_REMOVE,
+    /** the member's value differs between the documents */
+    JSMNF_DIFF_CHANGE
+};
+
+/** @brief Step of the path to a member reported by jsmnf_diff() */
+typedef struct jsmnf_path {
+    /** the step above, NULL for a member of the root */
+    const struct jsmnf_path *parent;
+    /** the object member's key as found in the JSON string, or NULL for an
+     *      array element */
+    const char *key;
+    /** `key` length */
+    size_t key_len;
+    /** the array element's index */
+    size_t index;
+} jsmnf_path;
+
+/**
+ * @brief Callback receiving the differences found by jsmnf_diff()
+ *
+ * @param[in] ctx user context given to jsmnf_diff()
+ * @param[in] op the difference found
+ * @param[in] path the member's path from its deepest step, only valid
+ *      during the call, NULL for the roots themselves
+ * @param[in] a the member in the first document, NULL for
+ *      `JSMNF_DIFF_ADD`
+ * @param[in] b the member in the second document, NULL for
+ *      `JSMNF_DIFF_REMOVE`
+ * @return 0 to keep going, or a negative value to stop
+ */
+typedef int (*jsmnf_diff_cb)(void *ctx,
+                             enum jsmnf_diff_op op,
+                             const jsmnf_path *path,
+                             const jsmnf_pair *a,
+                             const jsmnf_pair *b);
+
+/**
+ * @brief Report the structural differences between two loaded documents
+ *
+ * Both trees are walked in parallel, object members are matched by their
+ *      unescaped key through the `b` hash table and array elements by
+ *      index, while subtrees whose raw JSON spans are byte-identical are
+ *      skipped without being walked
+ * @note values are compared by their raw bytes, so `1.0` and `1`, or a
+ *      string and its escaped form, are reported as changed
+ *
+ * @param[in] a the root pair of the first document
+ * @param[in] a_js the JSON string of the first document
+ * @param[in] b the root pair of the second document
+ * @param[in] b_js the JSON string of the second document
+ * @param[in] callback the callback receiving the differences, in document
+ *      order of `a` and then `b`
+ * @param[in] ctx user context given to `callback`
+ * @return 0, the negative value returned by `callback`, or
+ *      `JSMN_ERROR_NOMEM` if an escaped key couldn't be unescaped to be
+ *      looked up
+ */
+JSMN_API int jsmnf_diff(const jsmnf_pair *a,
+                        const char a_js[],
+                        const jsmnf_pair *b,
+                        const char b_js[],
+                        jsmnf_diff_cb callback,
+                        void *ctx);
+
+/**
+ * @brief Format a @ref jsmnf_path as a JSONPath expression, such as
+ *      `$.foo[2].bar`
+ *
+ * @param[in] path the path from its deepest step, or NULL for the root
+ * @param[out] buf the buffer to write to, NUL-terminated
+ * @param[in] bufsize `buf` size in bytes
+ * @return `JSMN_ERROR_NOMEM` if `buf` is too small, or the amount of
+ *      characters written, NUL-terminator excluded
+ */
+JSMN_API long jsmnf_path_format(const jsmnf_path *path,
+                                char buf[],
+                                size_t bufsize);
+
+/** @brief Structural hashes of the pairs of a loaded document, see
+ *      jsmnf_hashes_init() */
+typedef struct jsmnf_hashes {
+    /** the root pair the hashes were computed from */
+    const jsmnf_pair *root;
+    /** the JSON string of `root` */
+    const char *js;
+    /** @private hash of each pair, by its position from `root` */
+    uint64_t *values;
+    /** @private amount of `values` */
+    size_t len;
+} jsmnf_hashes;
+
+/**
+ * @brief Compute the structural hash of a subtree
+ *
+ * The hash is built bottom-up from the children, ignoring whitespace and
+ *      the order of object members, so that equal subtrees hash the same
+ *      regardless of their formatting
+ * @note keys and strings are hashed by their unescaped form, while other
+ *      scalars are hashed by their raw bytes, so `1.0` and `1` hash
+ *      differently
+ *
+ * @param[in] pair the subtree's pair
+ * @param[in] js the JSON string of `pair`
+ * @return the 64-bit hash of the subtree
+ */
+JSMN_API uint64_t jsmnf_hash(const jsmnf_pair *pair, const char js[]);
+
+/**
+ * @brief Compute the jsmnf_hash() of every pair of a document in a single
+ *      bottom-up pass
+ *
+ * @param[out] hashes the @ref jsmnf_hashes to be initialized
+ * @param[in] root the root pair of the pairs array, such as
+ *      `jsmnf_loader.root`
+ * @param[in] js the JSON string of `root`
+ * @param[out] values the hashes array, must outlive `hashes`
+ * @param[in] len maximum amount of `values`, the amount of pairs returned
+ *      by the loader is enough
+ * @return `JSMN_ERROR_NOMEM` if `values` is too small, or the amount of
+ *      `values` used
+ */
+JSMN_API long jsmnf_hashes_init(jsmnf_hashes *hashes,
+                                const jsmnf_pair *root,
+                                const char js[],
+                                uint64_t values[],
+                                size_t len);
+
+/**
+ * @brief Get the structural hash of a pair
+ *
+ * @param[in] hashes the @ref jsmnf_hashes initialized with
+ *      jsmnf_hashes_init()
+ * @param[in] pair a pair of the `hashes` document, its hash is computed
+ *      with jsmnf_hash() if it wasn't stored
+ * @return the 64-bit hash of the subtree
+ */
+JSMN_API uint64_t jsmnf_hashes_get(const jsmnf_hashes *hashes,
+                                   const jsmnf_pair *pair);
+
+/**
+ * @brief Check whether two subtrees are structurally equal
+ *
+ * Hashes are compared first, and the subtrees are only deep-compared,
+ *      ignoring whitespace, escape sequences and the order of object
+ *      members, when the hashes match
+ *
+ * @param[in] a_hashes the @ref jsmnf_hashes of the first document
+ * @param[in] a a pair of the first document
+ * @param[in] b_hashes the @ref jsmnf_hashes of the second document
+ * @param[in] b a pair of the second document
+ * @return 1 if equal, 0 otherwise, or `JSMN_ERROR_NOMEM` if an escaped key
+ *      or string couldn't be unescaped to be compared
+ */
+JSMN_API int jsmnf_subtree_equal(const jsmnf_hashes *a_hashes,
+                                 const jsmnf_pair *a,
+                                 const jsmnf_hashes *b_hashes,
+                                 const jsmnf_pair *b);
+
+/** @brief Binary formats of jsmnf_transcode() */
+enum jsmnf_transcode_format {
+    /** CBOR, RFC 8949 */
+    JSMNF_TRANSCODE_CBOR,
+    /** MessagePack */
+    JSMNF_TRANSCODE_MSGPACK
+};
+
+/**
+ * @brief Transcode a loaded subtree into a compact binary format
+ *
+ * Numbers are encoded as the smallest integer that holds them, or else as
+ *      a single precision float when exact and as a double otherwise, and
+ *      strings are unescaped straight into `buf`
+ * @note integers beyond the format's range, such as below `INT64_MIN` for
+ *      MessagePack, are encoded as doubles, and numbers too large for a
+ *      double, such as `1e400`, as infinities
+ *
+ * @param[in] pair the @ref jsmnf_pair to be transcoded
+ * @param[in] js the JSON string of `pair`
+ * @param[in] format the binary format
+ * @param[out] buf the buffer to write to
+ * @param[in] bufsize `buf` size in bytes
+ * @return a `enum jsmnerr` value for error or the amount of bytes written
+ */
+JSMN_API long jsmnf_transcode(const jsmnf_pair *pair,
+                              const char js[],
+                              enum jsmnf_transcode_format format,
+                              char buf[],
+                              size_t bufsize);
+
+/**
+ * @brief jsmnf_transcode() counterpart that streams straight from jsmn
+ *      tokens, without loading pairs
+ *
+ * @param[in] js the JSON string
+ * @param[in] tokens jsmn tokens parsed from `js`
+ * @param[in] num_tokens amount of tokens
+ * @param[in] format the binary format
+ * @param[out] buf the buffer to write to
+ * @param[in] bufsize `buf` size in bytes
+ * @return a `enum jsmnerr` value for error or the amount of bytes written
+ */
+JSMN_API long jsmnf_transcode_tokens(const char js[],
+                                     const jsmntok_t tokens[],
+                                     unsigned num_tokens,
+                                     enum jsmnf_transcode_format format,
+                                     char buf[],
+                                     size_t bufsize);
+
+#ifndef JSMN_HEADER
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <math.h>
+#include <float.h>
+
+#if !defined(JSMNF_NO_MMAP) && (defined(__unix__) || defined(__APPLE__))
+#define _JSMNF_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define OA_HASH_STATIC
+#include "oa_hash.h"
+#undef OA_HASH_STATIC
+
+#ifndef JSMNF_MALLOC
+#define JSMNF_MALLOC(size) malloc(size)
+#endif
+#ifndef JSMNF_REALLOC
+#define JSMNF_REALLOC(ptr, size) realloc(ptr, size)
+#endif
+#ifndef JSMNF_FREE
+#define JSMNF_FREE(ptr) free(ptr)
+#endif
+
+static void *
+_jsmnf_default_alloc(void *ctx, size_t size)
+{
+    (void)ctx;
+    return JSMNF_MALLOC(size);
+}
+
+static void *
+_jsmnf_default_resize(void *ctx, void *ptr, size_t old_size, size_t new_size)
+{
+    (void)ctx;
+    (void)old_size;
+    return JSMNF_REALLOC(ptr, new_size);
+}
+
+static void
+_jsmnf_default_release(void *ctx, void *ptr)
+{
+    (void)ctx;
+    JSMNF_FREE(ptr);
+}
+
+static const struct jsmnf_allocator _jsmnf_default_allocator = {
+    &_jsmnf_default_alloc, &_jsmnf_default_resize, &_jsmnf_default_release,
+    NULL
+};
+
+#define _JSMNF_ALLOCATOR(allocator)                                           \
+    ((allocator) ? (allocator) : &_jsmnf_default_allocator)
+
+struct _jsmnf_pair_mut {
+    JSMNF_PAIR_ATTRS(mut);
+};
+
+/* SWAR (SIMD within a register) helpers for scanning a word at a time */
+#define _JSMNF_SWAR_ONES  ((size_t)-1 / 0xFF)
+#define _JSMNF_SWAR_HIGHS (_JSMNF_SWAR_ONES * 0x80)
+/* non-zero if any byte of `w` is zero */
+#define _JSMNF_SWAR_HAS_ZERO(w)                                               \
+    (((w) - _JSMNF_SWAR_ONES) & ~(w) & _JSMNF_SWAR_HIGHS)
+/* non-zero if any byte of `w` equals `c` */
+#define _JSMNF_SWAR_HAS(w, c)                                                 \
+    _JSMNF_SWAR_HAS_ZERO((w) ^ (_JSMNF_SWAR_ONES * (unsigned char)(c)))
+/* non-zero if any byte of `w` is less than `n`, with `n` up to 128 */
+#define _JSMNF_SWAR_HAS_LESS(w, n)                                            \
+    (((w) - _JSMNF_SWAR_ONES * (n)) & ~(w) & _JSMNF_SWAR_HIGHS)
+
+/* non-zero if `tok` is a string containing escape sequences */
+static int
+_jsmnf_has_escapes(const char js[], const struct jsmntok *tok)
+{
+    return JSMN_STRING == tok->type && tok->end > tok->start
+           && memchr(js + tok->start, '\\', (size_t)(tok->end - tok->start))
+                  != NULL;
+}
+
+JSMN_API void
+jsmnf_init(jsmnf_loader *loader)
+{
+    jsmn_init(&loader->parser);
+    loader->pairnext = 0;
+    loader->root = NULL;
+    loader->keys = NULL;
+    loader->keys_len = loader->keysnext = 0;
+    loader->allocator = NULL;
+}
+
+JSMN_API void
+jsmnf_init_allocator(jsmnf_loader *loader, const jsmnf_allocator *allocator)
+{
+    loader->allocator = allocator;
+}
+
+JSMN_API void
+jsmnf_init_keys(jsmnf_loader *loader, char keys[], size_t size)
+{
+    loader->keys = keys;
+    loader->keys_len = size;
+    loader->keysnext = 0;
+}
+
+/* hash object member by its key, escaped keys are unescaped into the key
+ *      arena first so they can be matched by their unescaped form */
+static int
+_jsmnf_set_key(struct jsmnf_loader *loader,
+               const char js[],
+               struct _jsmnf_pair_mut *curr,
+               struct _jsmnf_pair_mut *element,
+               void *value)
+{
+    const char *key = js + element->k->start;
+    long len = element->k->end - element->k->start;
+
+    if ((element->flags & JSMNF_KEY_ESCAPED) && loader->keys) {
+        char *buf = loader->keys + loader->keysnext;
+
+        len = jsmnf_unescape(buf, loader->keys_len - loader->keysnext, key,
+                             (size_t)len);
+        if (len < 0) return (int)len;
+
+        loader->keysnext += (size_t)len;
+        key = buf;
+    }
+    oa_hash_set((struct oa_hash *)curr, key, (size_t)len, value);
+    return 0;
+}
+
+static long
+_jsmnf_load_pairs(struct jsmnf_loader *loader,
+                  const char js[],
+                  struct _jsmnf_pair_mut *curr,
+                  const size_t num_tokens,
+                  struct _jsmnf_pair_mut pairs[],
+                  struct oa_hash_entry buckets[],
+                  const size_t table_len)
+{
+    size_t offset = 0;
+
+    if (!num_tokens) return 0;
+
+    switch (curr->v->type) {
+    case JSMN_STRING:
+        if (_jsmnf_has_escapes(js, curr->v))
+            curr->flags |= JSMNF_VALUE_ESCAPED;
+        break;
+    case JSMN_PRIMITIVE:
+        break;
+    case JSMN_OBJECT:
+    case JSMN_ARRAY: {
+        const size_t value_size = (size_t)curr->v->size,
+                     top_idx = loader->pairnext + (1 + value_size),
+                     bottom_idx = loader->pairnext;
+        long ret;
+
+        if (value_size > (table_len - bottom_idx)
+            || top_idx > (table_len - bottom_idx))
+        {
+            return JSMN_ERROR_NOMEM;
+        }
+
+        loader->pairnext = top_idx;
+
+        oa_hash_init((struct oa_hash *)curr, &buckets[bottom_idx],
+                     top_idx - bottom_idx);
+        if (curr == NULL) {
+            abort();
+        }
+        if (JSMN_OBJECT == curr->v->type) {
+            struct _jsmnf_pair_mut *fields = pairs + bottom_idx;
+            size_t i;
+
+            /* members are counted apart from the hash table, which doesn't
+             *      count duplicate nor empty keys */
+            for (i = 0; i < value_size; ++i) {
+                struct _jsmnf_pair_mut *element = fields + i;
+
+                if (offset + 1 >= num_tokens) return JSMN_ERROR_INVAL;
+                element->k = curr->v + 1 + (offset++);
+                if (_jsmnf_has_escapes(js, element->k))
+                    element->flags |= JSMNF_KEY_ESCAPED;
+                if (element->k->size > 0) {
+                    if (offset + 1 >= num_tokens)
+                        return JSMN_ERROR_INVAL;
+                    element->v = curr->v + 1 + offset;
+                    if ((ret = _jsmnf_set_key(loader, js, curr, element,
+                                              element))
+                        < 0)
+                    {
+                        return ret;
+                    }
+                    if ((ret = _jsmnf_load_pairs(loader, js, element,
+                                                 num_tokens - 1 - offset,
+                                                 pairs, buckets, table_len))
+                        < 0)
+                    {
+                        return ret;
+                    }
+                    offset += (size_t)ret;
+                }
+                else if ((ret = _jsmnf_set_key(loader, js, curr, element,
+                                               NULL))
+                         < 0)
+                {
+                    return ret;
+                }
+            }
+            curr->fields = (struct jsmnf_pair *)fields;
+            curr->length = value_size;
+        }
+        else if (JSMN_ARRAY == curr->v->type) {
+            for (; curr->length < value_size; ++curr->length) {
+                static jsmntok_t empty_key = { 0 };
+                struct oa_hash_entry *entry = curr->buckets + curr->length;
+                struct _jsmnf_pair_mut *fields = pairs + bottom_idx,
+                                       *element = fields + curr->length;
+
+                if (offset + 1 >= num_tokens) return JSMN_ERROR_INVAL;
+                entry->state = OA_HASH_ENTRY_OCCUPIED;
+                entry->value = element;
+                element->v = curr->v + 1 + offset;
+                element->k = &empty_key;
+                if ((ret = _jsmnf_load_pairs(loader, js, element,
+                                             num_tokens - 1 - offset, pairs,
+                                             buckets, table_len))
+                    < 0)
+                {
+                    return ret;
+                }
+                curr->fields = (struct jsmnf_pair *)fields;
+                offset += (size_t)ret;
+            }
+        }
+        break;
+    }
+    default:
+    case JSMN_UNDEFINED:
+        return JSMN_ERROR_INVAL;
+    }
+
+    return (long)offset + 1;
+}
+
+JSMN_API long
+jsmnf_load(struct jsmnf_loader *loader,
+           const char js[],
+           const size_t len,
+           struct jsmnf_table table[],
+           const size_t table_len)
+{
+    struct jsmntok *tokens = (struct jsmntok *)table;
+    struct _jsmnf_pair_mut
+        *pairs = (struct _jsmnf_pair_mut *)(((char *)tokens)
+                                            + (table_len * sizeof *tokens)),
+        *mut_root = &pairs[0];
+    struct oa_hash_entry *buckets =
+        (struct oa_hash_entry *)(((char *)pairs)
+                                 + (table_len * sizeof *pairs));
+    long ret;
+
+    if (loader->pairnext == 0) { /* first run, initialize pairs */
+        /* initialize tokens if not already initialized */
+        if (loader->parser.toknext == 0) {
+            /* jsmn token offsets are `int` and their count is `unsigned` */
+            const unsigned num_tokens =
+                table_len > UINT_MAX ? UINT_MAX : (unsigned)table_len;
+
+            if (len > INT_MAX) return JSMNF_ERROR_RANGE;
+
+            memset(tokens, 0, table_len * sizeof *tokens);
+            if ((ret = jsmn_parse(&loader->parser, js, len, tokens,
+                                  num_tokens))
+                < 0)
+            {
+                return jsmn_init(&loader->parser), ret;
+            }
+        }
+        memset(pairs, 0, table_len * sizeof *pairs);
+        memset(buckets, 0, table_len * sizeof *buckets);
+        loader->keysnext = 0;
+        mut_root->v = tokens + loader->pairnext++;
+        loader->root = (struct jsmnf_pair *)mut_root;
+    }
+    if ((ret = _jsmnf_load_pairs(loader, js, mut_root, loader->parser.toknext,
+                                 pairs, buckets, table_len))
+        < 0)
+    {
+        /* TODO: rather than reseting pairnext keep the last 'bucket' ptr
+         * stored, so it can continue from there in the next try */
+        loader->pairnext = 0;
+        loader->root = NULL;
+    }
+    return ret;
+}
+
+/* next sibling of `tok`, tokens are sorted by their starting position, so
+ *      containers can be skipped with a binary search */
+static const struct jsmntok *
+_jsmnf_skip(const struct jsmntok *tok, const struct jsmntok *end)
+{
+    const struct jsmntok *lo = tok + 1, *hi = end;
+
+    if (JSMN_OBJECT != tok->type && JSMN_ARRAY != tok->type) return lo;
+
+    while (lo < hi) {
+        const struct jsmntok *mid = lo + (hi - lo) / 2;
+
+        if (mid->start < tok->end)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+struct _jsmnf_keyframe {
+    const struct _jsmnf_keyframe *parent;
+    /** key token for object members, NULL for array elements */
+    const struct jsmntok *key;
+    /** index for array elements */
+    unsigned index;
+    /** depth level of the member */
+    unsigned depth;
+};
+
+enum _jsmnf_projection {
+    _JSMNF_PROJECTION_SKIP = 0,
+    _JSMNF_PROJECTION_PARTIAL,
+    _JSMNF_PROJECTION_KEEP
+};
+
+static enum _jsmnf_projection
+_jsmnf_projection_match(const char js[],
+                        const struct jsmnf_keypath paths[],
+                        const unsigned num_paths,
+                        const struct _jsmnf_keyframe *frame)
+{
+    enum _jsmnf_projection ret = _JSMNF_PROJECTION_SKIP;
+    unsigned i;
+
+    for (i = 0; i < num_paths; ++i) {
+        const struct _jsmnf_keyframe *f;
+
+        if (frame->depth > paths[i].depth) continue;
+
+        for (f = frame; f != NULL; f = f->parent) {
+            const char *key = paths[i].keys[f->depth - 1];
+
+            if ('*' == key[0] && '\0' == key[1]) continue;
+
+            if (f->key) {
+                const size_t len = (size_t)(f->key->end - f->key->start);
+                if (strlen(key) != len || memcmp(key, js + f->key->start, len))
+                    break;
+            }
+            else {
+                char *endptr;
+                const unsigned long idx = strtoul(key, &endptr, 10);
+                if (endptr == key || *endptr != '\0' || idx != f->index) break;
+            }
+        }
+        if (f != NULL) continue;
+
+        if (frame->depth == paths[i].depth) return _JSMNF_PROJECTION_KEEP;
+        ret = _JSMNF_PROJECTION_PARTIAL;
+    }
+    return ret;
+}
+
+static long
+_jsmnf_load_projected_pairs(struct jsmnf_loader *loader,
+                            const char js[],
+                            struct _jsmnf_pair_mut *curr,
+                            const struct _jsmnf_keyframe *frame,
+                            const struct jsmntok *end,
+                            const struct jsmnf_keypath paths[],
+                            const unsigned num_paths,
+                            struct _jsmnf_pair_mut pairs[],
+                            struct oa_hash_entry buckets[],
+                            const size_t table_len)
+{
+    static jsmntok_t empty_key = { 0 };
+    const unsigned value_size = (unsigned)curr->v->size;
+    struct _jsmnf_keyframe child;
+    struct _jsmnf_pair_mut *fields;
+    const struct jsmntok *tok;
+    size_t bottom_idx, top_idx;
+    unsigned i, kept = value_size;
+    long ret;
+
+    if (JSMN_OBJECT != curr->v->type && JSMN_ARRAY != curr->v->type)
+        return 0;
+
+    child.parent = frame;
+    child.depth = frame ? frame->depth + 1 : 1;
+    child.key = NULL;
+
+    /* count object members to be kept, arrays are kept whole to preserve
+     * their indexes */
+    if (JSMN_OBJECT == curr->v->type) {
+        for (kept = 0, i = 0, tok = curr->v + 1; i < value_size; ++i) {
+            if (tok + 1 >= end) return JSMN_ERROR_INVAL;
+            child.key = tok;
+            if (_jsmnf_projection_match(js, paths, num_paths, &child))
+                ++kept;
+            tok = _jsmnf_skip(tok + 1, end);
+        }
+    }
+
+    bottom_idx = loader->pairnext;
+    top_idx = bottom_idx + 1 + kept;
+    if (top_idx > table_len) return JSMN_ERROR_NOMEM;
+
+    loader->pairnext = top_idx;
+
+    oa_hash_init((struct oa_hash *)curr, &buckets[bottom_idx],
+                 top_idx - bottom_idx);
+    fields = pairs + bottom_idx;
+    curr->fields = (struct jsmnf_pair *)fields;
+
+    for (i = 0, kept = 0, tok = curr->v + 1; i < value_size; ++i) {
+        const struct jsmntok *value = tok;
+        struct _jsmnf_pair_mut *element;
+        enum _jsmnf_projection match;
+
+        if (tok >= end) return JSMN_ERROR_INVAL;
+
+        if (JSMN_OBJECT == curr->v->type) {
+            child.key = tok;
+            value = tok + 1;
+            tok = _jsmnf_skip(tok + 1, end);
+        }
+        else {
+            child.index = i;
+            tok = _jsmnf_skip(tok, end);
+        }
+        match = _jsmnf_projection_match(js, paths, num_paths, &child);
+        if (_JSMNF_PROJECTION_SKIP == match) continue;
+
+        if (JSMN_OBJECT == curr->v->type) {
+            /* members are counted apart from the hash table, which doesn't
+             *      count duplicate nor empty keys */
+            element = fields + kept++;
+            element->k = (struct jsmntok *)child.key;
+            element->v = (struct jsmntok *)value;
+            if (_jsmnf_has_escapes(js, element->k))
+                element->flags |= JSMNF_KEY_ESCAPED;
+            if ((ret = _jsmnf_set_key(loader, js, curr, element, element))
+                < 0)
+            {
+                return ret;
+            }
+        }
+        else {
+            struct oa_hash_entry *entry = curr->buckets + i;
+
+            element = fields + i;
+            entry->state = OA_HASH_ENTRY_OCCUPIED;
+            entry->value = element;
+            element->k = &empty_key;
+            element->v = (struct jsmntok *)value;
+        }
+
+        if (_JSMNF_PROJECTION_KEEP == match) {
+            ret = _jsmnf_load_pairs(loader, js, element,
+                                    (size_t)(end - element->v), pairs,
+                                    buckets, table_len);
+        }
+        else {
+            ret = _jsmnf_load_projected_pairs(loader, js, element, &child,
+                                              end, paths, num_paths, pairs,
+                                              buckets, table_len);
+        }
+        if (ret < 0) return ret;
+    }
+    /* arrays keep the slots of skipped elements to preserve their indexes */
+    curr->length = JSMN_OBJECT == curr->v->type ? kept : value_size;
+    return 0;
+}
+
+JSMN_API long
+jsmnf_load_projected(struct jsmnf_loader *loader,
+                     const char js[],
+                     const struct jsmntok tokens[],
+                     const unsigned num_tokens,
+                     const struct jsmnf_keypath paths[],
+                     const unsigned num_paths,
+                     struct jsmnf_index index[],
+                     const size_t index_len)
+{
+    struct _jsmnf_pair_mut *pairs = (struct _jsmnf_pair_mut *)index,
+                           *mut_root = &pairs[0];
+    struct oa_hash_entry *buckets =
+        (struct oa_hash_entry *)(((char *)pairs)
+                                 + (index_len * sizeof *pairs));
+    long ret;
+
+    loader->pairnext = 0;
+    loader->root = NULL;
+    loader->keysnext = 0;
+
+    if (!num_tokens) return 0;
+    if (!index_len) return JSMN_ERROR_NOMEM;
+
+    memset(pairs, 0, index_len * sizeof *pairs);
+    memset(buckets, 0, index_len * sizeof *buckets);
+    mut_root->v = (struct jsmntok *)tokens;
+    loader->pairnext = 1;
+
+    if (NULL == paths)
+        ret = _jsmnf_load_pairs(loader, js, mut_root, num_tokens, pairs,
+                                buckets, index_len);
+    else
+        ret = _jsmnf_load_projected_pairs(loader, js, mut_root, NULL,
+                                          tokens + num_tokens, paths,
+                                          num_paths, pairs, buckets,
+                                          index_len);
+    if (ret < 0) {
+        loader->pairnext = 0;
+        return ret;
+    }
+    loader->root = (struct jsmnf_pair *)mut_root;
+    return (long)loader->pairnext;
+}
+
+JSMN_API long
+jsmnf_load_tokens(struct jsmnf_loader *loader,
+                  const char js[],
+                  const struct jsmntok tokens[],
+                  const unsigned num_tokens,
+                  struct jsmnf_index index[],
+                  const size_t index_len)
+{
+    return jsmnf_load_projected(loader, js, tokens, num_tokens, NULL, 0,
+                                index, index_len);
+}
+
+JSMN_API const struct jsmnf_pair *
+jsmnf_find(const struct jsmnf_pair *head,
+           const char key[],
+           const size_t length)
+{
+    if (!head || !head->v) return NULL;
+    if (!key && !length) return head;
+
+    if (JSMN_OBJECT == head->v->type) {
+        return oa_hash_get((struct oa_hash *)head, key, length);
+    }
+    if (JSMN_ARRAY == head->v->type) {
+        char *endptr;
+        const unsigned idx = (unsigned)strtoul(key, &endptr, 10);
+        if (endptr != key && (idx < head->length)
+            && head->buckets[idx].state == OA_HASH_ENTRY_OCCUPIED)
+        {
+            return head->buckets[idx].value;
+        }
+    }
+    return NULL;
+}
+
+JSMN_API const struct jsmnf_pair *
+jsmnf_find_path(const struct jsmnf_pair *head,
                 char *const path[],
                 unsigned depth)
 {
-    const struct jsmnf_pair *iter = head, *found = NULL;
-    unsigned i;
-    for (i = 0; i < depth; ++i) {
-        if (!iter || !(found = jsmnf_find(iter, path[i], strlen(path[i]))))
+    const struct jsmnf_pair *iter = head, *found = NULL;
+    unsigned i;
+    for (i = 0; i < depth; ++i) {
+        if (!iter || !(found = jsmnf_find(iter, path[i], strlen(path[i]))))
+            break;
+        iter = found;
+    }
+    return found;
+}
+
+/* double `*prev_size`, refusing to grow past `max_len` elements or to
+ *      overflow the allocation size */
+#define RECALLOC_OR_ERROR(allocator, ptr, prev_size, max_len)                 \
+    do {                                                                      \
+        const size_t max = (size_t)-1 / sizeof *(ptr) < (max_len)             \
+                               ? (size_t)-1 / sizeof *(ptr)                   \
+                               : (max_len);                                   \
+        size_t new_size;                                                      \
+        void *tmp;                                                            \
+        if (*(prev_size) > max / 2) return JSMN_ERROR_NOMEM;                  \
+        new_size = (size_t)*(prev_size) * 2;                                  \
+        if (!(tmp = (allocator)->resize((allocator)->ctx, (ptr),              \
+                                        *(prev_size) * sizeof *(ptr),         \
+                                        new_size * sizeof *(ptr))))           \
+            return JSMN_ERROR_NOMEM;                                          \
+        (ptr) = tmp;                                                          \
+        memset((ptr) + *(prev_size), 0,                                       \
+               (new_size - *(prev_size)) * sizeof *(ptr));                    \
+        *(prev_size) = new_size;                                              \
+    } while (0)
+
+JSMN_API long
+jsmn_parse_auto(struct jsmn_parser *parser,
+                const char js[],
+                const size_t len,
+                struct jsmntok **p_tokens,
+                unsigned *num_tokens)
+{
+    const struct jsmnf_allocator *allocator = &_jsmnf_default_allocator;
+    int ret;
+
+    if (len > INT_MAX) return JSMNF_ERROR_RANGE;
+
+    if (NULL == *p_tokens || 0 == *num_tokens) {
+        if (!(*p_tokens = allocator->alloc(allocator->ctx, sizeof **p_tokens)))
+        {
+            return JSMN_ERROR_NOMEM;
+        }
+        memset(*p_tokens, 0, sizeof **p_tokens);
+        *num_tokens = 1;
+    }
+    while ((ret = jsmn_parse(parser, js, len, *p_tokens, *num_tokens))
+           == JSMN_ERROR_NOMEM)
+    {
+        RECALLOC_OR_ERROR(allocator, *p_tokens, num_tokens, UINT_MAX);
+    }
+    return ret;
+}
+
+JSMN_API long
+jsmnf_load_auto(struct jsmnf_loader *loader,
+                const char js[],
+                const size_t len,
+                struct jsmnf_table **p_table,
+                size_t *table_len)
+{
+    const struct jsmnf_allocator *allocator =
+        _JSMNF_ALLOCATOR(loader->allocator);
+    long ret;
+
+    if (NULL == *p_table || 0 == *table_len) {
+        if (!(*p_table = allocator->alloc(allocator->ctx, sizeof **p_table))) {
+            return JSMN_ERROR_NOMEM;
+        }
+        memset(*p_table, 0, sizeof **p_table);
+        *table_len = 1;
+    }
+    while ((ret = jsmnf_load(loader, js, len, *p_table, *table_len))
+           == JSMN_ERROR_NOMEM)
+    {
+        RECALLOC_OR_ERROR(allocator, *p_table, table_len, (size_t)-1);
+    }
+    return ret;
+}
+
+JSMN_API long
+jsmnf_load_tokens_auto(struct jsmnf_loader *loader,
+                       const char js[],
+                       const struct jsmntok tokens[],
+                       const unsigned num_tokens,
+                       struct jsmnf_index **p_index,
+                       size_t *index_len)
+{
+    const struct jsmnf_allocator *allocator =
+        _JSMNF_ALLOCATOR(loader->allocator);
+    long ret;
+
+    if (NULL == *p_index || 0 == *index_len) {
+        /* a token has at most one pair, so start from there */
+        const size_t len = num_tokens ? num_tokens : 1;
+
+        if (len > (size_t)-1 / sizeof **p_index
+            || !(*p_index = allocator->alloc(allocator->ctx,
+                                             len * sizeof **p_index)))
+        {
+            return JSMN_ERROR_NOMEM;
+        }
+        *index_len = len;
+    }
+    while ((ret = jsmnf_load_tokens(loader, js, tokens, num_tokens, *p_index,
+                                    *index_len))
+           == JSMN_ERROR_NOMEM)
+    {
+        RECALLOC_OR_ERROR(allocator, *p_index, index_len, (size_t)-1);
+    }
+    return ret;
+}
+
+#undef RECALLOC_OR_ERROR
+
+static int
+_jsmnf_read_4_digits(char *s, const char *end, unsigned *p_hex)
+{
+    char buf[5] = { 0 };
+    int i;
+
+    if (end - s < 4) return JSMN_ERROR_PART;
+
+    for (i = 0; i < 4; i++) {
+        buf[i] = s[i];
+        if (('0' <= s[i] && s[i] <= '9') || ('A' <= s[i] && s[i] <= 'F')
+            || ('a' <= s[i] && s[i] <= 'f'))
+        {
+            continue;
+        }
+        return JSMN_ERROR_INVAL;
+    }
+
+    *p_hex = (unsigned)strtoul(buf, NULL, 16);
+
+    return 4;
+}
+
+#define _JSMNF_UTF16_IS_FIRST_SURROGATE(c)                                    \
+    (0xD800 <= (unsigned)c && (unsigned)c <= 0xDBFF)
+#define _JSMNF_UTF16_IS_SECOND_SURROGATE(c)                                   \
+    (0xDC00 <= (unsigned)c && (unsigned)c <= 0xDFFF)
+#define _JSMNF_UTF16_JOIN_SURROGATE(c1, c2)                                   \
+    (((((unsigned long)c1 & 0x3FF) << 10) | ((unsigned)c2 & 0x3FF)) + 0x10000)
+/* Keiser-Lemire UTF-8 validation, each byte is checked against its
+ *      predecessor with three nibble lookup tables whose entries are ANDed
+ *      together, leaving only the error bits the byte pair triggers
+ *      See: https://arxiv.org/abs/2010.03090 */
+#define _JSMNF_UTF8_TOO_SHORT      (1 << 0)
+#define _JSMNF_UTF8_TOO_LONG       (1 << 1)
+#define _JSMNF_UTF8_OVERLONG_3     (1 << 2)
+#define _JSMNF_UTF8_TOO_LARGE      (1 << 3)
+#define _JSMNF_UTF8_SURROGATE      (1 << 4)
+#define _JSMNF_UTF8_OVERLONG_2     (1 << 5)
+#define _JSMNF_UTF8_TOO_LARGE_1000 (1 << 6)
+#define _JSMNF_UTF8_OVERLONG_4     (1 << 6)
+#define _JSMNF_UTF8_TWO_CONTS      (1 << 7)
+#define _JSMNF_UTF8_CARRY                                                     \
+    (_JSMNF_UTF8_TOO_SHORT | _JSMNF_UTF8_TOO_LONG | _JSMNF_UTF8_TWO_CONTS)
+
+JSMN_API long
+jsmnf_utf8_validate(const char src[], size_t len)
+{
+    static const unsigned char byte_1_high[16] = {
+        /* 0_______ ASCII */
+        _JSMNF_UTF8_TOO_LONG, _JSMNF_UTF8_TOO_LONG, _JSMNF_UTF8_TOO_LONG,
+        _JSMNF_UTF8_TOO_LONG, _JSMNF_UTF8_TOO_LONG, _JSMNF_UTF8_TOO_LONG,
+        _JSMNF_UTF8_TOO_LONG, _JSMNF_UTF8_TOO_LONG,
+        /* 10______ continuation */
+        _JSMNF_UTF8_TWO_CONTS, _JSMNF_UTF8_TWO_CONTS, _JSMNF_UTF8_TWO_CONTS,
+        _JSMNF_UTF8_TWO_CONTS,
+        /* 1100____ two byte lead */
+        _JSMNF_UTF8_TOO_SHORT | _JSMNF_UTF8_OVERLONG_2,
+        /* 1101____ two byte lead */
+        _JSMNF_UTF8_TOO_SHORT,
+        /* 1110____ three byte lead */
+        _JSMNF_UTF8_TOO_SHORT | _JSMNF_UTF8_OVERLONG_3
+            | _JSMNF_UTF8_SURROGATE,
+        /* 1111____ four+ byte lead */
+        _JSMNF_UTF8_TOO_SHORT | _JSMNF_UTF8_TOO_LARGE
+            | _JSMNF_UTF8_TOO_LARGE_1000 | _JSMNF_UTF8_OVERLONG_4
+    };
+    static const unsigned char byte_1_low[16] = {
+        /* ____0000 */
+        _JSMNF_UTF8_CARRY | _JSMNF_UTF8_OVERLONG_3 | _JSMNF_UTF8_OVERLONG_2
+            | _JSMNF_UTF8_OVERLONG_4,
+        /* ____0001 */
+        _JSMNF_UTF8_CARRY | _JSMNF_UTF8_OVERLONG_2,
+        /* ____001_ */
+        _JSMNF_UTF8_CARRY, _JSMNF_UTF8_CARRY,
+        /* ____0100 */
+        _JSMNF_UTF8_CARRY | _JSMNF_UTF8_TOO_LARGE,
+        /* ____0101 */
+        _JSMNF_UTF8_CARRY | _JSMNF_UTF8_TOO_LARGE | _JSMNF_UTF8_TOO_LARGE_1000,
+        /* ____011_ */
+        _JSMNF_UTF8_CARRY | _JSMNF_UTF8_TOO_LARGE | _JSMNF_UTF8_TOO_LARGE_1000,
+        _JSMNF_UTF8_CARRY | _JSMNF_UTF8_TOO_LARGE | _JSMNF_UTF8_TOO_LARGE_1000,
+        /* ____1___ */
+        _JSMNF_UTF8_CARRY | _JSMNF_UTF8_TOO_LARGE | _JSMNF_UTF8_TOO_LARGE_1000,
+        _JSMNF_UTF8_CARRY | _JSMNF_UTF8_TOO_LARGE | _JSMNF_UTF8_TOO_LARGE_1000,
+        _JSMNF_UTF8_CARRY | _JSMNF_UTF8_TOO_LARGE | _JSMNF_UTF8_TOO_LARGE_1000,
+        _JSMNF_UTF8_CARRY | _JSMNF_UTF8_TOO_LARGE | _JSMNF_UTF8_TOO_LARGE_1000,
+        _JSMNF_UTF8_CARRY | _JSMNF_UTF8_TOO_LARGE | _JSMNF_UTF8_TOO_LARGE_1000,
+        /* ____1101 */
+        _JSMNF_UTF8_CARRY | _JSMNF_UTF8_TOO_LARGE | _JSMNF_UTF8_TOO_LARGE_1000
+            | _JSMNF_UTF8_SURROGATE,
+        _JSMNF_UTF8_CARRY | _JSMNF_UTF8_TOO_LARGE | _JSMNF_UTF8_TOO_LARGE_1000,
+        _JSMNF_UTF8_CARRY | _JSMNF_UTF8_TOO_LARGE | _JSMNF_UTF8_TOO_LARGE_1000
+    };
+    static const unsigned char byte_2_high[16] = {
+        /* 0_______ ASCII */
+        _JSMNF_UTF8_TOO_SHORT, _JSMNF_UTF8_TOO_SHORT, _JSMNF_UTF8_TOO_SHORT,
+        _JSMNF_UTF8_TOO_SHORT, _JSMNF_UTF8_TOO_SHORT, _JSMNF_UTF8_TOO_SHORT,
+        _JSMNF_UTF8_TOO_SHORT, _JSMNF_UTF8_TOO_SHORT,
+        /* 1000____ */
+        _JSMNF_UTF8_TOO_LONG | _JSMNF_UTF8_OVERLONG_2 | _JSMNF_UTF8_TWO_CONTS
+            | _JSMNF_UTF8_OVERLONG_3 | _JSMNF_UTF8_TOO_LARGE_1000
+            | _JSMNF_UTF8_OVERLONG_4,
+        /* 1001____ */
+        _JSMNF_UTF8_TOO_LONG | _JSMNF_UTF8_OVERLONG_2 | _JSMNF_UTF8_TWO_CONTS
+            | _JSMNF_UTF8_OVERLONG_3 | _JSMNF_UTF8_TOO_LARGE,
+        /* 101_____ */
+        _JSMNF_UTF8_TOO_LONG | _JSMNF_UTF8_OVERLONG_2 | _JSMNF_UTF8_TWO_CONTS
+            | _JSMNF_UTF8_SURROGATE | _JSMNF_UTF8_TOO_LARGE,
+        _JSMNF_UTF8_TOO_LONG | _JSMNF_UTF8_OVERLONG_2 | _JSMNF_UTF8_TWO_CONTS
+            | _JSMNF_UTF8_SURROGATE | _JSMNF_UTF8_TOO_LARGE,
+        /* 11______ lead */
+        _JSMNF_UTF8_TOO_SHORT, _JSMNF_UTF8_TOO_SHORT, _JSMNF_UTF8_TOO_SHORT,
+        _JSMNF_UTF8_TOO_SHORT
+    };
+    const unsigned char *p = (const unsigned char *)src, *const end = p + len;
+    unsigned prev1 = 0, prev2 = 0, prev3 = 0;
+
+    while (p < end) {
+        unsigned cur, special, must_be_cont;
+
+        /* skip ASCII runs a word at a time while no sequence is pending */
+        if ((prev1 | prev2 | prev3) < 0x80) {
+            size_t w[2];
+
+            while ((size_t)(end - p) >= sizeof w) {
+                memcpy(w, p, sizeof w);
+                if ((w[0] | w[1]) & _JSMNF_SWAR_HIGHS) break;
+                p += sizeof w;
+            }
+            if (p == end) break;
+        }
+
+        cur = *p++;
+        special = byte_1_high[prev1 >> 4] & byte_1_low[prev1 & 0xF]
+                  & byte_2_high[cur >> 4];
+        /* a continuation following another is only valid as the third or
+         * fourth byte of a sequence */
+        must_be_cont = (prev2 >= 0xE0 || prev3 >= 0xF0) ? 0x80 : 0;
+        if ((special ^ must_be_cont) != 0) return JSMN_ERROR_INVAL;
+
+        prev3 = prev2;
+        prev2 = prev1;
+        prev1 = cur;
+    }
+    /* incomplete sequence at the end */
+    if (prev1 >= 0xC0 || prev2 >= 0xE0 || prev3 >= 0xF0)
+        return JSMN_ERROR_INVAL;
+
+    return (long)len;
+}
+
+#undef _JSMNF_UTF8_TOO_SHORT
+#undef _JSMNF_UTF8_TOO_LONG
+#undef _JSMNF_UTF8_OVERLONG_3
+#undef _JSMNF_UTF8_TOO_LARGE
+#undef _JSMNF_UTF8_SURROGATE
+#undef _JSMNF_UTF8_OVERLONG_2
+#undef _JSMNF_UTF8_TOO_LARGE_1000
+#undef _JSMNF_UTF8_OVERLONG_4
+#undef _JSMNF_UTF8_TWO_CONTS
+#undef _JSMNF_UTF8_CARRY
+
+static unsigned
+_jsmnf_utf8_encode(unsigned long value, char utf8_seq[4])
+{
+    if (value <= 0x7F) {
+        utf8_seq[0] = value;
+        return 1;
+    }
+    if (value <= 0x7FF) {
+        utf8_seq[0] = (value >> 6) | 0xC0;
+        utf8_seq[1] = (value & 0x3F) | 0x80;
+        return 2;
+    }
+    if (value <= 0xFFFF) {
+        utf8_seq[0] = (value >> 12) | 0xE0;
+        utf8_seq[1] = ((value >> 6) & 0x3F) | 0x80;
+        utf8_seq[2] = (value & 0x3F) | 0x80;
+        return 3;
+    }
+    utf8_seq[0] = (value >> 18) | 0xF0;
+    utf8_seq[1] = ((value >> 12) & 0x3F) | 0x80;
+    utf8_seq[2] = ((value >> 6) & 0x3F) | 0x80;
+    utf8_seq[3] = (value & 0x3F) | 0x80;
+    return 4;
+}
+
+static int
+_jsmnf_utf8_append(unsigned long hex, char *buf_tok, const char *buf_end)
+{
+    char utf8_seq[4];
+    unsigned utf8_seqlen = _jsmnf_utf8_encode(hex, utf8_seq);
+    unsigned i;
+
+    if (utf8_seqlen > (size_t)(buf_end - buf_tok)) return JSMN_ERROR_NOMEM;
+
+    for (i = 0; i < utf8_seqlen; ++i)
+        buf_tok[i] = utf8_seq[i];
+    return utf8_seqlen;
+}
+
+#define BUF_PUSH(buf_tok, c, buf_end)                                         \
+    do {                                                                      \
+        if (buf_tok >= buf_end) return JSMN_ERROR_NOMEM;                      \
+        *buf_tok++ = c;                                                       \
+    } while (0)
+
+/* first byte from `p` that is either a backslash or a control character */
+static const char *
+_jsmnf_unescape_run(const char *p, const char *end)
+{
+    size_t w[2];
+
+    while ((size_t)(end - p) >= sizeof w) {
+        memcpy(w, p, sizeof w);
+        if (_JSMNF_SWAR_HAS(w[0], '\\') || _JSMNF_SWAR_HAS_LESS(w[0], 0x20)
+            || _JSMNF_SWAR_HAS(w[1], '\\') || _JSMNF_SWAR_HAS_LESS(w[1], 0x20))
+        {
+            break;
+        }
+        p += sizeof w;
+    }
+    while (p < end && *p != '\\' && (unsigned char)*p >= 0x20)
+        ++p;
+    return p;
+}
+
+JSMN_API long
+jsmnf_unescape(char buf[], size_t bufsize, const char src[], size_t len)
+{
+    char *src_tok = (char *)src, *const src_end = src_tok + len;
+    char *buf_tok = buf, *const buf_end = buf + bufsize;
+    int second_surrogate_expected = 0;
+    unsigned first_surrogate = 0;
+
+    while (src_tok < src_end) {
+        const char *run = _jsmnf_unescape_run(src_tok, src_end);
+        char c;
+
+        /* bulk copy bytes that need no unescaping */
+        if (run != src_tok) {
+            const size_t run_len = (size_t)(run - src_tok);
+
+            if (second_surrogate_expected) return JSMN_ERROR_INVAL;
+            if (run_len > (size_t)(buf_end - buf_tok)) return JSMN_ERROR_NOMEM;
+
+            /* skipped when unescaping in place and nothing was dropped */
+            if (buf_tok != src_tok) memmove(buf_tok, src_tok, run_len);
+            buf_tok += run_len;
+            src_tok += run_len;
+            if (src_tok == src_end) break;
+        }
+
+        if (!(c = *src_tok++)) break;
+
+        if (c != '\\') return JSMN_ERROR_INVAL;
+
+        /* expects escaping but src is a well-formed string */
+        if (src_tok >= src_end || !*src_tok) return JSMN_ERROR_PART;
+
+        c = *src_tok++;
+
+        if (second_surrogate_expected && c != 'u') return JSMN_ERROR_INVAL;
+
+        switch (c) {
+        case '"':
+        case '\\':
+        case '/':
+            BUF_PUSH(buf_tok, c, buf_end);
+            break;
+        case 'b':
+            BUF_PUSH(buf_tok, '\b', buf_end);
+            break;
+        case 'f':
+            BUF_PUSH(buf_tok, '\f', buf_end);
+            break;
+        case 'n':
+            BUF_PUSH(buf_tok, '\n', buf_end);
+            break;
+        case 'r':
+            BUF_PUSH(buf_tok, '\r', buf_end);
+            break;
+        case 't':
+            BUF_PUSH(buf_tok, '\t', buf_end);
+            break;
+        case 'u': {
+            unsigned hex;
+            int ret = _jsmnf_read_4_digits(src_tok, src_end, &hex);
+
+            if (ret != 4) return ret;
+
+            src_tok += ret;
+
+            if (second_surrogate_expected) {
+                if (!_JSMNF_UTF16_IS_SECOND_SURROGATE(hex))
+                    return JSMN_ERROR_INVAL;
+
+                ret = _jsmnf_utf8_append(
+                    _JSMNF_UTF16_JOIN_SURROGATE(first_surrogate, hex), buf_tok,
+                    buf_end);
+                if (ret < 0) return ret;
+
+                buf_tok += ret;
+
+                second_surrogate_expected = 0;
+            }
+            else if (_JSMNF_UTF16_IS_FIRST_SURROGATE(hex)) {
+                second_surrogate_expected = 1;
+                first_surrogate = hex;
+            }
+            else {
+                ret = _jsmnf_utf8_append(hex, buf_tok, buf_end);
+                if (ret < 0) return ret;
+
+                buf_tok += ret;
+            }
+        } break;
+        default:
+            return JSMN_ERROR_INVAL;
+        }
+    }
+    return jsmnf_utf8_validate(buf, (size_t)(buf_tok - buf));
+}
+
+#undef BUF_PUSH
+
+JSMN_API long
+jsmnf_unescape_inplace(char js[], jsmntok_t *tok)
+{
+    size_t len;
+    long ret;
+
+    if (tok->start < 0 || tok->end < tok->start) return JSMN_ERROR_INVAL;
+
+    len = (size_t)(tok->end - tok->start);
+    /* the write cursor never gets ahead of the read cursor */
+    ret = jsmnf_unescape(js + tok->start, len, js + tok->start, len);
+    if (ret < 0) return ret;
+
+    tok->end = tok->start + (int)ret;
+    return ret;
+}
+
+static long
+_jsmnf_unescape_pairs(struct _jsmnf_pair_mut *curr, char js[])
+{
+    struct _jsmnf_pair_mut *fields = (struct _jsmnf_pair_mut *)curr->fields;
+    const size_t length = curr->length;
+    long count = 0, ret;
+    int rekey = 0;
+    size_t i;
+
+    if (!curr->v) return 0;
+
+    switch (curr->v->type) {
+    case JSMN_STRING:
+        if (!(curr->flags & JSMNF_VALUE_ESCAPED)) return 0;
+        if ((ret = jsmnf_unescape_inplace(js, curr->v)) < 0) return ret;
+        curr->flags &= ~JSMNF_VALUE_ESCAPED;
+        return 1;
+    case JSMN_OBJECT:
+    case JSMN_ARRAY:
+        if (!fields) return 0;
+        break;
+    default:
+        return 0;
+    }
+
+    for (i = 0; i < length; ++i) {
+        struct _jsmnf_pair_mut *element = fields + i;
+
+        if (element->flags & JSMNF_KEY_ESCAPED) {
+            if ((ret = jsmnf_unescape_inplace(js, element->k)) < 0)
+                return ret;
+            element->flags &= ~JSMNF_KEY_ESCAPED;
+            rekey = 1;
+            ++count;
+        }
+        if ((ret = _jsmnf_unescape_pairs(element, js)) < 0) return ret;
+        count += ret;
+    }
+
+    /* keys hash differently once unescaped, fill the buckets all over */
+    if (rekey) {
+        oa_hash_init((struct oa_hash *)curr, curr->buckets, curr->capacity);
+        for (i = 0; i < length; ++i) {
+            struct _jsmnf_pair_mut *element = fields + i;
+
+            oa_hash_set((struct oa_hash *)curr, js + element->k->start,
+                        element->k->end - element->k->start,
+                        element->v ? element : NULL);
+        }
+        /* the table counts unique keys only, keep counting every member */
+        curr->length = length;
+    }
+    return count;
+}
+
+JSMN_API long
+jsmnf_unescape_all(struct jsmnf_loader *loader, char js[])
+{
+    if (!loader->pairnext || !loader->root) return JSMN_ERROR_INVAL;
+
+    return _jsmnf_unescape_pairs((struct _jsmnf_pair_mut *)loader->root, js);
+}
+
+JSMN_API int
+jsmnf_is_raw(const struct jsmnf_pair *pair)
+{
+    return !(pair->flags & JSMNF_VALUE_ESCAPED);
+}
+
+#define _JSMNF_IS_DIGIT(c) ((c) >= '0' && (c) <= '9')
+
+/* parse a JSON integer's magnitude, with exact overflow detection */
+static int
+_jsmnf_parse_u64(const char *p,
+                 const char *end,
+                 uint64_t *p_magnitude,
+                 int *p_negative)
+{
+    uint64_t magnitude = 0;
+
+    if ((*p_negative = (p != end && *p == '-'))) ++p;
+    if (p == end || !_JSMNF_IS_DIGIT(*p)) return JSMN_ERROR_INVAL;
+
+    if (*p == '0') {
+        ++p;
+    }
+    else {
+        for (; p != end && _JSMNF_IS_DIGIT(*p); ++p) {
+            const unsigned digit = (unsigned)(*p - '0');
+
+            if (magnitude > (UINT64_MAX - digit) / 10) {
+                /* keep checking the grammar for a precise error code */
+                while (p != end && _JSMNF_IS_DIGIT(*p))
+                    ++p;
+                return p == end ? JSMNF_ERROR_RANGE : JSMN_ERROR_INVAL;
+            }
+            magnitude = magnitude * 10 + digit;
+        }
+    }
+    if (p != end) return JSMN_ERROR_INVAL;
+
+    *p_magnitude = magnitude;
+    return 0;
+}
+
+/* write `value` in decimal, returns the amount of characters written */
+static size_t
+_jsmnf_u64_to_str(uint64_t value, char buf[20])
+{
+    char tmp[20];
+    size_t i = 0, len;
+
+    do {
+        tmp[i++] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value);
+    for (len = 0; i;)
+        buf[len++] = tmp[--i];
+    return len;
+}
+
+/* significant digits handed to strtod(), enough to tell apart any two
+ *      doubles and the halfway point between them */
+#define _JSMNF_STRTOD_DIGITS 800
+
+/* strtod() a number as `<digits>e<exponent>`, which doesn't depend on the
+ *      locale's decimal point, digits past _JSMNF_STRTOD_DIGITS are folded
+ *      into a sticky digit that keeps the rounding correct */
+static double
+_jsmnf_strtod(const char *str, size_t len)
+{
+    char buf[_JSMNF_STRTOD_DIGITS + 32];
+    const char *p = str, *const end = str + len;
+    size_t n = 0;
+    long exponent = 0;
+    int negative, fraction = 0, sticky = 0;
+    double value;
+
+    if ((negative = (p != end && *p == '-'))) ++p;
+    for (; p != end; ++p) {
+        if (*p == '.') {
+            fraction = 1;
+        }
+        else if (!_JSMNF_IS_DIGIT(*p)) {
+            break;
+        }
+        else if (!n && *p == '0') {
+            /* leading zeros aren't significant */
+            if (fraction) --exponent;
+        }
+        else if (n < _JSMNF_STRTOD_DIGITS) {
+            buf[n++] = *p;
+            if (fraction) --exponent;
+        }
+        else {
+            sticky |= (*p != '0');
+            if (!fraction) ++exponent;
+        }
+    }
+    if (p != end && (*p == 'e' || *p == 'E')) {
+        long e = 0;
+        int e_negative = 0;
+
+        if (++p != end && (*p == '+' || *p == '-')) e_negative = (*p++ == '-');
+        for (; p != end && _JSMNF_IS_DIGIT(*p); ++p)
+            if (e < 100000) e = e * 10 + (*p - '0');
+        exponent += e_negative ? -e : e;
+    }
+    if (!n) return negative ? -0.0 : 0.0;
+
+    if (sticky) {
+        buf[n++] = '1';
+        --exponent;
+    }
+    sprintf(buf + n, "e%ld", exponent);
+    value = strtod(buf, NULL);
+    return negative ? -value : value;
+}
+
+/* Parse a JSON number, exactly representable values (at most 2^53 with a
+ * power of ten up to 10^22) are computed directly as in Clinger's fast path,
+ * the rest is handed to strtod() */
+static int
+_jsmnf_parse_double(const char *str, size_t len, double *p_value)
+{
+    static const double pow10[] = { 1e0,  1e1,  1e2,  1e3,  1e4,  1e5,
+                                    1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                                    1e12, 1e13, 1e14, 1e15, 1e16, 1e17,
+                                    1e18, 1e19, 1e20, 1e21, 1e22 };
+    const char *p = str, *const end = str + len;
+    uint64_t mantissa = 0;
+    long exponent = 0;
+    int negative, digits = 0, truncated = 0;
+    double value;
+
+    if ((negative = (p != end && *p == '-'))) ++p;
+    if (p == end || !_JSMNF_IS_DIGIT(*p)) return JSMN_ERROR_INVAL;
+
+    if (*p == '0') {
+        ++p;
+    }
+    else {
+        for (; p != end && _JSMNF_IS_DIGIT(*p); ++p) {
+            if (digits < 19) {
+                mantissa = mantissa * 10 + (unsigned)(*p - '0');
+                ++digits;
+            }
+            else {
+                truncated |= (*p != '0');
+                ++exponent;
+            }
+        }
+    }
+    if (p != end && *p == '.') {
+        if (++p == end || !_JSMNF_IS_DIGIT(*p)) return JSMN_ERROR_INVAL;
+        for (; p != end && _JSMNF_IS_DIGIT(*p); ++p) {
+            if (!mantissa && *p == '0') {
+                /* leading zeros aren't significant */
+                --exponent;
+            }
+            else if (digits < 19) {
+                mantissa = mantissa * 10 + (unsigned)(*p - '0');
+                ++digits;
+                --exponent;
+            }
+            else {
+                truncated |= (*p != '0');
+            }
+        }
+    }
+    if (p != end && (*p == 'e' || *p == 'E')) {
+        long e = 0;
+        int e_negative = 0;
+
+        if (++p != end && (*p == '+' || *p == '-')) e_negative = (*p++ == '-');
+        if (p == end || !_JSMNF_IS_DIGIT(*p)) return JSMN_ERROR_INVAL;
+        for (; p != end && _JSMNF_IS_DIGIT(*p); ++p)
+            if (e < 100000) e = e * 10 + (*p - '0');
+        exponent += e_negative ? -e : e;
+    }
+    if (p != end) return JSMN_ERROR_INVAL;
+
+    if (!mantissa) {
+        value = 0.0;
+    }
+    else if (!truncated && mantissa <= (UINT64_C(1) << 53) && exponent >= -22
+             && exponent <= 22)
+    {
+        value = (double)mantissa;
+        if (exponent < 0)
+            value /= pow10[-exponent];
+        else
+            value *= pow10[exponent];
+    }
+    else {
+        value = _jsmnf_strtod(str + negative, len - negative);
+    }
+    if (value == HUGE_VAL) return JSMNF_ERROR_RANGE;
+
+    *p_value = negative ? -value : value;
+    return 0;
+}
+
+static int
+_jsmnf_parse_i64(const char *p, const char *end, int64_t *p_value)
+{
+    uint64_t magnitude;
+    int negative, ret;
+
+    if ((ret = _jsmnf_parse_u64(p, end, &magnitude, &negative)) < 0)
+        return ret;
+
+    if (negative) {
+        if (magnitude > (uint64_t)INT64_MAX + 1) return JSMNF_ERROR_RANGE;
+        *p_value = magnitude ? -(int64_t)(magnitude - 1) - 1 : 0;
+    }
+    else {
+        if (magnitude > (uint64_t)INT64_MAX) return JSMNF_ERROR_RANGE;
+        *p_value = (int64_t)magnitude;
+    }
+    return 0;
+}
+
+JSMN_API int
+jsmnf_get_i64(const struct jsmnf_pair *pair, const char js[], int64_t *p_value)
+{
+    if (!pair || !pair->v || JSMN_PRIMITIVE != pair->v->type)
+        return JSMN_ERROR_INVAL;
+    return _jsmnf_parse_i64(js + pair->v->start, js + pair->v->end, p_value);
+}
+
+JSMN_API int
+jsmnf_get_u64(const struct jsmnf_pair *pair,
+              const char js[],
+              uint64_t *p_value)
+{
+    uint64_t magnitude;
+    int negative, ret;
+
+    if (!pair || !pair->v || JSMN_PRIMITIVE != pair->v->type)
+        return JSMN_ERROR_INVAL;
+    if ((ret = _jsmnf_parse_u64(js + pair->v->start, js + pair->v->end,
+                                &magnitude, &negative))
+        < 0)
+    {
+        return ret;
+    }
+    if (negative && magnitude) return JSMNF_ERROR_RANGE;
+
+    *p_value = magnitude;
+    return 0;
+}
+
+JSMN_API int
+jsmnf_get_double(const struct jsmnf_pair *pair,
+                 const char js[],
+                 double *p_value)
+{
+    if (!pair || !pair->v || JSMN_PRIMITIVE != pair->v->type)
+        return JSMN_ERROR_INVAL;
+    return _jsmnf_parse_double(js + pair->v->start,
+                               (size_t)(pair->v->end - pair->v->start),
+                               p_value);
+}
+
+JSMN_API int
+jsmnf_get_bool(const struct jsmnf_pair *pair, const char js[], int *p_value)
+{
+    const char *str;
+    size_t len;
+
+    if (!pair || !pair->v || JSMN_PRIMITIVE != pair->v->type)
+        return JSMN_ERROR_INVAL;
+
+    str = js + pair->v->start;
+    len = (size_t)(pair->v->end - pair->v->start);
+    if (4 == len && 0 == memcmp(str, "true", 4))
+        *p_value = 1;
+    else if (5 == len && 0 == memcmp(str, "false", 5))
+        *p_value = 0;
+    else
+        return JSMN_ERROR_INVAL;
+    return 0;
+}
+
+JSMN_API long
+jsmnf_get_string(const struct jsmnf_pair *pair,
+                 const char js[],
+                 char buf[],
+                 size_t bufsize,
+                 const char **p_str)
+{
+    const char *str;
+    size_t len;
+    long ret;
+
+    if (!pair || !pair->v || JSMN_STRING != pair->v->type)
+        return JSMN_ERROR_INVAL;
+
+    str = js + pair->v->start;
+    len = (size_t)(pair->v->end - pair->v->start);
+    if (jsmnf_is_raw(pair)) {
+        *p_str = str;
+        return (long)len;
+    }
+    if ((ret = jsmnf_unescape(buf, bufsize, str, len)) < 0) return ret;
+    *p_str = buf;
+    return ret;
+}
+
+#undef _JSMNF_IS_DIGIT
+
+static int
+_jsmnf_query_is_space(char c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static int
+_jsmnf_query_is_name(char c)
+{
+    switch (c) {
+    case '.':
+    case '[':
+    case ']':
+    case '(':
+    case ')':
+    case '=':
+    case '!':
+    case '<':
+    case '>':
+    case '\'':
+    case '"':
+        return 0;
+    default:
+        return !_jsmnf_query_is_space(c);
+    }
+}
+
+static const char *
+_jsmnf_query_skip_space(const char *p, const char *end)
+{
+    while (p != end && _jsmnf_query_is_space(*p))
+        ++p;
+    return p;
+}
+
+static struct jsmnf_query_op *
+_jsmnf_query_push(struct jsmnf_query_op ops[],
+                  size_t *num_ops,
+                  const size_t max_ops,
+                  enum jsmnf_query_opcode code)
+{
+    struct jsmnf_query_op *op;
+
+    if (*num_ops >= max_ops) return NULL;
+
+    op = &ops[(*num_ops)++];
+    memset(op, 0, sizeof *op);
+    op->code = code;
+    return op;
+}
+
+/* parse a quoted string, `*p` must point to the opening quote */
+static int
+_jsmnf_query_quoted(const char **p,
+                    const char *end,
+                    const char **str,
+                    size_t *str_len)
+{
+    const char quote = *(*p)++;
+
+    *str = *p;
+    while (*p != end && **p != quote) {
+        if (**p == '\\' && *p + 1 != end) ++*p;
+        ++*p;
+    }
+    if (*p == end) return JSMN_ERROR_INVAL;
+
+    *str_len = (size_t)(*p - *str);
+    ++*p;
+    return 0;
+}
+
+/* parse the `?(...)` part of a filter, `*p` must point to the `?` */
+static int
+_jsmnf_query_filter(const char **p,
+                    const char *end,
+                    struct jsmnf_query_op *op)
+{
+    static const struct {
+        const char *str;
+        size_t len;
+        enum jsmnf_query_cmp cmp;
+    } cmps[] = {
+        { "==", 2, JSMNF_QUERY_EQ }, { "!=", 2, JSMNF_QUERY_NE },
+        { "<=", 2, JSMNF_QUERY_LE }, { ">=", 2, JSMNF_QUERY_GE },
+        { "<", 1, JSMNF_QUERY_LT },  { ">", 1, JSMNF_QUERY_GT },
+    };
+    const char *s = *p + 1;
+    size_t i;
+
+    if (s == end || *s++ != '(') return JSMN_ERROR_INVAL;
+    s = _jsmnf_query_skip_space(s, end);
+    if (s == end || *s++ != '@') return JSMN_ERROR_INVAL;
+    if (s != end && *s == '.') {
+        op->key = ++s;
+        while (s != end && (*s == '.' || _jsmnf_query_is_name(*s)))
+            ++s;
+        op->key_len = (size_t)(s - op->key);
+        if (!op->key_len || op->key[op->key_len - 1] == '.')
+            return JSMN_ERROR_INVAL;
+    }
+    s = _jsmnf_query_skip_space(s, end);
+    if (s == end) return JSMN_ERROR_INVAL;
+
+    if (*s != ')') {
+        for (i = 0; i < sizeof(cmps) / sizeof *cmps; ++i) {
+            if ((size_t)(end - s) >= cmps[i].len
+                && 0 == memcmp(s, cmps[i].str, cmps[i].len))
+            {
+                op->cmp = cmps[i].cmp;
+                s += cmps[i].len;
+                break;
+            }
+        }
+        if (JSMNF_QUERY_EXISTS == op->cmp) return JSMN_ERROR_INVAL;
+
+        s = _jsmnf_query_skip_space(s, end);
+        if (s == end) return JSMN_ERROR_INVAL;
+
+        if (*s == '\'' || *s == '"') {
+            op->literal_is_string = 1;
+            if (_jsmnf_query_quoted(&s, end, &op->literal, &op->literal_len)
+                < 0)
+            {
+                return JSMN_ERROR_INVAL;
+            }
+        }
+        else {
+            op->literal = s;
+            while (s != end && *s != ')' && !_jsmnf_query_is_space(*s))
+                ++s;
+            op->literal_len = (size_t)(s - op->literal);
+            if (!op->literal_len) return JSMN_ERROR_INVAL;
+        }
+        s = _jsmnf_query_skip_space(s, end);
+    }
+    if (s == end || *s++ != ')') return JSMN_ERROR_INVAL;
+
+    *p = s;
+    return 0;
+}
+
+/* parse a `[...]` selector, `*p` must point to the opening bracket */
+static int
+_jsmnf_query_bracket(const char **p,
+                     const char *end,
+                     struct jsmnf_query_op ops[],
+                     size_t *num_ops,
+                     const size_t max_ops)
+{
+    const char *s = _jsmnf_query_skip_space(*p + 1, end);
+    struct jsmnf_query_op *op;
+    int ret;
+
+    if (s == end) return JSMN_ERROR_INVAL;
+
+    if (*s == '*') {
+        if (!_jsmnf_query_push(ops, num_ops, max_ops, JSMNF_QUERY_WILDCARD))
+            return JSMN_ERROR_NOMEM;
+        ++s;
+    }
+    else if (*s == '\'' || *s == '"') {
+        if (!(op = _jsmnf_query_push(ops, num_ops, max_ops, JSMNF_QUERY_NAME)))
+            return JSMN_ERROR_NOMEM;
+        if ((ret = _jsmnf_query_quoted(&s, end, &op->key, &op->key_len)) < 0)
+            return ret;
+    }
+    else if (*s == '?') {
+        if (!(op = _jsmnf_query_push(ops, num_ops, max_ops,
+                                     JSMNF_QUERY_FILTER)))
+        {
+            return JSMN_ERROR_NOMEM;
+        }
+        if ((ret = _jsmnf_query_filter(&s, end, op)) < 0) return ret;
+    }
+    else {
+        const int negative = (*s == '-');
+        long index = 0;
+
+        if (negative) ++s;
+        if (s == end || *s < '0' || *s > '9') return JSMN_ERROR_INVAL;
+        while (s != end && *s >= '0' && *s <= '9') {
+            const int digit = *s++ - '0';
+
+            if (index > (LONG_MAX - digit) / 10) return JSMN_ERROR_INVAL;
+            index = index * 10 + digit;
+        }
+
+        if (!(op = _jsmnf_query_push(ops, num_ops, max_ops,
+                                     JSMNF_QUERY_INDEX)))
+        {
+            return JSMN_ERROR_NOMEM;
+        }
+        op->index = negative ? -index : index;
+    }
+
+    s = _jsmnf_query_skip_space(s, end);
+    if (s == end || *s++ != ']') return JSMN_ERROR_INVAL;
+
+    *p = s;
+    return 0;
+}
+
+JSMN_API long
+jsmnf_query_compile(const char expr[],
+                    size_t len,
+                    struct jsmnf_query_op ops[],
+                    size_t max_ops)
+{
+    const char *p = expr, *const end = expr + len;
+    size_t num_ops = 0;
+    int ret;
+
+    p = _jsmnf_query_skip_space(p, end);
+    if (p == end || *p++ != '$') return JSMN_ERROR_INVAL;
+
+    while ((p = _jsmnf_query_skip_space(p, end)) != end) {
+        if (*p == '[') {
+            if ((ret = _jsmnf_query_bracket(&p, end, ops, &num_ops, max_ops))
+                < 0)
+            {
+                return ret;
+            }
+        }
+        else if (*p == '.') {
+            struct jsmnf_query_op *op;
+            const char *name;
+
+            if (++p != end && *p == '.') {
+                if (!_jsmnf_query_push(ops, &num_ops, max_ops,
+                                       JSMNF_QUERY_DESCEND))
+                {
+                    return JSMN_ERROR_NOMEM;
+                }
+                /* `..[...]` */
+                if (++p != end && *p == '[') continue;
+            }
+            if (p == end) return JSMN_ERROR_INVAL;
+
+            if (*p == '*') {
+                if (!_jsmnf_query_push(ops, &num_ops, max_ops,
+                                       JSMNF_QUERY_WILDCARD))
+                {
+                    return JSMN_ERROR_NOMEM;
+                }
+                ++p;
+                continue;
+            }
+
+            for (name = p; p != end && _jsmnf_query_is_name(*p); ++p)
+                continue;
+            if (p == name) return JSMN_ERROR_INVAL;
+
+            if (!(op = _jsmnf_query_push(ops, &num_ops, max_ops,
+                                         JSMNF_QUERY_NAME)))
+            {
+                return JSMN_ERROR_NOMEM;
+            }
+            op->key = name;
+            op->key_len = (size_t)(p - name);
+        }
+        else {
+            return JSMN_ERROR_INVAL;
+        }
+    }
+    /* `..` must be followed by a selector */
+    if (num_ops && JSMNF_QUERY_DESCEND == ops[num_ops - 1].code)
+        return JSMN_ERROR_INVAL;
+
+    return (long)num_ops;
+}
+
+struct _jsmnf_query_ctx {
+    const struct jsmnf_query_op *ops;
+    size_t num_ops;
+    const char *js;
+    const struct jsmnf_pair **results;
+    size_t max_results;
+    size_t count;
+};
+
+static int
+_jsmnf_query_match(const struct jsmnf_query_op *op,
+                   const char js[],
+                   const struct jsmnf_pair *node)
+{
+    const char *key = op->key, *const key_end = key + op->key_len;
+    const char *str;
+    size_t len;
+    int order;
+
+    while (node && key < key_end) {
+        const char *dot = memchr(key, '.', (size_t)(key_end - key));
+        const size_t n = dot ? (size_t)(dot - key) : (size_t)(key_end - key);
+
+        if (!node->v || JSMN_OBJECT != node->v->type) return 0;
+        node = oa_hash_get((struct oa_hash *)node, key, n);
+        key += n + (dot != NULL);
+    }
+    if (!node || !node->v) return 0;
+    if (JSMNF_QUERY_EXISTS == op->cmp) return 1;
+
+    str = js + node->v->start;
+    len = (size_t)(node->v->end - node->v->start);
+
+    if (op->literal_is_string) {
+        if (JSMN_STRING != node->v->type) return op->cmp == JSMNF_QUERY_NE;
+        order = memcmp(str, op->literal,
+                       len < op->literal_len ? len : op->literal_len);
+        if (!order) order = (len > op->literal_len) - (len < op->literal_len);
+    }
+    else {
+        double a, b;
+
+        if (JSMN_PRIMITIVE == node->v->type
+            && 0 == _jsmnf_parse_double(str, len, &a)
+            && 0 == _jsmnf_parse_double(op->literal, op->literal_len, &b))
+        {
+            order = (a > b) - (a < b);
+        }
+        else {
+            /* true, false and null can only be tested for equality */
+            const int equal = JSMN_PRIMITIVE == node->v->type
+                              && len == op->literal_len
+                              && 0 == memcmp(str, op->literal, len);
+            if (op->cmp == JSMNF_QUERY_EQ) return equal;
+            if (op->cmp == JSMNF_QUERY_NE) return !equal;
+            return 0;
+        }
+    }
+
+    switch (op->cmp) {
+    case JSMNF_QUERY_EQ:
+        return order == 0;
+    case JSMNF_QUERY_NE:
+        return order != 0;
+    case JSMNF_QUERY_LT:
+        return order < 0;
+    case JSMNF_QUERY_LE:
+        return order <= 0;
+    case JSMNF_QUERY_GT:
+        return order > 0;
+    case JSMNF_QUERY_GE:
+        return order >= 0;
+    default:
+        return 0;
+    }
+}
+
+static int _jsmnf_query_eval(struct _jsmnf_query_ctx *ctx,
+                             size_t pc,
+                             const struct jsmnf_pair *node);
+
+static int
+_jsmnf_query_descend(struct _jsmnf_query_ctx *ctx,
+                     size_t pc,
+                     const struct jsmnf_pair *node)
+{
+    size_t i;
+    int ret;
+
+    if ((ret = _jsmnf_query_eval(ctx, pc, node)) < 0) return ret;
+
+    if (JSMN_OBJECT == node->v->type || JSMN_ARRAY == node->v->type) {
+        for (i = 0; i < node->length; ++i) {
+            if (node->fields[i].v
+                && (ret = _jsmnf_query_descend(ctx, pc, &node->fields[i])) < 0)
+            {
+                return ret;
+            }
+        }
+    }
+    return 0;
+}
+
+static int
+_jsmnf_query_eval(struct _jsmnf_query_ctx *ctx,
+                  size_t pc,
+                  const struct jsmnf_pair *node)
+{
+    const struct jsmnf_query_op *op;
+    size_t i;
+    int ret;
+
+    if (!node || !node->v) return 0;
+
+    if (pc == ctx->num_ops) {
+        if (ctx->results) {
+            if (ctx->count >= ctx->max_results) return JSMN_ERROR_NOMEM;
+            ctx->results[ctx->count] = node;
+        }
+        ++ctx->count;
+        return 0;
+    }
+
+    op = &ctx->ops[pc];
+    switch (op->code) {
+    case JSMNF_QUERY_NAME:
+        if (JSMN_OBJECT != node->v->type) return 0;
+        return _jsmnf_query_eval(
+            ctx, pc + 1,
+            oa_hash_get((struct oa_hash *)node, op->key, op->key_len));
+    case JSMNF_QUERY_INDEX: {
+        const long idx =
+            op->index < 0 ? (long)node->length + op->index : op->index;
+
+        if (JSMN_ARRAY != node->v->type || idx < 0
+            || (size_t)idx >= node->length)
+        {
+            return 0;
+        }
+        return _jsmnf_query_eval(ctx, pc + 1, &node->fields[idx]);
+    }
+    case JSMNF_QUERY_WILDCARD:
+    case JSMNF_QUERY_FILTER:
+        if (JSMN_OBJECT != node->v->type && JSMN_ARRAY != node->v->type)
+            return 0;
+        for (i = 0; i < node->length; ++i) {
+            const struct jsmnf_pair *f = &node->fields[i];
+
+            if (JSMNF_QUERY_FILTER == op->code
+                && !_jsmnf_query_match(op, ctx->js, f))
+            {
+                continue;
+            }
+            if ((ret = _jsmnf_query_eval(ctx, pc + 1, f)) < 0) return ret;
+        }
+        return 0;
+    case JSMNF_QUERY_DESCEND:
+        return _jsmnf_query_descend(ctx, pc + 1, node);
+    default:
+        return JSMN_ERROR_INVAL;
+    }
+}
+
+JSMN_API long
+jsmnf_query(const struct jsmnf_query_op ops[],
+            size_t num_ops,
+            const struct jsmnf_pair *root,
+            const char js[],
+            const struct jsmnf_pair *results[],
+            size_t max_results)
+{
+    struct _jsmnf_query_ctx ctx;
+    int ret;
+
+    ctx.ops = ops;
+    ctx.num_ops = num_ops;
+    ctx.js = js;
+    ctx.results = results;
+    ctx.max_results = max_results;
+    ctx.count = 0;
+
+    if ((ret = _jsmnf_query_eval(&ctx, 0, root)) < 0) return ret;
+    return (long)ctx.count;
+}
+
+static int
+_jsmnf_cursor_is_delim(char c)
+{
+    switch (c) {
+    case ',':
+    case ']':
+    case '}':
+    case ' ':
+    case '\t':
+    case '\n':
+    case '\r':
+    case ':':
+    case '\0':
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+static size_t
+_jsmnf_cursor_skip_space(const char js[], size_t len, size_t pos)
+{
+    while (pos < len
+           && (js[pos] == ' ' || js[pos] == '\t' || js[pos] == '\n'
+               || js[pos] == '\r'))
+    {
+        ++pos;
+    }
+    return pos;
+}
+
+/* position of the closing quote of the string starting at `pos` */
+static long
+_jsmnf_cursor_string_end(const char js[], size_t len, size_t pos)
+{
+    while (pos < len) {
+        size_t w;
+
+        if (len - pos >= sizeof w) {
+            memcpy(&w, js + pos, sizeof w);
+            if (!_JSMNF_SWAR_HAS(w, '"') && !_JSMNF_SWAR_HAS(w, '\\')
+                && !_JSMNF_SWAR_HAS_ZERO(w))
+            {
+                pos += sizeof w;
+                continue;
+            }
+        }
+        switch (js[pos]) {
+        case '"':
+            return (long)pos;
+        case '\\':
+            pos += 2;
+            break;
+        case '\0':
+            return JSMN_ERROR_PART;
+        default:
+            ++pos;
+        }
+    }
+    return JSMN_ERROR_PART;
+}
+
+/* position right after the value starting at `pos` */
+static long
+_jsmnf_cursor_value_end(const char js[], size_t len, size_t pos)
+{
+    unsigned long depth = 0;
+    long ret;
+
+    if (pos >= len) return JSMN_ERROR_PART;
+
+    switch (js[pos]) {
+    case '"':
+        if ((ret = _jsmnf_cursor_string_end(js, len, pos + 1)) < 0)
+            return ret;
+        return ret + 1;
+    case '{':
+    case '[':
+        break;
+    case '}':
+    case ']':
+        return JSMN_ERROR_INVAL;
+    default:
+        while (pos < len && !_jsmnf_cursor_is_delim(js[pos]))
+            ++pos;
+        return (long)pos;
+    }
+
+    while (pos < len) {
+        size_t w;
+
+        /* brackets are matched against `{` and `}` by setting 0x20 */
+        if (len - pos >= sizeof w) {
+            memcpy(&w, js + pos, sizeof w);
+            if (!_JSMNF_SWAR_HAS(w, '"') && !_JSMNF_SWAR_HAS_ZERO(w)
+                && !_JSMNF_SWAR_HAS(w | (_JSMNF_SWAR_ONES * 0x20), '{')
+                && !_JSMNF_SWAR_HAS(w | (_JSMNF_SWAR_ONES * 0x20), '}'))
+            {
+                pos += sizeof w;
+                continue;
+            }
+        }
+        switch (js[pos]) {
+        case '"':
+            if ((ret = _jsmnf_cursor_string_end(js, len, pos + 1)) < 0)
+                return ret;
+            pos = (size_t)ret;
+            break;
+        case '{':
+        case '[':
+            ++depth;
+            break;
+        case '}':
+        case ']':
+            if (0 == --depth) return (long)pos + 1;
+            break;
+        case '\0':
+            return JSMN_ERROR_PART;
+        }
+        ++pos;
+    }
+    return JSMN_ERROR_PART;
+}
+
+static void
+_jsmnf_cursor_set_pair(struct jsmnf_cursor *cursor)
+{
+    struct _jsmnf_pair_mut *pair = (struct _jsmnf_pair_mut *)&cursor->pair;
+
+    memset(pair, 0, sizeof *pair);
+    pair->k = &cursor->key;
+    pair->v = &cursor->tok;
+    if (_jsmnf_has_escapes(cursor->js, pair->k))
+        pair->flags |= JSMNF_KEY_ESCAPED;
+    if (_jsmnf_has_escapes(cursor->js, pair->v))
+        pair->flags |= JSMNF_VALUE_ESCAPED;
+}
+
+/* position the cursor at the value starting at `cursor->pos` */
+static long
+_jsmnf_cursor_value(struct jsmnf_cursor *cursor)
+{
+    const size_t pos = cursor->pos;
+    long ret;
+
+    if (pos >= cursor->len || !cursor->js[pos]) return JSMN_ERROR_PART;
+
+    memset(&cursor->tok, 0, sizeof cursor->tok);
+    switch (cursor->js[pos]) {
+    case '{':
+    case '[':
+        cursor->tok.type = '{' == cursor->js[pos] ? JSMN_OBJECT : JSMN_ARRAY;
+        cursor->tok.start = (int)pos;
+        cursor->tok.end = -1;
+        break;
+    case '"':
+        if ((ret = _jsmnf_cursor_string_end(cursor->js, cursor->len, pos + 1))
+            < 0)
+        {
+            return ret;
+        }
+        cursor->tok.type = JSMN_STRING;
+        cursor->tok.start = (int)pos + 1;
+        cursor->tok.end = (int)ret;
+        break;
+    case ',':
+    case ':':
+    case '}':
+    case ']':
+        return JSMN_ERROR_INVAL;
+    default:
+        if ((ret = _jsmnf_cursor_value_end(cursor->js, cursor->len, pos)) < 0)
+            return ret;
+        cursor->tok.type = JSMN_PRIMITIVE;
+        cursor->tok.start = (int)pos;
+        cursor->tok.end = (int)ret;
+        break;
+    }
+    cursor->consumed = 0;
+    _jsmnf_cursor_set_pair(cursor);
+    return 1;
+}
+
+/* position the cursor at the object member or array element starting at
+ *      `cursor->pos` */
+static long
+_jsmnf_cursor_member(struct jsmnf_cursor *cursor)
+{
+    const char *js = cursor->js;
+    const size_t len = cursor->len;
+
+    memset(&cursor->key, 0, sizeof cursor->key);
+    if (cursor->pos < len && '"' == js[cursor->pos]) {
+        long end = _jsmnf_cursor_string_end(js, len, cursor->pos + 1);
+        size_t colon;
+
+        if (end < 0) return end;
+
+        colon = _jsmnf_cursor_skip_space(js, len, (size_t)end + 1);
+        if (colon < len && ':' == js[colon]) {
+            cursor->key.type = JSMN_STRING;
+            cursor->key.start = (int)cursor->pos + 1;
+            cursor->key.end = (int)end;
+            cursor->key.size = 1;
+            cursor->pos = _jsmnf_cursor_skip_space(js, len, colon + 1);
+        }
+    }
+    return _jsmnf_cursor_value(cursor);
+}
+
+JSMN_API long
+jsmnf_cursor_init(struct jsmnf_cursor *cursor,
+                  const char js[],
+                  const size_t len)
+{
+    /* token offsets are `int` */
+    if (len > INT_MAX) return JSMNF_ERROR_RANGE;
+
+    memset(cursor, 0, sizeof *cursor);
+    cursor->js = js;
+    cursor->len = len;
+    cursor->consumed = 1;
+    _jsmnf_cursor_set_pair(cursor);
+
+    cursor->pos = _jsmnf_cursor_skip_space(js, len, 0);
+    if (cursor->pos >= len || !js[cursor->pos]) return 0;
+    return _jsmnf_cursor_value(cursor);
+}
+
+JSMN_API long
+jsmnf_cursor_enter(struct jsmnf_cursor *cursor)
+{
+    const char *js = cursor->js;
+
+    if (cursor->consumed
+        || (JSMN_OBJECT != cursor->tok.type && JSMN_ARRAY != cursor->tok.type))
+    {
+        return JSMN_ERROR_INVAL;
+    }
+
+    ++cursor->depth;
+    cursor->pos =
+        _jsmnf_cursor_skip_space(js, cursor->len, cursor->tok.start + 1);
+    if (cursor->pos >= cursor->len) return JSMN_ERROR_PART;
+
+    if ('}' == js[cursor->pos] || ']' == js[cursor->pos]) {
+        ++cursor->pos;
+        --cursor->depth;
+        cursor->consumed = 1;
+        return 0;
+    }
+    return _jsmnf_cursor_member(cursor);
+}
+
+JSMN_API long
+jsmnf_cursor_skip(struct jsmnf_cursor *cursor)
+{
+    const char *js = cursor->js;
+    const size_t len = cursor->len;
+    long ret;
+
+    if (!cursor->consumed) {
+        if (JSMN_STRING == cursor->tok.type)
+            cursor->pos = (size_t)cursor->tok.end + 1;
+        else if (cursor->tok.end >= 0)
+            cursor->pos = (size_t)cursor->tok.end;
+        else if ((ret = _jsmnf_cursor_value_end(js, len, cursor->pos)) < 0)
+            return ret;
+        else
+            cursor->pos = (size_t)ret;
+        cursor->consumed = 1;
+    }
+
+    cursor->pos = _jsmnf_cursor_skip_space(js, len, cursor->pos);
+    if (cursor->pos >= len || !js[cursor->pos])
+        return cursor->depth ? JSMN_ERROR_PART : 0;
+    if (!cursor->depth) return JSMN_ERROR_INVAL;
+
+    switch (js[cursor->pos]) {
+    case ',':
+        cursor->pos = _jsmnf_cursor_skip_space(js, len, cursor->pos + 1);
+        return _jsmnf_cursor_member(cursor);
+    case '}':
+    case ']':
+        ++cursor->pos;
+        --cursor->depth;
+        return 0;
+    default:
+        return JSMN_ERROR_INVAL;
+    }
+}
+
+JSMN_API long
+jsmnf_cursor_find_field(struct jsmnf_cursor *cursor,
+                        const char key[],
+                        const size_t length)
+{
+    long ret;
+
+    if (cursor->consumed && (ret = jsmnf_cursor_skip(cursor)) <= 0)
+        return ret;
+
+    for (;;) {
+        if (JSMN_STRING != cursor->key.type) return JSMN_ERROR_INVAL;
+        if ((size_t)(cursor->key.end - cursor->key.start) == length
+            && 0 == memcmp(cursor->js + cursor->key.start, key, length))
+        {
+            return 1;
+        }
+        if ((ret = jsmnf_cursor_skip(cursor)) <= 0) return ret;
+    }
+}
+
+JSMN_API long
+jsmnf_cursor_load(struct jsmnf_cursor *cursor,
+                  struct jsmnf_loader *loader,
+                  struct jsmnf_table table[],
+                  const size_t table_len)
+{
+    struct jsmntok *tokens = (struct jsmntok *)table;
+    size_t start, end;
+    unsigned i;
+    long ret;
+
+    if (cursor->consumed) return JSMN_ERROR_INVAL;
+
+    if (cursor->tok.end < 0) {
+        if ((ret = _jsmnf_cursor_value_end(cursor->js, cursor->len,
+                                           cursor->pos))
+            < 0)
+        {
+            return ret;
+        }
+        cursor->tok.end = (int)ret;
+    }
+
+    start = (size_t)cursor->tok.start;
+    end = (size_t)cursor->tok.end;
+    if (JSMN_STRING == cursor->tok.type) --start, ++end;
+
+    /* start over, keeping the loader's key arena */
+    jsmn_init(&loader->parser);
+    loader->pairnext = 0;
+    if ((ret = jsmnf_load(loader, cursor->js + start, end - start, table,
+                          table_len))
+        < 0)
+    {
+        return ret;
+    }
+
+    /* make tokens relative to the cursor's JSON string */
+    for (i = 0; i < loader->parser.toknext; ++i) {
+        if (tokens[i].start >= 0) tokens[i].start += (int)start;
+        if (tokens[i].end >= 0) tokens[i].end += (int)start;
+    }
+    cursor->tok.size = tokens[0].size;
+    return ret;
+}
+
+/* Parse up to 8 decimal digits at once (SWAR), `s` must have at least 8
+ *      readable bytes. Returns 0 if not applicable (e.g. non-digit found or
+ *      big-endian host), in which case the scalar parser should be used */
+static int
+_jsmnf_swar_parse_digits(const char *s, size_t n, uint64_t *p_value)
+{
+    static const unsigned one = 1;
+    const uint64_t zeros = UINT64_C(0x3030303030303030);
+    uint64_t w, mask;
+
+    if (!n || n > 8 || !*(const unsigned char *)&one) return 0;
+    /* no leading zeros */
+    if (n > 1 && '0' == *s) return 0;
+
+    memcpy(&w, s, sizeof w);
+    mask = (8 == n) ? ~UINT64_C(0) : ((UINT64_C(1) << (n * 8)) - 1);
+    /* all of the first `n` bytes must be within '0' and '9' */
+    if ((((w + UINT64_C(0x4646464646464646)) | (w - zeros))
+         & UINT64_C(0x8080808080808080) & mask))
+    {
+        return 0;
+    }
+
+    /* pad with leading zero digits and combine pairs, quads and octets */
+    w = ((w - zeros) & mask) << ((8 - n) * 8);
+    w = (w * 10) + (w >> 8);
+    w = (((w & UINT64_C(0x000000FF000000FF))
+          * (100 + (UINT64_C(1000000) << 32)))
+         + (((w >> 16) & UINT64_C(0x000000FF000000FF))
+            * (1 + (UINT64_C(10000) << 32))))
+        >> 32;
+    *p_value = w;
+    return 1;
+}
+
+/* short integers within `head`'s span are handled by the SWAR fast path */
+static int
+_jsmnf_array_fast_int(const struct jsmnf_pair *head,
+                      const char js[],
+                      const struct jsmntok *tok,
+                      int64_t *p_value)
+{
+    const int negative = ('-' == js[tok->start]);
+    uint64_t magnitude;
+
+    if (tok->start + negative + 8 > head->v->end
+        || !_jsmnf_swar_parse_digits(js + tok->start + negative,
+                                     (size_t)(tok->end - tok->start - negative),
+                                     &magnitude))
+    {
+        return 0;
+    }
+    *p_value = negative ? -(int64_t)magnitude : (int64_t)magnitude;
+    return 1;
+}
+
+JSMN_API long
+jsmnf_array_to_f64(const struct jsmnf_pair *head,
+                   const char js[],
+                   double buf[],
+                   size_t bufsize)
+{
+    size_t i;
+
+    if (!head || !head->v || JSMN_ARRAY != head->v->type)
+        return JSMN_ERROR_INVAL;
+    if (bufsize < head->length) return JSMN_ERROR_NOMEM;
+
+    for (i = 0; i < head->length; ++i) {
+        const struct jsmntok *tok = head->fields[i].v;
+        int64_t value;
+
+        if (!tok || JSMN_PRIMITIVE != tok->type) break;
+        if (_jsmnf_array_fast_int(head, js, tok, &value))
+            buf[i] = (double)value;
+        else if (_jsmnf_parse_double(js + tok->start,
+                                     (size_t)(tok->end - tok->start), &buf[i])
+                 < 0)
+        {
+            break;
+        }
+    }
+    return (long)i;
+}
+
+JSMN_API long
+jsmnf_array_to_i64(const struct jsmnf_pair *head,
+                   const char js[],
+                   int64_t buf[],
+                   size_t bufsize)
+{
+    size_t i;
+
+    if (!head || !head->v || JSMN_ARRAY != head->v->type)
+        return JSMN_ERROR_INVAL;
+    if (bufsize < head->length) return JSMN_ERROR_NOMEM;
+
+    for (i = 0; i < head->length; ++i) {
+        const struct jsmntok *tok = head->fields[i].v;
+
+        if (!tok || JSMN_PRIMITIVE != tok->type) break;
+        if (!_jsmnf_array_fast_int(head, js, tok, &buf[i])
+            && _jsmnf_parse_i64(js + tok->start, js + tok->end, &buf[i]) < 0)
+        {
+            break;
+        }
+    }
+    return (long)i;
+}
+
+JSMN_API long
+jsmnf_array_to_i32(const struct jsmnf_pair *head,
+                   const char js[],
+                   int32_t buf[],
+                   size_t bufsize)
+{
+    size_t i;
+
+    if (!head || !head->v || JSMN_ARRAY != head->v->type)
+        return JSMN_ERROR_INVAL;
+    if (bufsize < head->length) return JSMN_ERROR_NOMEM;
+
+    for (i = 0; i < head->length; ++i) {
+        const struct jsmntok *tok = head->fields[i].v;
+        int64_t value;
+
+        if (!tok || JSMN_PRIMITIVE != tok->type) break;
+        if (!_jsmnf_array_fast_int(head, js, tok, &value)
+            && _jsmnf_parse_i64(js + tok->start, js + tok->end, &value) < 0)
+        {
+            break;
+        }
+        if (value < INT32_MIN || value > INT32_MAX) break;
+        buf[i] = (int32_t)value;
+    }
+    return (long)i;
+}
+
+static const struct jsmnf_node *
+_jsmnf_compact_nodes(const struct jsmnf_compact *table)
+{
+    return (const struct jsmnf_node *)((const char *)(table + 1)
+                                       + table->js_size);
+}
+
+static const uint32_t *
+_jsmnf_compact_words(const struct jsmnf_compact *table)
+{
+    return (const uint32_t *)(_jsmnf_compact_nodes(table) + table->num_nodes);
+}
+
+/* object hash buckets, a power of two kept at most 3/4 full */
+static size_t
+_jsmnf_compact_capacity(size_t size)
+{
+    size_t capacity = 1;
+
+    if (!size) return 0;
+    while (capacity * 3 < size * 4)
+        capacity <<= 1;
+    return capacity;
+}
+
+/* amount of words taken by a node's children and hash buckets */
+static size_t
+_jsmnf_compact_width(const struct jsmntok *tok)
+{
+    const size_t size = tok->size > 0 ? (size_t)tok->size : 0;
+
+    switch (tok->type) {
+    case JSMN_OBJECT:
+        return size + _jsmnf_compact_capacity(size);
+    case JSMN_ARRAY:
+        return size;
+    default:
+        return 0;
+    }
+}
+
+/* FNV-1a */
+static uint32_t
+_jsmnf_compact_hash(const char key[], size_t len)
+{
+    uint32_t hash = 2166136261u;
+
+    while (len--) {
+        hash ^= (unsigned char)*key++;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/* bucket of the object member whose key matches, or the empty bucket it
+ *      would take */
+static uint32_t *
+_jsmnf_compact_bucket(const char js[],
+                      const struct jsmnf_node nodes[],
+                      const uint32_t *buckets,
+                      size_t capacity,
+                      const char key[],
+                      size_t len)
+{
+    size_t slot = _jsmnf_compact_hash(key, len) & (capacity - 1);
+
+    while (buckets[slot]) {
+        const struct jsmnf_node *other = nodes + buckets[slot];
+
+        if (other->end - other->start == len
+            && 0 == memcmp(js + other->start, key, len))
+        {
+            break;
+        }
+        slot = (slot + 1) & (capacity - 1);
+    }
+    return (uint32_t *)buckets + slot;
+}
+
+/* fill children and hash buckets of the subtree at `i`, returns the index
+ *      of its next sibling or `0` if the tokens are malformed */
+static size_t
+_jsmnf_compact_fill(const char js[],
+                    const struct jsmnf_node nodes[],
+                    uint32_t words[],
+                    size_t num_nodes,
+                    size_t i)
+{
+    const struct jsmnf_node *node = nodes + i;
+    const size_t capacity = _jsmnf_compact_capacity(node->size);
+    uint32_t *children = words + node->fields,
+             *buckets = children + node->size;
+    size_t next = i + 1, n;
+
+    if (JSMN_OBJECT != node->type && JSMN_ARRAY != node->type) return next;
+
+    for (n = 0; n < node->size; ++n) {
+        if (next >= num_nodes) return 0;
+
+        children[n] = (uint32_t)next;
+        if (JSMN_ARRAY == node->type) {
+            next = _jsmnf_compact_fill(js, nodes, words, num_nodes, next);
+        }
+        else {
+            const struct jsmnf_node *key = nodes + next;
+
+            *_jsmnf_compact_bucket(js, nodes, buckets, capacity,
+                                   js + key->start, key->end - key->start) =
+                (uint32_t)next;
+            if (!key->size)
+                ++next;
+            else if (next + 1 >= num_nodes)
+                return 0;
+            else
+                next = _jsmnf_compact_fill(js, nodes, words, num_nodes,
+                                           next + 1);
+        }
+        if (!next) return 0;
+    }
+    return next;
+}
+
+/* tokenize into the nodes area, can be resumed with the same `parser` once
+ *      `table` has grown */
+static int
+_jsmnf_compact_parse(struct jsmn_parser *parser,
+                     const char js[],
+                     size_t len,
+                     struct jsmnf_compact *table,
+                     size_t size)
+{
+    const size_t offset = sizeof *table + table->js_size;
+    size_t max_tokens;
+
+    if (len > INT_MAX) return JSMNF_ERROR_RANGE;
+    if (size < offset) return JSMN_ERROR_NOMEM;
+
+    max_tokens = (size - offset) / sizeof(struct jsmnf_node);
+    if (max_tokens > UINT_MAX) max_tokens = UINT_MAX;
+
+    return jsmn_parse(parser, js, len,
+                      (struct jsmntok *)((char *)table + offset),
+                      (unsigned)max_tokens);
+}
+
+/* rewrite the `num_nodes` parsed tokens as nodes, `table` is left untouched
+ *      if it's too small */
+static long
+_jsmnf_compact_build(const char js[],
+                     struct jsmnf_compact *table,
+                     size_t size,
+                     size_t num_nodes)
+{
+    const size_t offset = sizeof *table + table->js_size;
+    struct jsmntok *tokens = (struct jsmntok *)((char *)table + offset);
+    struct jsmnf_node *nodes = (struct jsmnf_node *)tokens;
+    size_t num_words = 0, suffix = 0, i;
+    uint32_t *words;
+
+    for (i = 0; i < num_nodes; ++i)
+        num_words += _jsmnf_compact_width(tokens + i);
+    if (num_words > UINT32_MAX
+        || num_words > (size - offset - num_nodes * sizeof *nodes)
+                           / sizeof *words)
+    {
+        return JSMN_ERROR_NOMEM;
+    }
+
+    /* nodes are wider than tokens, rewrite them from back to front */
+    for (i = num_nodes; i-- > 0;) {
+        const struct jsmntok tok = tokens[i];
+        struct jsmnf_node *node = nodes + i;
+
+        suffix += _jsmnf_compact_width(&tok);
+        node->type = (uint16_t)tok.type;
+        node->flags = _jsmnf_has_escapes(js, &tok) ? JSMNF_VALUE_ESCAPED : 0;
+        node->start = (uint32_t)tok.start;
+        node->end = (uint32_t)tok.end;
+        node->size = tok.size > 0 ? (uint32_t)tok.size : 0;
+        node->fields = (uint32_t)(num_words - suffix);
+    }
+
+    table->num_nodes = (uint32_t)num_nodes;
+    table->num_words = (uint32_t)num_words;
+    words = (uint32_t *)_jsmnf_compact_words(table);
+    memset(words, 0, num_words * sizeof *words);
+
+    if (num_nodes && !_jsmnf_compact_fill(js, nodes, words, num_nodes, 0))
+        return JSMN_ERROR_INVAL;
+
+    return (long)jsmnf_compact_size(table);
+}
+
+/* copy the JSON string into `table`, ahead of its nodes */
+static int
+_jsmnf_compact_embed(const char js[],
+                     size_t len,
+                     struct jsmnf_compact *table,
+                     size_t size)
+{
+    if (size < sizeof *table || len > UINT32_MAX - 4) return JSMN_ERROR_NOMEM;
+
+    table->num_nodes = table->num_words = 0;
+    table->js_len = (uint32_t)len;
+    /* NUL-terminated and padded for the nodes alignment */
+    table->js_size = (uint32_t)((len + 4) & ~(size_t)3);
+    if (size - sizeof *table < table->js_size) return JSMN_ERROR_NOMEM;
+
+    memcpy(table + 1, js, len);
+    memset((char *)(table + 1) + len, 0, table->js_size - len);
+    return 0;
+}
+
+JSMN_API long
+jsmnf_compact_load(const char js[],
+                   size_t len,
+                   struct jsmnf_compact *table,
+                   size_t size)
+{
+    jsmn_parser parser;
+    int ret;
+
+    if (size < sizeof *table) return JSMN_ERROR_NOMEM;
+
+    table->num_nodes = table->num_words = 0;
+    table->js_len = table->js_size = 0;
+
+    jsmn_init(&parser);
+    if ((ret = _jsmnf_compact_parse(&parser, js, len, table, size)) < 0)
+        return ret;
+    return _jsmnf_compact_build(js, table, size, (size_t)ret);
+}
+
+JSMN_API long
+jsmnf_compact_load_doc(const char js[],
+                       size_t len,
+                       struct jsmnf_compact *table,
+                       size_t size)
+{
+    jsmn_parser parser;
+    int ret;
+
+    if ((ret = _jsmnf_compact_embed(js, len, table, size)) < 0) return ret;
+
+    js = jsmnf_compact_js(table);
+    jsmn_init(&parser);
+    if ((ret = _jsmnf_compact_parse(&parser, js, len, table, size)) < 0)
+        return ret;
+    return _jsmnf_compact_build(js, table, size, (size_t)ret);
+}
+
+static int
+_jsmnf_compact_grow(const struct jsmnf_allocator *allocator,
+                    struct jsmnf_compact **p_table,
+                    size_t *size)
+{
+    void *tmp;
+
+    if (*size > (size_t)-1 / 2) return JSMN_ERROR_NOMEM;
+    if (!(tmp = allocator->resize(allocator->ctx, *p_table, *size, *size * 2)))
+        return JSMN_ERROR_NOMEM;
+    *p_table = tmp;
+    *size *= 2;
+    return 0;
+}
+
+JSMN_API long
+jsmnf_compact_load_auto(const struct jsmnf_allocator *allocator,
+                        const char js[],
+                        size_t len,
+                        struct jsmnf_compact **p_table,
+                        size_t *size)
+{
+    jsmn_parser parser;
+    long ret;
+
+    allocator = _JSMNF_ALLOCATOR(allocator);
+    if (NULL == *p_table || *size < JSMNF_COMPACT_SIZE(1) + len + 4) {
+        const size_t new_size = JSMNF_COMPACT_SIZE(1) + len + 4;
+        void *tmp = *p_table ? allocator->resize(allocator->ctx, *p_table,
+                                                 *size, new_size)
+                             : allocator->alloc(allocator->ctx, new_size);
+
+        if (!tmp) return JSMN_ERROR_NOMEM;
+        *p_table = tmp;
+        *size = new_size;
+    }
+    if ((ret = _jsmnf_compact_embed(js, len, *p_table, *size)) < 0)
+        return ret;
+
+    /* offsets survive reallocation, so tokenizing resumes where it stopped */
+    jsmn_init(&parser);
+    while ((ret = _jsmnf_compact_parse(&parser, jsmnf_compact_js(*p_table),
+                                       len, *p_table, *size))
+           == JSMN_ERROR_NOMEM)
+    {
+        if ((ret = _jsmnf_compact_grow(allocator, p_table, size)) < 0)
+            return ret;
+    }
+    if (ret < 0) return ret;
+
+    for (;;) {
+        const size_t num_nodes = (size_t)ret;
+
+        ret = _jsmnf_compact_build(jsmnf_compact_js(*p_table), *p_table,
+                                   *size, num_nodes);
+        if (ret != JSMN_ERROR_NOMEM) return ret;
+        if ((ret = _jsmnf_compact_grow(allocator, p_table, size)) < 0)
+            return ret;
+        ret = (long)num_nodes;
+    }
+}
+
+JSMN_API size_t
+jsmnf_compact_size(const struct jsmnf_compact *table)
+{
+    return sizeof *table + table->js_size
+           + table->num_nodes * sizeof(struct jsmnf_node)
+           + table->num_words * sizeof(uint32_t);
+}
+
+JSMN_API const char *
+jsmnf_compact_js(const struct jsmnf_compact *table)
+{
+    return table->js_size ? (const char *)(table + 1) : NULL;
+}
+
+JSMN_API const struct jsmnf_node *
+jsmnf_compact_root(const struct jsmnf_compact *table)
+{
+    return table->num_nodes ? _jsmnf_compact_nodes(table) : NULL;
+}
+
+JSMN_API const struct jsmnf_node *
+jsmnf_compact_field(const struct jsmnf_compact *table,
+                    const struct jsmnf_node *head,
+                    size_t index)
+{
+    const struct jsmnf_node *nodes = _jsmnf_compact_nodes(table);
+    const uint32_t *children;
+
+    if (!head || index >= head->size) return NULL;
+
+    children = _jsmnf_compact_words(table) + head->fields;
+    if (JSMN_ARRAY == head->type) return nodes + children[index];
+    if (JSMN_OBJECT == head->type && nodes[children[index]].size)
+        return nodes + children[index] + 1;
+    return NULL;
+}
+
+JSMN_API const struct jsmnf_node *
+jsmnf_compact_find(const struct jsmnf_compact *table,
+                   const struct jsmnf_node *head,
+                   const char js[],
+                   const char key[],
+                   size_t length)
+{
+    if (!head) return NULL;
+    if (!key && !length) return head;
+
+    if (JSMN_OBJECT == head->type) {
+        const struct jsmnf_node *nodes = _jsmnf_compact_nodes(table);
+        const uint32_t *buckets =
+            _jsmnf_compact_words(table) + head->fields + head->size;
+        uint32_t key_idx;
+
+        if (!head->size) return NULL;
+
+        key_idx = *_jsmnf_compact_bucket(
+            js, nodes, buckets, _jsmnf_compact_capacity(head->size), key,
+            length);
+        return key_idx && nodes[key_idx].size ? nodes + key_idx + 1 : NULL;
+    }
+    if (JSMN_ARRAY == head->type) {
+        char *endptr;
+        const unsigned long idx = strtoul(key, &endptr, 10);
+
+        if (endptr != key) return jsmnf_compact_field(table, head, idx);
+    }
+    return NULL;
+}
+
+JSMN_API const struct jsmnf_node *
+jsmnf_compact_find_path(const struct jsmnf_compact *table,
+                        const struct jsmnf_node *head,
+                        const char js[],
+                        char *const path[],
+                        unsigned depth)
+{
+    const struct jsmnf_node *iter = head, *found = NULL;
+    unsigned i;
+    for (i = 0; i < depth; ++i) {
+        if (!iter) break;
+        found =
+            jsmnf_compact_find(table, iter, js, path[i], strlen(path[i]));
+        if (!found) break;
+        iter = found;
+    }
+    return found;
+}
+
+#define _JSMNF_INDEXED_MAGIC   "JSMNFIDX"
+#define _JSMNF_INDEXED_VERSION 1
+
+/* persisted index file header, followed by the compact index block */
+struct _jsmnf_indexed_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t checksum;
+    uint64_t size;
+};
+
+/* word at a time hash of the 4-byte aligned compact index block */
+static uint32_t
+_jsmnf_indexed_checksum(const struct jsmnf_compact *table, size_t size)
+{
+    const uint32_t *word = (const uint32_t *)table,
+                   *const end = word + size / sizeof *word;
+    uint32_t hash = 2166136261u;
+
+    while (word < end) {
+        hash = (hash ^ *word++) * 0x9E3779B1u;
+        hash ^= hash >> 15;
+    }
+    return hash;
+}
+
+/* check in a single pass that every node is laid out as
+ *      _jsmnf_compact_build() does, so that no child, key or bucket offset
+ *      reaches out of the index */
+static long
+_jsmnf_indexed_check_nodes(const struct jsmnf_compact *table)
+{
+    const struct jsmnf_node *nodes = _jsmnf_compact_nodes(table);
+    const uint32_t *words = _jsmnf_compact_words(table);
+    const size_t num_nodes = table->num_nodes;
+    size_t next_word = 0, i, n;
+
+    for (i = 0; i < num_nodes; ++i) {
+        const struct jsmnf_node *node = nodes + i;
+        size_t capacity = 0, used = 0;
+
+        if (node->start > node->end || node->end > table->js_len
+            || node->fields != next_word)
+        {
+            return JSMN_ERROR_INVAL;
+        }
+        if (JSMN_OBJECT != node->type && JSMN_ARRAY != node->type) continue;
+
+        if (node->size > table->num_words - next_word)
+            return JSMN_ERROR_INVAL;
+        if (JSMN_OBJECT == node->type)
+            capacity = _jsmnf_compact_capacity(node->size);
+        if (capacity > table->num_words - next_word - node->size)
+            return JSMN_ERROR_INVAL;
+
+        /* keys of object members are followed by their value */
+        for (n = 0; n < node->size; ++n) {
+            const uint32_t child = words[next_word + n];
+
+            if (child >= num_nodes
+                || (JSMN_OBJECT == node->type && nodes[child].size
+                    && child + 1 >= num_nodes))
+            {
+                return JSMN_ERROR_INVAL;
+            }
+        }
+        next_word += node->size;
+        /* lookups probe until an empty bucket */
+        for (n = 0; n < capacity; ++n) {
+            const uint32_t key = words[next_word + n];
+
+            if (!key) continue;
+            if (key >= num_nodes || (nodes[key].size && key + 1 >= num_nodes)
+                || ++used > node->size)
+            {
+                return JSMN_ERROR_INVAL;
+            }
+        }
+        next_word += capacity;
+    }
+    return next_word == table->num_words ? 0 : JSMN_ERROR_INVAL;
+}
+
+static long
+_jsmnf_indexed_check(const char base[], size_t file_size)
+{
+    const struct jsmnf_compact *table;
+    struct _jsmnf_indexed_header header;
+    uint64_t size;
+
+    if (file_size < sizeof header + sizeof *table) return JSMN_ERROR_INVAL;
+
+    memcpy(&header, base, sizeof header);
+    if (memcmp(header.magic, _JSMNF_INDEXED_MAGIC, sizeof header.magic)
+        || header.version != _JSMNF_INDEXED_VERSION
+        || header.size != file_size - sizeof header)
+    {
+        return JSMN_ERROR_INVAL;
+    }
+
+    table = (const struct jsmnf_compact *)(base + sizeof header);
+    size = (uint64_t)sizeof *table + table->js_size
+           + (uint64_t)table->num_nodes * sizeof(struct jsmnf_node)
+           + (uint64_t)table->num_words * sizeof(uint32_t);
+    if (size != header.size || !table->js_size || table->js_size % 4
+        || table->js_len >= table->js_size)
+    {
+        return JSMN_ERROR_INVAL;
+    }
+    if (header.checksum != _jsmnf_indexed_checksum(table, (size_t)size))
+        return JSMN_ERROR_INVAL;
+    /* the checksum catches accidents, not hand-built files */
+    return _jsmnf_indexed_check_nodes(table);
+}
+
+/* map a whole file read-only, or read it into memory from `allocator` if
+ *      mmap() is unavailable */
+static long
+_jsmnf_map_file(const struct jsmnf_allocator *allocator,
+                const char path[],
+                char **p_base,
+                size_t *p_size)
+{
+#ifdef _JSMNF_MMAP
+    struct stat st;
+    void *base;
+    int fd;
+
+    (void)allocator;
+    if ((fd = open(path, O_RDONLY)) < 0) return JSMNF_ERROR_IO;
+    if (fstat(fd, &st) < 0) {
+        close(fd);
+        return JSMNF_ERROR_IO;
+    }
+    if (st.st_size <= 0) {
+        close(fd);
+        return JSMN_ERROR_PART;
+    }
+    base = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (MAP_FAILED == base) return JSMNF_ERROR_IO;
+
+    *p_base = base;
+    *p_size = (size_t)st.st_size;
+#else
+    long size;
+    char *base;
+    FILE *fp;
+
+    if (!(fp = fopen(path, "rb"))) return JSMNF_ERROR_IO;
+    if (fseek(fp, 0, SEEK_END) != 0 || (size = ftell(fp)) < 0
+        || fseek(fp, 0, SEEK_SET) != 0)
+    {
+        fclose(fp);
+        return JSMNF_ERROR_IO;
+    }
+    if (!size) {
+        fclose(fp);
+        return JSMN_ERROR_PART;
+    }
+    if (!(base = allocator->alloc(allocator->ctx, (size_t)size))) {
+        fclose(fp);
+        return JSMN_ERROR_NOMEM;
+    }
+    if (fread(base, (size_t)size, 1, fp) != 1) {
+        fclose(fp);
+        allocator->release(allocator->ctx, base);
+        return JSMNF_ERROR_IO;
+    }
+    fclose(fp);
+
+    *p_base = base;
+    *p_size = (size_t)size;
+#endif
+    return 0;
+}
+
+static void
+_jsmnf_unmap_file(const struct jsmnf_allocator *allocator,
+                  char base[],
+                  size_t size)
+{
+#ifdef _JSMNF_MMAP
+    (void)allocator;
+    munmap(base, size);
+#else
+    (void)size;
+    allocator->release(allocator->ctx, base);
+#endif
+}
+
+/* hint the kernel on how a mapping is about to be accessed */
+static void
+_jsmnf_advise_file(char base[], size_t size, int sequential)
+{
+#if defined(_JSMNF_MMAP) && defined(POSIX_MADV_SEQUENTIAL)
+    posix_madvise(base, size,
+                  sequential ? POSIX_MADV_SEQUENTIAL : POSIX_MADV_NORMAL);
+#elif defined(_JSMNF_MMAP) && defined(MADV_SEQUENTIAL)
+    madvise(base, size, sequential ? MADV_SEQUENTIAL : MADV_NORMAL);
+#else
+    (void)base;
+    (void)size;
+    (void)sequential;
+#endif
+}
+
+JSMN_API long
+jsmnf_save_indexed(const struct jsmnf_compact *table, const char path[])
+{
+    const size_t size = jsmnf_compact_size(table);
+    struct _jsmnf_indexed_header header;
+    FILE *fp;
+    int ok;
+
+    if (!table->js_size) return JSMN_ERROR_INVAL;
+
+    memcpy(header.magic, _JSMNF_INDEXED_MAGIC, sizeof header.magic);
+    header.version = _JSMNF_INDEXED_VERSION;
+    header.checksum = _jsmnf_indexed_checksum(table, size);
+    header.size = size;
+
+    if (!(fp = fopen(path, "wb"))) return JSMNF_ERROR_IO;
+    ok = 1 == fwrite(&header, sizeof header, 1, fp)
+         && 1 == fwrite(table, size, 1, fp);
+    if (fclose(fp) != 0) ok = 0;
+    return ok ? 0 : JSMNF_ERROR_IO;
+}
+
+JSMN_API long
+jsmnf_open_indexed(const char path[], const struct jsmnf_compact **p_table)
+{
+    size_t file_size;
+    char *base;
+    long ret;
+
+    if ((ret = _jsmnf_map_file(&_jsmnf_default_allocator, path, &base,
+                               &file_size))
+        < 0)
+    {
+        return JSMN_ERROR_PART == ret ? JSMN_ERROR_INVAL : ret;
+    }
+    if ((ret = _jsmnf_indexed_check(base, file_size)) < 0) {
+        _jsmnf_unmap_file(&_jsmnf_default_allocator, base, file_size);
+        return ret;
+    }
+    base += sizeof(struct _jsmnf_indexed_header);
+    *p_table = (const struct jsmnf_compact *)base;
+    return 0;
+}
+
+JSMN_API void
+jsmnf_close_indexed(const struct jsmnf_compact *table)
+{
+    const size_t offset = sizeof(struct _jsmnf_indexed_header);
+
+    if (!table) return;
+    _jsmnf_unmap_file(&_jsmnf_default_allocator, (char *)table - offset,
+                      offset + jsmnf_compact_size(table));
+}
+
+JSMN_API long
+jsmnf_load_file(struct jsmnf_loader *loader,
+                const char path[],
+                const char **p_js,
+                size_t *p_len,
+                struct jsmnf_table **p_table,
+                size_t *table_len)
+{
+    const struct jsmnf_allocator *allocator =
+        _JSMNF_ALLOCATOR(loader->allocator);
+    size_t len;
+    char *js;
+    long ret;
+
+    *p_js = NULL;
+    *p_len = 0;
+    if ((ret = _jsmnf_map_file(allocator, path, &js, &len)) < 0) return ret;
+
+    /* tokenizing walks the file front to back, lookups don't */
+    _jsmnf_advise_file(js, len, 1);
+    ret = jsmnf_load_auto(loader, js, len, p_table, table_len);
+    _jsmnf_advise_file(js, len, 0);
+    if (ret < 0) {
+        _jsmnf_unmap_file(allocator, js, len);
+        return ret;
+    }
+
+    *p_js = js;
+    *p_len = len;
+    return ret;
+}
+
+JSMN_API void
+jsmnf_close_file(struct jsmnf_loader *loader,
+                 const char js[],
+                 size_t len,
+                 struct jsmnf_table *table)
+{
+    const struct jsmnf_allocator *allocator =
+        _JSMNF_ALLOCATOR(loader->allocator);
+
+    if (js) _jsmnf_unmap_file(allocator, (char *)js, len);
+    allocator->release(allocator->ctx, table);
+}
+
+#undef _JSMNF_INDEXED_MAGIC
+#undef _JSMNF_INDEXED_VERSION
+
+JSMN_API void
+jsmnf_doc_init(struct jsmnf_doc *doc, const struct jsmnf_allocator *allocator)
+{
+    doc->arena = NULL;
+    doc->size = 0;
+    jsmnf_init(&doc->loader);
+    jsmnf_init_allocator(&doc->loader, allocator);
+    jsmnf_doc_reset(doc);
+}
+
+JSMN_API void
+jsmnf_doc_reset(struct jsmnf_doc *doc)
+{
+    const struct jsmnf_allocator *allocator = doc->loader.allocator;
+
+    jsmnf_init(&doc->loader);
+    jsmnf_init_allocator(&doc->loader, allocator);
+    doc->js = NULL;
+    doc->len = 0;
+    doc->strings = NULL;
+    doc->strings_len = doc->stringsnext = 0;
+}
+
+JSMN_API void
+jsmnf_doc_free(struct jsmnf_doc *doc)
+{
+    const struct jsmnf_allocator *allocator =
+        _JSMNF_ALLOCATOR(doc->loader.allocator);
+
+    allocator->release(allocator->ctx, doc->arena);
+    jsmnf_doc_init(doc, doc->loader.allocator);
+}
+
+JSMN_API long
+jsmnf_doc_load(struct jsmnf_doc *doc, const char js[], size_t len, int copy)
+{
+    const struct jsmnf_allocator *allocator =
+        _JSMNF_ALLOCATOR(doc->loader.allocator);
+    /* keys and strings never unescape to more bytes than the JSON string */
+    size_t chars, num_slots;
+    long ret;
+
+    if (len > INT_MAX) return JSMNF_ERROR_RANGE;
+    if (len > (size_t)-1 / 4) return JSMN_ERROR_NOMEM;
+
+    chars = (copy ? len : 0) + 2 * len;
+    num_slots = doc->size > chars
+                    ? (doc->size - chars) / sizeof(struct jsmnf_table)
+                    : 0;
+    /* a first guess, as tokens are rarely under 8 bytes long */
+    if (num_slots < 16 + len / 8) num_slots = 16 + len / 8;
+    /* the arena is laid out as [table][JSON copy][keys][strings] */
+    while (1) {
+        char *bytes;
+
+        jsmnf_doc_reset(doc);
+        if (num_slots * sizeof(struct jsmnf_table) + chars > doc->size) {
+            /* the arena contents are disposable, so skip resize()'s copy */
+            allocator->release(allocator->ctx, doc->arena);
+            doc->size = num_slots * sizeof(struct jsmnf_table) + chars;
+            if (!(doc->arena = allocator->alloc(allocator->ctx, doc->size)))
+            {
+                doc->size = 0;
+                return JSMN_ERROR_NOMEM;
+            }
+        }
+
+        bytes = doc->arena + num_slots * sizeof(struct jsmnf_table);
+        doc->js = js;
+        doc->len = len;
+        if (copy) {
+            memcpy(bytes, js, len);
+            doc->js = bytes;
+            bytes += len;
+        }
+        jsmnf_init_keys(&doc->loader, bytes, len);
+        doc->strings = bytes + len;
+        doc->strings_len = len;
+
+        ret = jsmnf_load(&doc->loader, doc->js, len,
+                         (struct jsmnf_table *)doc->arena, num_slots);
+        if (ret != JSMN_ERROR_NOMEM
+            || num_slots
+                   > ((size_t)-1 - chars) / sizeof(struct jsmnf_table) / 2)
+        {
+            break;
+        }
+        num_slots *= 2;
+    }
+    if (ret < 0) jsmnf_doc_reset(doc);
+    return ret;
+}
+
+JSMN_API long
+jsmnf_doc_string(struct jsmnf_doc *doc,
+                 const struct jsmnf_pair *pair,
+                 const char **p_str)
+{
+    char *buf;
+    long ret;
+
+    if (!doc->js) return JSMN_ERROR_INVAL;
+
+    buf = doc->strings + doc->stringsnext;
+    ret = jsmnf_get_string(pair, doc->js, buf,
+                           doc->strings_len - doc->stringsnext, p_str);
+    if (ret > 0 && *p_str == buf) doc->stringsnext += (size_t)ret;
+    return ret;
+}
+
+/* mirrors _jsmnf_load_pairs(), which reserves `1 + size` pairs for every
+ *      container in token order and requires as many more below them */
+static size_t
+_jsmnf_clone_index_len(const struct jsmntok tokens[],
+                       const unsigned num_tokens)
+{
+    size_t pairnext = 1, index_len = 1;
+    unsigned i;
+
+    for (i = 0; i < num_tokens; ++i) {
+        const size_t size = (size_t)tokens[i].size;
+
+        if (JSMN_OBJECT != tokens[i].type && JSMN_ARRAY != tokens[i].type)
+            continue;
+        if (index_len < 2 * pairnext + 1 + size)
+            index_len = 2 * pairnext + 1 + size;
+        pairnext += 1 + size;
+    }
+    return index_len;
+}
+
+JSMN_API long
+jsmnf_clone_subtree(const struct jsmnf_pair *pair,
+                    const char js[],
+                    const struct jsmnf_allocator *allocator,
+                    struct jsmnf_clone **p_clone)
+{
+    const struct jsmntok *v;
+    struct jsmnf_loader loader;
+    struct jsmnf_clone *clone;
+    struct jsmnf_index *index;
+    struct jsmntok *tokens;
+    size_t len, index_len, keys_len = 0, size;
+    unsigned num_tokens = 0, remaining = 1, i;
+    int start;
+    char *bytes;
+    long ret;
+
+    *p_clone = NULL;
+    if (!pair || !(v = pair->v)) return JSMN_ERROR_INVAL;
+
+    /* every token is followed by its `size` children */
+    do {
+        const struct jsmntok *tok = v + num_tokens++;
+
+        remaining += (unsigned)tok->size;
+        --remaining;
+        if (JSMN_STRING == tok->type && tok->size > 0
+            && _jsmnf_has_escapes(js, tok))
+        {
+            keys_len += (size_t)(tok->end - tok->start);
+        }
+    } while (remaining);
+
+    /* a string's span excludes its quotes, which are cloned along */
+    start = v->start - (JSMN_STRING == v->type);
+    len = (size_t)(v->end + (JSMN_STRING == v->type) - start);
+    index_len = _jsmnf_clone_index_len(v, num_tokens);
+    /* [header][index][tokens][JSON string][keys] */
+    size = sizeof *clone + index_len * sizeof *index
+           + num_tokens * sizeof *tokens + len + keys_len;
+
+    allocator = _JSMNF_ALLOCATOR(allocator);
+    if (!(clone = allocator->alloc(allocator->ctx, size)))
+        return JSMN_ERROR_NOMEM;
+    index = (struct jsmnf_index *)(clone + 1);
+    tokens = (struct jsmntok *)(index + index_len);
+    bytes = (char *)(tokens + num_tokens);
+
+    memcpy(bytes, js + start, len);
+    memcpy(tokens, v, num_tokens * sizeof *tokens);
+    for (i = 0; i < num_tokens; ++i) {
+        tokens[i].start -= start;
+        tokens[i].end -= start;
+#ifdef JSMN_PARENT_LINKS
+        /* the root's children hold its index in the document */
+        tokens[i].parent = i ? tokens[i].parent - v[1].parent : -1;
+#endif
+    }
+
+    jsmnf_init(&loader);
+    jsmnf_init_keys(&loader, bytes + len, keys_len);
+    if ((ret = jsmnf_load_tokens(&loader, bytes, tokens, num_tokens, index,
+                                 index_len))
+        < 0)
+    {
+        allocator->release(allocator->ctx, clone);
+        return ret;
+    }
+
+    clone->root = loader.root;
+    clone->js = bytes;
+    clone->len = len;
+    clone->allocator = allocator;
+    *p_clone = clone;
+    return (long)size;
+}
+
+JSMN_API void
+jsmnf_clone_free(struct jsmnf_clone *clone)
+{
+    if (clone) clone->allocator->release(clone->allocator->ctx, clone);
+}
+
+struct _jsmnf_serializer {
+    const char *js;
+    unsigned flags;
+    jsmnf_sink sink;
+    void *ctx;
+    /** pending span of `js` to be written as-is */
+    size_t run_start, run_end;
+    /** end of the serialized value's span of `js` */
+    size_t limit;
+    /** keep the whitespace between spans of `js`, see jsmnf_overlay_write() */
+    int splice;
+    /** amount of bytes written so far */
+    long written;
+    /** staging buffer for small writes */
+    size_t buflen;
+    char buf[256];
+};
+
+static int
+_jsmnf_serializer_put(struct _jsmnf_serializer *ser,
+                      const char data[],
+                      size_t len)
+{
+    int ret;
+
+    if (len > sizeof(ser->buf) - ser->buflen) {
+        if (ser->buflen
+            && (ret = ser->sink(ser->ctx, ser->buf, ser->buflen)) < 0)
+        {
+            return ret;
+        }
+        ser->buflen = 0;
+        if (len > sizeof(ser->buf)) {
+            if ((ret = ser->sink(ser->ctx, data, len)) < 0) return ret;
+            ser->written += (long)len;
+            return 0;
+        }
+    }
+    memcpy(ser->buf + ser->buflen, data, len);
+    ser->buflen += len;
+    ser->written += (long)len;
+    return 0;
+}
+
+static int
+_jsmnf_serializer_flush_run(struct _jsmnf_serializer *ser)
+{
+    const size_t len = ser->run_end - ser->run_start;
+
+    ser->run_start = ser->run_end;
+    return len ? _jsmnf_serializer_put(ser, ser->js + ser->run_end - len, len)
+               : 0;
+}
+
+/* write bytes that aren't part of `js`, after the pending span */
+static int
+_jsmnf_serializer_literal(struct _jsmnf_serializer *ser,
+                          const char data[],
+                          size_t len)
+{
+    int ret;
+
+    if ((ret = _jsmnf_serializer_flush_run(ser)) < 0) return ret;
+    return _jsmnf_serializer_put(ser, data, len);
+}
+
+/* end of the whitespace from `js[pos]` when splicing, `pos` otherwise */
+static size_t
+_jsmnf_serializer_skip_blank(const struct _jsmnf_serializer *ser, size_t pos)
+{
+    if (ser->splice)
+        while (pos < ser->limit && _jsmnf_query_is_space(ser->js[pos]))
+            ++pos;
+    return pos;
+}
+
+/* write `js[start, end)`, extending the pending span if it's contiguous */
+static int
+_jsmnf_serializer_span(struct _jsmnf_serializer *ser, size_t start, size_t end)
+{
+    if (start != ser->run_end
+        && start != _jsmnf_serializer_skip_blank(ser, ser->run_end))
+    {
+        int ret;
+
+        if ((ret = _jsmnf_serializer_flush_run(ser)) < 0) return ret;
+        ser->run_start = start;
+    }
+    ser->run_end = end;
+    return 0;
+}
+
+/* write a separator, taken from `js` if it's next to the pending span */
+static int
+_jsmnf_serializer_char(struct _jsmnf_serializer *ser, char c)
+{
+    const size_t pos = _jsmnf_serializer_skip_blank(ser, ser->run_end);
+
+    if (pos < ser->limit && ser->js[pos] == c) {
+        ser->run_end = pos + 1;
+        return 0;
+    }
+    return _jsmnf_serializer_literal(ser, &c, 1);
+}
+
+static int
+_jsmnf_serializer_indent(struct _jsmnf_serializer *ser, unsigned depth)
+{
+    static const char spaces[] = "                ";
+    int ret;
+
+    if (!(ser->flags & JSMNF_WRITE_PRETTY)) return 0;
+    if ((ret = _jsmnf_serializer_literal(ser, "\n", 1)) < 0) return ret;
+    for (depth *= 2; depth > 0;) {
+        const unsigned n =
+            depth < sizeof(spaces) - 1 ? depth : (unsigned)sizeof(spaces) - 1;
+
+        if ((ret = _jsmnf_serializer_put(ser, spaces, n)) < 0) return ret;
+        depth -= n;
+    }
+    return 0;
+}
+
+/* strings are written along with their quotes */
+static int
+_jsmnf_serializer_token(struct _jsmnf_serializer *ser,
+                        const struct jsmntok *tok)
+{
+    const size_t quote = JSMN_STRING == tok->type;
+
+    return _jsmnf_serializer_span(ser, (size_t)tok->start - quote,
+                                  (size_t)tok->end + quote);
+}
+
+static void
+_jsmnf_serializer_init(struct _jsmnf_serializer *ser,
+                       const struct jsmnf_pair *pair,
+                       const char js[],
+                       unsigned flags,
+                       jsmnf_sink sink,
+                       void *ctx)
+{
+    ser->js = js;
+    ser->flags = flags;
+    ser->sink = sink;
+    ser->ctx = ctx;
+    ser->run_start = ser->run_end = (size_t)pair->v->start;
+    ser->limit = (size_t)pair->v->end;
+    ser->splice = 0;
+    ser->written = 0;
+    ser->buflen = 0;
+}
+
+/* hand the pending bytes over to the sink */
+static long
+_jsmnf_serializer_finish(struct _jsmnf_serializer *ser)
+{
+    int ret;
+
+    if ((ret = _jsmnf_serializer_flush_run(ser)) < 0) return ret;
+    if (ser->buflen && (ret = ser->sink(ser->ctx, ser->buf, ser->buflen)) < 0)
+        return ret;
+    return ser->written;
+}
+
+static int
+_jsmnf_write_pair(struct _jsmnf_serializer *ser,
+                  const struct jsmnf_pair *pair,
+                  unsigned depth)
+{
+    const struct jsmntok *v = pair->v;
+    size_t i;
+    int ret;
+
+    if (!v) /* empty array slot of a projection */
+        return _jsmnf_serializer_literal(ser, "null", 4);
+    if (JSMN_OBJECT != v->type && JSMN_ARRAY != v->type)
+        return _jsmnf_serializer_token(ser, v);
+
+    if ((ret = _jsmnf_serializer_span(ser, (size_t)v->start,
+                                      (size_t)v->start + 1))
+        < 0)
+    {
+        return ret;
+    }
+    for (i = 0; i < pair->length; ++i) {
+        const struct jsmnf_pair *field = pair->fields + i;
+
+        if ((i && (ret = _jsmnf_serializer_char(ser, ',')) < 0)
+            || (ret = _jsmnf_serializer_indent(ser, depth + 1)) < 0)
+        {
+            return ret;
+        }
+        if (JSMN_OBJECT == v->type) {
+            if ((ret = _jsmnf_serializer_token(ser, field->k)) < 0
+                || (ret = _jsmnf_serializer_char(ser, ':')) < 0)
+            {
+                return ret;
+            }
+            if ((ser->flags & JSMNF_WRITE_PRETTY)
+                && (ret = _jsmnf_serializer_literal(ser, " ", 1)) < 0)
+            {
+                return ret;
+            }
+        }
+        if ((ret = _jsmnf_write_pair(ser, field, depth + 1)) < 0)
+            return ret;
+    }
+    if (pair->length && (ret = _jsmnf_serializer_indent(ser, depth)) < 0)
+        return ret;
+    return _jsmnf_serializer_span(ser, (size_t)v->end - 1, (size_t)v->end);
+}
+
+JSMN_API long
+jsmnf_write(const struct jsmnf_pair *pair,
+            const char js[],
+            unsigned flags,
+            jsmnf_sink sink,
+            void *ctx)
+{
+    struct _jsmnf_serializer ser;
+    int ret;
+
+    if (!pair || !pair->v) return JSMN_ERROR_INVAL;
+
+    _jsmnf_serializer_init(&ser, pair, js, flags, sink, ctx);
+    if ((ret = _jsmnf_write_pair(&ser, pair, 0)) < 0) return ret;
+    return _jsmnf_serializer_finish(&ser);
+}
+
+struct _jsmnf_write_buf {
+    char *buf;
+    size_t bufsize;
+    size_t len;
+};
+
+static int
+_jsmnf_write_buf_sink(void *ctx, const char data[], size_t len)
+{
+    struct _jsmnf_write_buf *out = ctx;
+
+    if (len > out->bufsize - out->len) return JSMN_ERROR_NOMEM;
+    memcpy(out->buf + out->len, data, len);
+    out->len += len;
+    return 0;
+}
+
+JSMN_API long
+jsmnf_write_buf(const struct jsmnf_pair *pair,
+                const char js[],
+                unsigned flags,
+                char buf[],
+                size_t bufsize)
+{
+    struct _jsmnf_write_buf out;
+
+    out.buf = buf;
+    out.bufsize = bufsize;
+    out.len = 0;
+    return jsmnf_write(pair, js, flags, &_jsmnf_write_buf_sink, &out);
+}
+
+JSMN_API void
+jsmnf_writer_init(struct jsmnf_writer *writer, char buf[], size_t size)
+{
+    writer->buf = buf;
+    writer->size = size;
+    writer->len = 0;
+    writer->allocator = NULL;
+    writer->error = 0;
+    writer->depth = 0;
+    writer->comma = 0;
+}
+
+JSMN_API void
+jsmnf_writer_init_auto(struct jsmnf_writer *writer,
+                       const struct jsmnf_allocator *allocator)
+{
+    jsmnf_writer_init(writer, NULL, 0);
+    writer->allocator = _JSMNF_ALLOCATOR(allocator);
+}
+
+JSMN_API void
+jsmnf_writer_free(struct jsmnf_writer *writer)
+{
+    const struct jsmnf_allocator *allocator = writer->allocator;
+
+    if (!allocator) return;
+    allocator->release(allocator->ctx, writer->buf);
+    jsmnf_writer_init_auto(writer, allocator);
+}
+
+/* make room for `len` more bytes, or keep the error */
+static int
+_jsmnf_writer_reserve(struct jsmnf_writer *writer, size_t len)
+{
+    const struct jsmnf_allocator *allocator = writer->allocator;
+    size_t size = writer->size ? writer->size : 64;
+    void *tmp;
+
+    if (writer->error) return writer->error;
+    if (len <= writer->size - writer->len) return 0;
+
+    if (!allocator || len > (size_t)-1 - writer->len)
+        return writer->error = JSMN_ERROR_NOMEM;
+    while (size - writer->len < len) {
+        if (size > (size_t)-1 / 2) return writer->error = JSMN_ERROR_NOMEM;
+        size *= 2;
+    }
+    if (!(tmp = allocator->resize(allocator->ctx, writer->buf, writer->size,
+                                  size)))
+    {
+        return writer->error = JSMN_ERROR_NOMEM;
+    }
+    writer->buf = tmp;
+    writer->size = size;
+    return 0;
+}
+
+static int
+_jsmnf_writer_append(struct jsmnf_writer *writer,
+                     const char data[],
+                     size_t len)
+{
+    int ret;
+
+    if ((ret = _jsmnf_writer_reserve(writer, len)) < 0) return ret;
+    memcpy(writer->buf + writer->len, data, len);
+    writer->len += len;
+    return 0;
+}
+
+/* a comma is due before anything but the first value of a container */
+static int
+_jsmnf_writer_value(struct jsmnf_writer *writer,
+                    const char data[],
+                    size_t len)
+{
+    int ret;
+
+    if (writer->comma && (ret = _jsmnf_writer_append(writer, ",", 1)) < 0)
+        return ret;
+    if ((ret = _jsmnf_writer_append(writer, data, len)) < 0) return ret;
+    writer->comma = 1;
+    return 0;
+}
+
+/* first byte from `p` that is either a quote, a backslash or a control
+ *      character, the inverse of _jsmnf_unescape_run() */
+static const char *
+_jsmnf_escape_run(const char *p, const char *end)
+{
+    size_t w[2];
+
+    while ((size_t)(end - p) >= sizeof w) {
+        memcpy(w, p, sizeof w);
+        if (_JSMNF_SWAR_HAS(w[0], '"') || _JSMNF_SWAR_HAS(w[0], '\\')
+            || _JSMNF_SWAR_HAS_LESS(w[0], 0x20) || _JSMNF_SWAR_HAS(w[1], '"')
+            || _JSMNF_SWAR_HAS(w[1], '\\') || _JSMNF_SWAR_HAS_LESS(w[1], 0x20))
+        {
+            break;
+        }
+        p += sizeof w;
+    }
+    while (p < end && *p != '"' && *p != '\\' && (unsigned char)*p >= 0x20)
+        ++p;
+    return p;
+}
+
+static int
+_jsmnf_writer_quoted(struct jsmnf_writer *writer,
+                     const char str[],
+                     size_t len)
+{
+    static const char hex[] = "0123456789abcdef";
+    const char *p = str, *const end = str + len;
+    int ret;
+
+    if (writer->comma && (ret = _jsmnf_writer_append(writer, ",", 1)) < 0)
+        return ret;
+    if ((ret = _jsmnf_writer_append(writer, "\"", 1)) < 0) return ret;
+    while (p < end) {
+        const char *run = _jsmnf_escape_run(p, end);
+        char esc[6] = { '\\', 0, '0', '0', 0, 0 };
+        size_t esc_len = 2;
+
+        /* bulk copy bytes that need no escaping */
+        if (run != p
+            && (ret = _jsmnf_writer_append(writer, p, (size_t)(run - p))) < 0)
+        {
+            return ret;
+        }
+        if ((p = run) == end) break;
+
+        switch (*p) {
+        case '"':
+        case '\\':
+            esc[1] = *p;
+            break;
+        case '\b':
+            esc[1] = 'b';
+            break;
+        case '\f':
+            esc[1] = 'f';
+            break;
+        case '\n':
+            esc[1] = 'n';
+            break;
+        case '\r':
+            esc[1] = 'r';
+            break;
+        case '\t':
+            esc[1] = 't';
+            break;
+        default:
+            esc[1] = 'u';
+            esc[4] = hex[(unsigned char)*p >> 4];
+            esc[5] = hex[(unsigned char)*p & 0xF];
+            esc_len = 6;
+            break;
+        }
+        if ((ret = _jsmnf_writer_append(writer, esc, esc_len)) < 0)
+            return ret;
+        ++p;
+    }
+    return _jsmnf_writer_append(writer, "\"", 1);
+}
+
+static int
+_jsmnf_writer_begin(struct jsmnf_writer *writer, char c)
+{
+    const unsigned depth = writer->depth;
+    const unsigned char bit = (unsigned char)(1u << (depth % CHAR_BIT));
+    int ret;
+
+    if (writer->error) return writer->error;
+    if (depth >= JSMNF_WRITER_MAX_DEPTH)
+        return writer->error = JSMN_ERROR_NOMEM;
+    if ((ret = _jsmnf_writer_value(writer, &c, 1)) < 0) return ret;
+    if ('{' == c)
+        writer->objects[depth / CHAR_BIT] |= bit;
+    else
+        writer->objects[depth / CHAR_BIT] &= (unsigned char)~bit;
+    ++writer->depth;
+    writer->comma = 0;
+    return 0;
+}
+
+static int
+_jsmnf_writer_end(struct jsmnf_writer *writer, char c)
+{
+    const unsigned depth = writer->depth - 1;
+    int ret;
+
+    if (writer->error) return writer->error;
+    /* the closing type must match the innermost container */
+    if (!writer->depth
+        || ('}' == c)
+               != ((writer->objects[depth / CHAR_BIT] >> (depth % CHAR_BIT))
+                   & 1))
+    {
+        return writer->error = JSMN_ERROR_INVAL;
+    }
+    if ((ret = _jsmnf_writer_append(writer, &c, 1)) < 0) return ret;
+    --writer->depth;
+    writer->comma = 1;
+    return 0;
+}
+
+JSMN_API int
+jsmnf_writer_begin_object(struct jsmnf_writer *writer)
+{
+    return _jsmnf_writer_begin(writer, '{');
+}
+
+JSMN_API int
+jsmnf_writer_end_object(struct jsmnf_writer *writer)
+{
+    return _jsmnf_writer_end(writer, '}');
+}
+
+JSMN_API int
+jsmnf_writer_begin_array(struct jsmnf_writer *writer)
+{
+    return _jsmnf_writer_begin(writer, '[');
+}
+
+JSMN_API int
+jsmnf_writer_end_array(struct jsmnf_writer *writer)
+{
+    return _jsmnf_writer_end(writer, ']');
+}
+
+JSMN_API int
+jsmnf_writer_key(struct jsmnf_writer *writer, const char key[], size_t len)
+{
+    int ret;
+
+    if ((ret = _jsmnf_writer_quoted(writer, key, len)) < 0
+        || (ret = _jsmnf_writer_append(writer, ":", 1)) < 0)
+    {
+        return ret;
+    }
+    writer->comma = 0;
+    return 0;
+}
+
+JSMN_API int
+jsmnf_writer_string(struct jsmnf_writer *writer, const char str[], size_t len)
+{
+    int ret;
+
+    if ((ret = _jsmnf_writer_quoted(writer, str, len)) < 0) return ret;
+    writer->comma = 1;
+    return 0;
+}
+
+JSMN_API int
+jsmnf_writer_u64(struct jsmnf_writer *writer, uint64_t value)
+{
+    char buf[20];
+
+    return _jsmnf_writer_value(writer, buf, _jsmnf_u64_to_str(value, buf));
+}
+
+JSMN_API int
+jsmnf_writer_i64(struct jsmnf_writer *writer, int64_t value)
+{
+    char buf[21];
+
+    if (value >= 0)
+        return jsmnf_writer_u64(writer, (uint64_t)value);
+    /* negated as unsigned, so that INT64_MIN doesn't overflow */
+    buf[0] = '-';
+    return _jsmnf_writer_value(
+        writer, buf, 1 + _jsmnf_u64_to_str(0 - (uint64_t)value, buf + 1));
+}
+
+/* turn the locale's decimal point written by printf() back into `.` */
+static int
+_jsmnf_c_decimal_point(char buf[], int len)
+{
+    int i, j;
+
+    for (i = j = 0; i < len; ++i) {
+        const char c = buf[i];
+
+        if ((c >= '0' && c <= '9') || c == '-' || c == '+' || c == 'e')
+            buf[j++] = c;
+        else if (!j || buf[j - 1] != '.') /* may span several bytes */
+            buf[j++] = '.';
+    }
+    return j;
+}
+
+JSMN_API int
+jsmnf_writer_double(struct jsmnf_writer *writer, double value)
+{
+    char buf[32];
+    int precision, len = 0;
+
+    /* NaN compares unequal to itself, and infinities don't cancel out */
+    if (value != value || value - value != 0)
+        return writer->error ? writer->error
+                             : (writer->error = JSMN_ERROR_INVAL);
+
+    /* the value's shortest representation is found by rounding it to 15
+     *      significant digits whenever it has no more than that, past
+     *      that 16 may do, and 17 always round-trip, subnormals have less
+     *      precision so they're tried from a single digit up */
+    precision = (value < DBL_MIN && value > -DBL_MIN) ? 1 : 15;
+    for (; precision <= 17; ++precision) {
+        len = _jsmnf_c_decimal_point(buf,
+                                     sprintf(buf, "%.*g", precision, value));
+        if (precision == 17 || _jsmnf_strtod(buf, (size_t)len) == value)
+            break;
+    }
+    return _jsmnf_writer_value(writer, buf, (size_t)len);
+}
+
+JSMN_API int
+jsmnf_writer_bool(struct jsmnf_writer *writer, int value)
+{
+    return value ? _jsmnf_writer_value(writer, "true", 4)
+                 : _jsmnf_writer_value(writer, "false", 5);
+}
+
+JSMN_API int
+jsmnf_writer_null(struct jsmnf_writer *writer)
+{
+    return _jsmnf_writer_value(writer, "null", 4);
+}
+
+JSMN_API long
+jsmnf_writer_finish(const struct jsmnf_writer *writer)
+{
+    if (writer->error) return writer->error;
+    if (writer->depth) return JSMN_ERROR_PART;
+    return (long)writer->len;
+}
+
+enum _jsmnf_edit_type {
+    _JSMNF_EDIT_NONE = 0,
+    /** replace the value of `member` */
+    _JSMNF_EDIT_SET,
+    /** delete `member` */
+    _JSMNF_EDIT_DELETE,
+    /** add the object member `key` */
+    _JSMNF_EDIT_INSERT,
+    /** add an array element */
+    _JSMNF_EDIT_APPEND
+};
+
+JSMN_API const struct jsmnf_pair *
+jsmnf_scalar_init(struct jsmnf_scalar *scalar, const char text[], size_t len)
+{
+    struct _jsmnf_pair_mut *pair = (struct _jsmnf_pair_mut *)&scalar->pair;
+    jsmn_parser parser;
+    double number;
+
+    if (!len || len > INT_MAX) return NULL;
+
+    jsmn_init(&parser);
+    if ('"' == *text) {
+        if (jsmn_parse(&parser, text, len, &scalar->tok, 1) != 1
+            || (size_t)scalar->tok.end + 1 != len)
+        {
+            return NULL;
+        }
+    }
+    else {
+        /* strict mode jsmn won't end the input on a primitive */
+        if (!(4 == len && 0 == memcmp(text, "true", 4))
+            && !(5 == len && 0 == memcmp(text, "false", 5))
+            && !(4 == len && 0 == memcmp(text, "null", 4))
+            && JSMN_ERROR_INVAL == _jsmnf_parse_double(text, len, &number))
+        {
+            return NULL;
+        }
+        memset(&scalar->tok, 0, sizeof scalar->tok);
+        scalar->tok.type = JSMN_PRIMITIVE;
+        scalar->tok.end = (int)len;
+#ifdef JSMN_PARENT_LINKS
+        scalar->tok.parent = -1;
+#endif
+    }
+    memset(pair, 0, sizeof *pair);
+    pair->v = &scalar->tok;
+    if (JSMN_STRING == scalar->tok.type
+        && _jsmnf_has_escapes(text, &scalar->tok))
+    {
+        pair->flags |= JSMNF_VALUE_ESCAPED;
+    }
+    return &scalar->pair;
+}
+
+JSMN_API void
+jsmnf_overlay_init(struct jsmnf_overlay *overlay,
+                   const struct jsmnf_pair *root,
+                   const char js[],
+                   struct jsmnf_edit edits[],
+                   size_t max_edits)
+{
+    overlay->root = root;
+    overlay->js = js;
+    overlay->edits = edits;
+    overlay->num_edits = 0;
+    overlay->max_edits = max_edits;
+}
+
+/* the edit replacing or deleting `member`, there's at most one */
+static struct jsmnf_edit *
+_jsmnf_overlay_edit_of(const struct jsmnf_overlay *overlay,
+                       const struct jsmnf_pair *member)
+{
+    size_t i;
+
+    for (i = 0; i < overlay->num_edits; ++i) {
+        struct jsmnf_edit *edit = overlay->edits + i;
+
+        if (edit->member == member
+            && (_JSMNF_EDIT_SET == edit->type
+                || _JSMNF_EDIT_DELETE == edit->type))
+        {
+            return edit;
+        }
+    }
+    return NULL;
+}
+
+/* resolve `key` as seen through the overlay, either to a member of the
+ *      document or to the edit providing its value */
+static int
+_jsmnf_overlay_lookup(const struct jsmnf_overlay *overlay,
+                      const struct jsmnf_pair *container,
+                      const char key[],
+                      size_t len,
+                      const struct jsmnf_pair **p_member,
+                      struct jsmnf_edit **p_edit)
+{
+    size_t i;
+
+    *p_member = NULL;
+    *p_edit = NULL;
+    if (!container || !container->v) return JSMN_ERROR_INVAL;
+
+    if (JSMN_OBJECT == container->v->type) {
+        for (i = overlay->num_edits; i-- > 0;) {
+            struct jsmnf_edit *edit = overlay->edits + i;
+
+            if (_JSMNF_EDIT_INSERT == edit->type
+                && edit->container == container && edit->key_len == len
+                && 0 == memcmp(edit->key, key, len))
+            {
+                *p_edit = edit;
+                return 0;
+            }
+        }
+        if (!(*p_member = jsmnf_find(container, key, len)))
+            return JSMN_ERROR_INVAL;
+        *p_edit = _jsmnf_overlay_edit_of(overlay, *p_member);
+        if (*p_edit && _JSMNF_EDIT_DELETE == (*p_edit)->type)
+            return JSMN_ERROR_INVAL;
+        return 0;
+    }
+    if (JSMN_ARRAY == container->v->type) {
+        size_t index = 0;
+
+        if (!len) return JSMN_ERROR_INVAL;
+        for (i = 0; i < len; ++i) {
+            if (key[i] < '0' || key[i] > '9' || index > ((size_t)-1 - 9) / 10)
+                return JSMN_ERROR_INVAL;
+            index = index * 10 + (size_t)(key[i] - '0');
+        }
+        /* deleted elements shift the ones after them */
+        for (i = 0; i < container->length; ++i) {
+            const struct jsmnf_pair *member = container->fields + i;
+            struct jsmnf_edit *edit = _jsmnf_overlay_edit_of(overlay, member);
+
+            if (edit && _JSMNF_EDIT_DELETE == edit->type) continue;
+            if (!index--) {
+                *p_member = member;
+                *p_edit = edit;
+                return 0;
+            }
+        }
+        for (i = 0; i < overlay->num_edits; ++i) {
+            struct jsmnf_edit *edit = overlay->edits + i;
+
+            if (_JSMNF_EDIT_APPEND == edit->type
+                && edit->container == container && !index--)
+            {
+                *p_edit = edit;
+                return 0;
+            }
+        }
+    }
+    return JSMN_ERROR_INVAL;
+}
+
+static struct jsmnf_edit *
+_jsmnf_overlay_push(struct jsmnf_overlay *overlay,
+                    enum _jsmnf_edit_type type,
+                    const struct jsmnf_pair *container,
+                    const struct jsmnf_pair *value,
+                    const char value_js[])
+{
+    struct jsmnf_edit *edit;
+
+    if (overlay->num_edits >= overlay->max_edits) return NULL;
+
+    edit = overlay->edits + overlay->num_edits++;
+    edit->type = type;
+    edit->container = container;
+    edit->member = NULL;
+    edit->key = NULL;
+    edit->key_len = 0;
+    edit->value = value;
+    edit->value_js = value_js;
+    return edit;
+}
+
+JSMN_API int
+jsmnf_overlay_set(struct jsmnf_overlay *overlay,
+                  const struct jsmnf_pair *container,
+                  const char key[],
+                  size_t len,
+                  const struct jsmnf_pair *value,
+                  const char value_js[])
+{
+    const struct jsmnf_pair *member;
+    struct jsmnf_edit *edit;
+    int ret;
+
+    if (!value || !value->v) return JSMN_ERROR_INVAL;
+    if ((ret = _jsmnf_overlay_lookup(overlay, container, key, len, &member,
+                                     &edit))
+        < 0)
+    {
+        return ret;
+    }
+    /* values already coming from an edit are replaced in that edit */
+    if (!edit
+        && !(edit = _jsmnf_overlay_push(overlay, _JSMNF_EDIT_SET, container,
+                                        NULL, NULL)))
+    {
+        return JSMN_ERROR_NOMEM;
+    }
+    if (member) edit->member = member;
+    edit->value = value;
+    edit->value_js = value_js;
+    return 0;
+}
+
+JSMN_API int
+jsmnf_overlay_insert(struct jsmnf_overlay *overlay,
+                     const struct jsmnf_pair *object,
+                     const char key[],
+                     size_t len,
+                     const struct jsmnf_pair *value,
+                     const char value_js[])
+{
+    const struct jsmnf_pair *member;
+    struct jsmnf_edit *edit;
+
+    if (!object || !object->v || JSMN_OBJECT != object->v->type || !value
+        || !value->v)
+    {
+        return JSMN_ERROR_INVAL;
+    }
+    if (0 == _jsmnf_overlay_lookup(overlay, object, key, len, &member, &edit))
+        return jsmnf_overlay_set(overlay, object, key, len, value, value_js);
+
+    if (!(edit = _jsmnf_overlay_push(overlay, _JSMNF_EDIT_INSERT, object,
+                                     value, value_js)))
+    {
+        return JSMN_ERROR_NOMEM;
+    }
+    edit->key = key;
+    edit->key_len = len;
+    return 0;
+}
+
+JSMN_API int
+jsmnf_overlay_delete(struct jsmnf_overlay *overlay,
+                     const struct jsmnf_pair *container,
+                     const char key[],
+                     size_t len)
+{
+    const struct jsmnf_pair *member;
+    struct jsmnf_edit *edit;
+    int ret;
+
+    if ((ret = _jsmnf_overlay_lookup(overlay, container, key, len, &member,
+                                     &edit))
+        < 0)
+    {
+        return ret;
+    }
+    if (!edit) {
+        if (!(edit = _jsmnf_overlay_push(overlay, _JSMNF_EDIT_DELETE,
+                                         container, NULL, NULL)))
+        {
+            return JSMN_ERROR_NOMEM;
+        }
+        edit->member = member;
+    }
+    /* added members are simply dropped */
+    edit->type = member ? _JSMNF_EDIT_DELETE : _JSMNF_EDIT_NONE;
+    edit->value = NULL;
+    edit->value_js = NULL;
+    return 0;
+}
+
+JSMN_API int
+jsmnf_overlay_append(struct jsmnf_overlay *overlay,
+                     const struct jsmnf_pair *array,
+                     const struct jsmnf_pair *value,
+                     const char value_js[])
+{
+    if (!array || !array->v || JSMN_ARRAY != array->v->type || !value
+        || !value->v)
+    {
+        return JSMN_ERROR_INVAL;
+    }
+    if (!_jsmnf_overlay_push(overlay, _JSMNF_EDIT_APPEND, array, value,
+                             value_js))
+    {
+        return JSMN_ERROR_NOMEM;
+    }
+    return 0;
+}
+
+JSMN_API const struct jsmnf_pair *
+jsmnf_overlay_find(const struct jsmnf_overlay *overlay,
+                   const struct jsmnf_pair *head,
+                   const char key[],
+                   size_t length,
+                   const char **p_js)
+{
+    const struct jsmnf_pair *member;
+    struct jsmnf_edit *edit;
+
+    if (_jsmnf_overlay_lookup(overlay, head, key, length, &member, &edit) < 0)
+        return NULL;
+    if (!edit) return member;
+    *p_js = edit->value_js;
+    return edit->value;
+}
+
+/* whether an edit applies within the span of `pair` */
+static int
+_jsmnf_overlay_is_dirty(const struct jsmnf_overlay *overlay,
+                        const struct jsmnf_pair *pair)
+{
+    size_t i;
+
+    for (i = 0; i < overlay->num_edits; ++i) {
+        const struct jsmnf_edit *edit = overlay->edits + i;
+
+        if (_JSMNF_EDIT_NONE != edit->type
+            && edit->container->v->start >= pair->v->start
+            && edit->container->v->start < pair->v->end)
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* values of the edits are written as their raw tokens */
+static int
+_jsmnf_overlay_write_value(struct _jsmnf_serializer *ser,
+                           const struct jsmnf_edit *edit)
+{
+    const struct jsmntok *v = edit->value->v;
+    const int quote = JSMN_STRING == v->type;
+
+    return _jsmnf_serializer_literal(ser, edit->value_js + v->start - quote,
+                                     (size_t)(v->end - v->start + 2 * quote));
+}
+
+static int
+_jsmnf_overlay_write_pair(struct _jsmnf_serializer *ser,
+                          const struct jsmnf_overlay *overlay,
+                          const struct jsmnf_pair *pair)
+{
+    const struct jsmntok *v = pair->v;
+    int first = 1, ret;
+    size_t i;
+
+    if (!v) /* empty array slot of a projection */
+        return _jsmnf_serializer_literal(ser, "null", 4);
+    if ((JSMN_OBJECT != v->type && JSMN_ARRAY != v->type)
+        || !_jsmnf_overlay_is_dirty(overlay, pair))
+    {
+        return _jsmnf_serializer_token(ser, v);
+    }
+
+    if ((ret = _jsmnf_serializer_span(ser, (size_t)v->start,
+                                      (size_t)v->start + 1))
+        < 0)
+    {
+        return ret;
+    }
+    for (i = 0; i < pair->length; ++i) {
+        const struct jsmnf_pair *field = pair->fields + i;
+        const struct jsmnf_edit *edit = _jsmnf_overlay_edit_of(overlay, field);
+
+        if (edit && _JSMNF_EDIT_DELETE == edit->type) continue;
+        if (!first && (ret = _jsmnf_serializer_char(ser, ',')) < 0)
+            return ret;
+        if (JSMN_OBJECT == v->type
+            && ((ret = _jsmnf_serializer_token(ser, field->k)) < 0
+                || (ret = _jsmnf_serializer_char(ser, ':')) < 0))
+        {
+            return ret;
+        }
+        if ((ret = edit ? _jsmnf_overlay_write_value(ser, edit)
+                        : _jsmnf_overlay_write_pair(ser, overlay, field))
+            < 0)
+        {
+            return ret;
+        }
+        if (edit && field->v) {
+            /* resume past the replaced value, so that the separator and
+             *      whitespace that follow it are kept */
+            ser->run_start = ser->run_end =
+                (size_t)field->v->end + (JSMN_STRING == field->v->type);
+        }
+        first = 0;
+    }
+    for (i = 0; i < overlay->num_edits; ++i) {
+        const struct jsmnf_edit *edit = overlay->edits + i;
+
+        if (edit->container != pair
+            || (_JSMNF_EDIT_INSERT != edit->type
+                && _JSMNF_EDIT_APPEND != edit->type))
+        {
+            continue;
+        }
+        if (!first && (ret = _jsmnf_serializer_char(ser, ',')) < 0)
+            return ret;
+        if (_JSMNF_EDIT_INSERT == edit->type
+            && ((ret = _jsmnf_serializer_literal(ser, "\"", 1)) < 0
+                || (ret = _jsmnf_serializer_put(ser, edit->key,
+                                                edit->key_len))
+                       < 0
+                || (ret = _jsmnf_serializer_put(ser, "\":", 2)) < 0))
+        {
+            return ret;
+        }
+        if ((ret = _jsmnf_overlay_write_value(ser, edit)) < 0) return ret;
+        first = 0;
+    }
+    return _jsmnf_serializer_span(ser, (size_t)v->end - 1, (size_t)v->end);
+}
+
+JSMN_API long
+jsmnf_overlay_write(const struct jsmnf_overlay *overlay,
+                    jsmnf_sink sink,
+                    void *ctx)
+{
+    struct _jsmnf_serializer ser;
+    int ret;
+
+    if (!overlay->root || !overlay->root->v) return JSMN_ERROR_INVAL;
+
+    _jsmnf_serializer_init(&ser, overlay->root, overlay->js, 0, sink, ctx);
+    ser.splice = 1;
+    if ((ret = _jsmnf_overlay_write_pair(&ser, overlay, overlay->root)) < 0)
+        return ret;
+    return _jsmnf_serializer_finish(&ser);
+}
+
+JSMN_API long
+jsmnf_overlay_write_buf(const struct jsmnf_overlay *overlay,
+                        char buf[],
+                        size_t bufsize)
+{
+    struct _jsmnf_write_buf out;
+
+    out.buf = buf;
+    out.bufsize = bufsize;
+    out.len = 0;
+    return jsmnf_overlay_write(overlay, &_jsmnf_write_buf_sink, &out);
+}
+
+/* whether both values have the same type and raw bytes */
+static int
+_jsmnf_diff_same_span(const struct jsmntok *a,
+                      const char a_js[],
+                      const struct jsmntok *b,
+                      const char b_js[])
+{
+    if (a->type != b->type || a->end - a->start != b->end - b->start)
+        return 0;
+    /* same span of the same JSON string */
+    if (a_js == b_js && a->start == b->start) return 1;
+    return 0 == memcmp(a_js + a->start, b_js + b->start,
+                       (size_t)(a->end - a->start));
+}
+
+/* keys up to this size are unescaped on the stack for lookups */
+#define _JSMNF_DIFF_STACK 256
+
+/* unescape `len` bytes of `key` to `stack` if they fit, or else to a buffer
+ *      the caller releases with JSMNF_FREE() if it isn't `stack` */
+static long
+_jsmnf_diff_unescape(const char *key,
+                     const size_t len,
+                     char stack[_JSMNF_DIFF_STACK],
+                     char **p_buf)
+{
+    long ret;
+
+    *p_buf = stack;
+    /* an unescaped key is never longer than its escaped form */
+    if (len > _JSMNF_DIFF_STACK && !(*p_buf = JSMNF_MALLOC(len))) {
+        *p_buf = stack;
+        return JSMN_ERROR_NOMEM;
+    }
+    if ((ret = jsmnf_unescape(*p_buf, len, key, len)) < 0
+        && *p_buf != stack)
+    {
+        JSMNF_FREE(*p_buf);
+        *p_buf = stack;
+    }
+    return ret;
+}
+
+/* look `field` of one document up in `object` of the other one by the
+ *      unescaped form of their keys, `*p_found` is set to NULL if missing */
+static int
+_jsmnf_diff_find(const struct jsmnf_pair *object,
+                 const char object_js[],
+                 const struct jsmnf_pair *field,
+                 const char js[],
+                 const struct jsmnf_pair **p_found)
+{
+    const char *key = js + field->k->start;
+    size_t len = (size_t)(field->k->end - field->k->start);
+    char stack[_JSMNF_DIFF_STACK], member_stack[_JSMNF_DIFF_STACK];
+    char *buf = stack, *member_buf;
+    int ret = 0;
+    long n;
+    size_t i;
+
+    if ((*p_found = jsmnf_find(object, key, len))) return 0;
+    if (field->flags & JSMNF_KEY_ESCAPED) {
+        if ((n = _jsmnf_diff_unescape(key, len, stack, &buf)) >= 0) {
+            key = buf;
+            len = (size_t)n;
+            /* `object` may have been loaded with a key arena, see
+             *      jsmnf_init_keys() */
+            *p_found = jsmnf_find(object, key, len);
+        }
+        else if (JSMN_ERROR_NOMEM == n) {
+            return JSMN_ERROR_NOMEM;
+        }
+    }
+    /* or else its escaped keys are stored as is, the last duplicate wins as
+     *      with jsmnf_find() */
+    for (i = object->length; !*p_found && i-- > 0;) {
+        const struct jsmnf_pair *member = object->fields + i;
+
+        if (!member->v || !(member->flags & JSMNF_KEY_ESCAPED)) continue;
+        n = _jsmnf_diff_unescape(object_js + member->k->start,
+                                 (size_t)(member->k->end - member->k->start),
+                                 member_stack, &member_buf);
+        if (JSMN_ERROR_NOMEM == n) {
+            ret = JSMN_ERROR_NOMEM;
             break;
-        iter = found;
+        }
+        if (n == (long)len && 0 == memcmp(member_buf, key, len))
+            *p_found = member;
+        if (member_buf != member_stack) JSMNF_FREE(member_buf);
     }
-    return found;
+    if (buf != stack) JSMNF_FREE(buf);
+    return ret;
 }
 
-#define RECALLOC_OR_ERROR(ptr, prev_size)                                     \
-    do {                                                                      \
-        const unsigned new_size = *(prev_size) * 2;                           \
-        void *tmp = realloc((ptr), new_size * sizeof *(ptr));                 \
-        if (!tmp) return JSMN_ERROR_NOMEM;                                    \
-        (ptr) = tmp;                                                          \
-        memset((ptr) + *(prev_size), 0,                                       \
-               (new_size - *(prev_size)) * sizeof *(ptr));                    \
-        *(prev_size) = new_size;                                              \
-    } while (0)
+static int
+_jsmnf_diff_pair(const struct jsmnf_pair *a,
+                 const char a_js[],
+                 const struct jsmnf_pair *b,
+                 const char b_js[],
+                 const struct jsmnf_path *path,
+                 jsmnf_diff_cb callback,
+                 void *ctx)
+{
+    struct jsmnf_path step;
+    size_t i;
+    int ret;
+
+    if (!a->v || !b->v) { /* empty array slots of a projection */
+        if (a->v == b->v) return 0;
+        return callback(ctx, JSMNF_DIFF_CHANGE, path, a, b);
+    }
+    if (_jsmnf_diff_same_span(a->v, a_js, b->v, b_js)) return 0;
+    if (a->v->type != b->v->type
+        || (JSMN_OBJECT != a->v->type && JSMN_ARRAY != a->v->type))
+    {
+        return callback(ctx, JSMNF_DIFF_CHANGE, path, a, b);
+    }
+
+    step.parent = path;
+    step.key = NULL;
+    step.key_len = 0;
+    if (JSMN_ARRAY == a->v->type) {
+        for (i = 0; i < a->length; ++i) {
+            step.index = i;
+            ret = (i < b->length)
+                      ? _jsmnf_diff_pair(a->fields + i, a_js, b->fields + i,
+                                         b_js, &step, callback, ctx)
+                      : callback(ctx, JSMNF_DIFF_REMOVE, &step,
+                                 a->fields + i, NULL);
+            if (ret < 0) return ret;
+        }
+        for (; i < b->length; ++i) {
+            step.index = i;
+            if ((ret = callback(ctx, JSMNF_DIFF_ADD, &step, NULL,
+                                b->fields + i))
+                < 0)
+            {
+                return ret;
+            }
+        }
+        return 0;
+    }
+
+    step.index = 0;
+    for (i = 0; i < a->length; ++i) {
+        const struct jsmnf_pair *field = a->fields + i, *match;
+
+        if ((ret = _jsmnf_diff_find(b, b_js, field, a_js, &match)) < 0)
+            return ret;
+        step.key = a_js + field->k->start;
+        step.key_len = (size_t)(field->k->end - field->k->start);
+        ret = match ? _jsmnf_diff_pair(field, a_js, match, b_js, &step,
+                                       callback, ctx)
+                    : callback(ctx, JSMNF_DIFF_REMOVE, &step, field, NULL);
+        if (ret < 0) return ret;
+    }
+    for (i = 0; i < b->length; ++i) {
+        const struct jsmnf_pair *field = b->fields + i, *match;
+
+        if ((ret = _jsmnf_diff_find(a, a_js, field, b_js, &match)) < 0)
+            return ret;
+        if (match) continue;
+        step.key = b_js + field->k->start;
+        step.key_len = (size_t)(field->k->end - field->k->start);
+        if ((ret = callback(ctx, JSMNF_DIFF_ADD, &step, NULL, field)) < 0)
+            return ret;
+    }
+    return 0;
+}
+
+JSMN_API int
+jsmnf_diff(const struct jsmnf_pair *a,
+           const char a_js[],
+           const struct jsmnf_pair *b,
+           const char b_js[],
+           jsmnf_diff_cb callback,
+           void *ctx)
+{
+    if (!a || !b) return JSMN_ERROR_INVAL;
+    return _jsmnf_diff_pair(a, a_js, b, b_js, NULL, callback, ctx);
+}
+
+/* append `path` to `buf`, its root-most step first */
+static int
+_jsmnf_path_format(const struct jsmnf_path *path,
+                   char buf[],
+                   size_t bufsize,
+                   size_t *p_len)
+{
+    char index[20];
+    const char *str;
+    size_t len;
+    int ret;
+
+    if (!path) {
+        if (bufsize < 2) return JSMN_ERROR_NOMEM;
+        buf[0] = '$';
+        *p_len = 1;
+        return 0;
+    }
+    if ((ret = _jsmnf_path_format(path->parent, buf, bufsize, p_len)) < 0)
+        return ret;
+
+    if (path->key) {
+        str = path->key;
+        len = path->key_len;
+    }
+    else {
+        str = index;
+        len = _jsmnf_u64_to_str((uint64_t)path->index, index);
+    }
+    /* separator, closing bracket and NUL-terminator */
+    if (bufsize - *p_len < len + 2 + !path->key) return JSMN_ERROR_NOMEM;
+    buf[(*p_len)++] = path->key ? '.' : '[';
+    memcpy(buf + *p_len, str, len);
+    *p_len += len;
+    if (!path->key) buf[(*p_len)++] = ']';
+    return 0;
+}
+
+JSMN_API long
+jsmnf_path_format(const struct jsmnf_path *path,
+                  char buf[],
+                  size_t bufsize)
+{
+    size_t len = 0;
+    int ret;
+
+    if ((ret = _jsmnf_path_format(path, buf, bufsize, &len)) < 0) return ret;
+    buf[len] = '\0';
+    return (long)len;
+}
+
+#define _JSMNF_HASH_K1   UINT64_C(0xBF58476D1CE4E5B9)
+#define _JSMNF_HASH_K2   UINT64_C(0x94D049BB133111EB)
+#define _JSMNF_HASH_SEED UINT64_C(0x9E3779B97F4A7C15)
+
+/* splitmix64 finalizer */
+static uint64_t
+_jsmnf_hash_mix(uint64_t h)
+{
+    h = (h ^ (h >> 30)) * _JSMNF_HASH_K1;
+    h = (h ^ (h >> 27)) * _JSMNF_HASH_K2;
+    return h ^ (h >> 31);
+}
+
+static uint64_t
+_jsmnf_hash_bytes(uint64_t h, const char bytes[], size_t len)
+{
+    const size_t total = len;
+    uint64_t w;
+
+    for (; len >= sizeof w; bytes += sizeof w, len -= sizeof w) {
+        memcpy(&w, bytes, sizeof w);
+        h = _jsmnf_hash_mix(h ^ w);
+    }
+    if (len) {
+        w = 0;
+        memcpy(&w, bytes, len);
+        h = _jsmnf_hash_mix(h ^ w);
+    }
+    return _jsmnf_hash_mix(h ^ (uint64_t)total);
+}
+
+/* _jsmnf_hash_bytes() of bytes fed in pieces */
+struct _jsmnf_hash_stream {
+    uint64_t h;
+    char word[8];
+    size_t fill;
+    size_t total;
+};
+
+static void
+_jsmnf_hash_feed(struct _jsmnf_hash_stream *s, const char bytes[], size_t len)
+{
+    uint64_t w;
 
-JSMN_API long
-jsmn_parse_auto(struct jsmn_parser *parser,
-                const char js[],
-                const size_t len,
-                struct jsmntok **p_tokens,
-                unsigned *num_tokens)
+    s->total += len;
+    while (len--) {
+        s->word[s->fill++] = *bytes++;
+        if (s->fill == sizeof w) {
+            memcpy(&w, s->word, sizeof w);
+            s->h = _jsmnf_hash_mix(s->h ^ w);
+            s->fill = 0;
+        }
+    }
+}
+
+/* hash the unescaped form of a string's raw bytes one escape sequence at a
+ *      time, or its raw bytes if they can't be unescaped */
+static uint64_t
+_jsmnf_hash_unescaped(uint64_t seed, const char src[], size_t len)
 {
-    int ret;
+    const char *p = src, *const end = src + len;
+    struct _jsmnf_hash_stream s;
+    char buf[8];
+    uint64_t w;
 
-    if (NULL == *p_tokens || 0 == *num_tokens) {
-        *p_tokens = calloc(1, sizeof **p_tokens);
-        *num_tokens = 1;
+    s.h = seed;
+    s.fill = s.total = 0;
+    while (p < end) {
+        const char *run = _jsmnf_unescape_run(p, end);
+        size_t n = 2;
+        unsigned hex;
+        long ret;
+
+        if (run != p) {
+            _jsmnf_hash_feed(&s, p, (size_t)(run - p));
+            p = run;
+            continue;
+        }
+        if (end - p < 2) return _jsmnf_hash_bytes(seed, src, len);
+        /* surrogate pairs are unescaped as a whole */
+        if ('u' == p[1]) {
+            n = 4 == _jsmnf_read_4_digits((char *)p + 2, end, &hex)
+                        && _JSMNF_UTF16_IS_FIRST_SURROGATE(hex)
+                        && end - p >= 12
+                    ? 12
+                    : 6;
+        }
+        if (n > (size_t)(end - p)
+            || (ret = jsmnf_unescape(buf, sizeof(buf), p, n)) < 0)
+        {
+            return _jsmnf_hash_bytes(seed, src, len);
+        }
+        _jsmnf_hash_feed(&s, buf, (size_t)ret);
+        p += n;
     }
-    while ((ret = jsmn_parse(parser, js, len, *p_tokens, *num_tokens))
-           == JSMN_ERROR_NOMEM)
+    if (s.fill) {
+        w = 0;
+        memcpy(&w, s.word, s.fill);
+        s.h = _jsmnf_hash_mix(s.h ^ w);
+    }
+    return _jsmnf_hash_mix(s.h ^ (uint64_t)s.total);
+}
+
+/* the stored hash of `pair`, or NULL if it isn't part of `hashes` */
+static uint64_t *
+_jsmnf_hashes_slot(const struct jsmnf_hashes *hashes,
+                   const struct jsmnf_pair *pair)
+{
+    if (!hashes || !hashes->values || pair < hashes->root
+        || (size_t)(pair - hashes->root) >= hashes->len)
     {
-        RECALLOC_OR_ERROR(*p_tokens, num_tokens);
+        return NULL;
     }
-    return ret;
+    return hashes->values + (pair - hashes->root);
 }
 
-JSMN_API long
-jsmnf_load_auto(struct jsmnf_loader *loader,
-                const char js[],
-                const size_t len,
-                struct jsmnf_table **p_table,
-                size_t *table_len)
+/* hash `pair` bottom-up, storing the hash of every pair of `hashes` */
+static uint64_t
+_jsmnf_hash_pair(const struct jsmnf_pair *pair,
+                 const char js[],
+                 const struct jsmnf_hashes *hashes)
 {
-    int ret;
+    const struct jsmntok *v = pair->v;
+    uint64_t h, *slot;
+    size_t i;
 
-    if (NULL == *p_table || 0 == *table_len) {
-        if (!(*p_table = calloc(1, sizeof **p_table))) {
-            return JSMN_ERROR_NOMEM;
+    if (!v) /* empty array slot of a projection */
+        h = _jsmnf_hash_mix(_JSMNF_HASH_SEED);
+    else if (JSMN_ARRAY == v->type) {
+        h = _JSMNF_HASH_SEED + JSMN_ARRAY;
+        for (i = 0; i < pair->length; ++i) {
+            h = _jsmnf_hash_mix(h ^ _jsmnf_hash_pair(pair->fields + i, js,
+                                                     hashes));
         }
-        *table_len = 1;
+        h = _jsmnf_hash_mix(h ^ (uint64_t)pair->length);
     }
-    while ((ret = jsmnf_load(loader, js, len, *p_table, *table_len))
-           == JSMN_ERROR_NOMEM)
-    {
-        RECALLOC_OR_ERROR(*p_table, table_len);
+    else if (JSMN_OBJECT == v->type) {
+        /* members are summed up, so that their order doesn't matter */
+        uint64_t sum = 0;
+
+        for (i = 0; i < pair->length; ++i) {
+            const struct jsmnf_pair *field = pair->fields + i;
+            const char *key = js + field->k->start;
+            const size_t len = (size_t)(field->k->end - field->k->start);
+
+            sum += _jsmnf_hash_mix(
+                ((field->flags & JSMNF_KEY_ESCAPED)
+                     ? _jsmnf_hash_unescaped(_JSMNF_HASH_SEED, key, len)
+                     : _jsmnf_hash_bytes(_JSMNF_HASH_SEED, key, len))
+                ^ _jsmnf_hash_pair(field, js, hashes));
+        }
+        h = _jsmnf_hash_mix((_JSMNF_HASH_SEED + JSMN_OBJECT) ^ sum);
+        h = _jsmnf_hash_mix(h ^ (uint64_t)pair->length);
     }
-    return ret;
+    else if (pair->flags & JSMNF_VALUE_ESCAPED) {
+        h = _jsmnf_hash_unescaped(_JSMNF_HASH_SEED + v->type, js + v->start,
+                                  (size_t)(v->end - v->start));
+    }
+    else {
+        h = _jsmnf_hash_bytes(_JSMNF_HASH_SEED + v->type, js + v->start,
+                              (size_t)(v->end - v->start));
+    }
+    if ((slot = _jsmnf_hashes_slot(hashes, pair)) != NULL) *slot = h;
+    return h;
 }
 
-#undef RECALLOC_OR_ERROR
+JSMN_API uint64_t
+jsmnf_hash(const struct jsmnf_pair *pair, const char js[])
+{
+    return _jsmnf_hash_pair(pair, js, NULL);
+}
 
-static int
-_jsmnf_read_4_digits(char *s, const char *end, unsigned *p_hex)
+JSMN_API long
+jsmnf_hashes_init(struct jsmnf_hashes *hashes,
+                  const struct jsmnf_pair *root,
+                  const char js[],
+                  uint64_t values[],
+                  size_t len)
 {
-    char buf[5] = { 0 };
-    int i;
+    size_t i, used = 1;
 
-    if (end - s < 4) return JSMN_ERROR_PART;
+    /* the pairs of a subtree are always placed after their parent */
+    for (i = 0; i < used; ++i) {
+        const struct jsmnf_pair *pair = root + i;
 
-    for (i = 0; i < 4; i++) {
-        buf[i] = s[i];
-        if (('0' <= s[i] && s[i] <= '9') || ('A' <= s[i] && s[i] <= 'F')
-            || ('a' <= s[i] && s[i] <= 'f'))
+        if (i >= len) return JSMN_ERROR_NOMEM;
+        if (pair->v
+            && (JSMN_OBJECT == pair->v->type || JSMN_ARRAY == pair->v->type)
+            && pair->length)
         {
-            continue;
+            const size_t top = (size_t)(pair->fields - root) + pair->length;
+
+            if (top > used) used = top;
         }
-        return JSMN_ERROR_INVAL;
+        if (used > len) return JSMN_ERROR_NOMEM;
     }
-
-    *p_hex = (unsigned)strtoul(buf, NULL, 16);
-
-    return 4;
+    hashes->root = root;
+    hashes->js = js;
+    hashes->values = values;
+    hashes->len = used;
+    _jsmnf_hash_pair(root, js, hashes);
+    return (long)used;
 }
 
-#define _JSMNF_UTF16_IS_FIRST_SURROGATE(c)                                    \
-    (0xD800 <= (unsigned)c && (unsigned)c <= 0xDBFF)
-#define _JSMNF_UTF16_IS_SECOND_SURROGATE(c)                                   \
-    (0xDC00 <= (unsigned)c && (unsigned)c <= 0xDFFF)
-#define _JSMNF_UTF16_JOIN_SURROGATE(c1, c2)                                   \
-    (((((unsigned long)c1 & 0x3FF) << 10) | ((unsigned)c2 & 0x3FF)) + 0x10000)
-#define _JSMNF_UTF8_IS_VALID(c)                                               \
-    (((unsigned long)c <= 0x10FFFF)                                           \
-     && ((unsigned long)c < 0xD800 || (unsigned long)c > 0xDFFF))
-#define _JSMNF_UTF8_IS_TRAIL(c) (((unsigned char)c & 0xC0) == 0x80)
-#define _JSMNF_UTF_ILLEGAL      0xFFFFFFFFu
-
-static int
-_jsmnf_utf8_trail_length(unsigned char c)
+JSMN_API uint64_t
+jsmnf_hashes_get(const struct jsmnf_hashes *hashes,
+                 const struct jsmnf_pair *pair)
 {
-    if (c < 128) return 0;
-    if (c < 194) return -1;
-    if (c < 224) return 1;
-    if (c < 240) return 2;
-    if (c <= 244) return 3;
-    return -1;
+    const uint64_t *slot = _jsmnf_hashes_slot(hashes, pair);
+
+    return slot ? *slot : jsmnf_hash(pair, hashes->js);
 }
 
+/* whether two strings are equal once unescaped */
 static int
-_jsmnf_utf8_width(unsigned long value)
+_jsmnf_same_unescaped(const struct jsmntok *a,
+                      const char a_js[],
+                      const struct jsmntok *b,
+                      const char b_js[])
 {
-    if (value <= 0x7F) return 1;
-    if (value <= 0x7FF) return 2;
-    if (value <= 0xFFFF) return 3;
-    return 4;
+    char a_stack[_JSMNF_DIFF_STACK], b_stack[_JSMNF_DIFF_STACK];
+    char *a_buf, *b_buf;
+    long a_len, b_len;
+    int ret;
+
+    a_len = _jsmnf_diff_unescape(a_js + a->start, (size_t)(a->end - a->start),
+                                 a_stack, &a_buf);
+    if (JSMN_ERROR_NOMEM == a_len) return JSMN_ERROR_NOMEM;
+    b_len = _jsmnf_diff_unescape(b_js + b->start, (size_t)(b->end - b->start),
+                                 b_stack, &b_buf);
+    if (JSMN_ERROR_NOMEM == b_len)
+        ret = JSMN_ERROR_NOMEM;
+    else
+        ret = a_len >= 0 && a_len == b_len
+              && 0 == memcmp(a_buf, b_buf, (size_t)a_len);
+    if (a_buf != a_stack) JSMNF_FREE(a_buf);
+    if (b_buf != b_stack) JSMNF_FREE(b_buf);
+    return ret;
 }
 
-/* See RFC 3629
-   Based on: http://www.w3.org/International/questions/qa-forms-utf-8 */
-static unsigned long
-_jsmnf_utf8_next(char **p, const char *end)
+JSMN_API int
+jsmnf_subtree_equal(const struct jsmnf_hashes *a_hashes,
+                    const struct jsmnf_pair *a,
+                    const struct jsmnf_hashes *b_hashes,
+                    const struct jsmnf_pair *b)
 {
-    unsigned char lead, tmp;
-    int trail_size;
-    unsigned long c;
+    const char *a_js = a_hashes->js, *b_js = b_hashes->js;
+    size_t i;
+    int ret;
 
-    if (*p == end) return _JSMNF_UTF_ILLEGAL;
+    if (jsmnf_hashes_get(a_hashes, a) != jsmnf_hashes_get(b_hashes, b))
+        return 0;
+    if (!a->v || !b->v) return a->v == b->v;
+    if (_jsmnf_diff_same_span(a->v, a_js, b->v, b_js)) return 1;
+    if (a->v->type != b->v->type || a->length != b->length) return 0;
 
-    lead = **p;
-    (*p)++;
+    switch (a->v->type) {
+    case JSMN_ARRAY:
+        for (i = 0; i < a->length; ++i) {
+            if ((ret = jsmnf_subtree_equal(a_hashes, a->fields + i,
+                                           b_hashes, b->fields + i))
+                <= 0)
+            {
+                return ret;
+            }
+        }
+        return 1;
+    case JSMN_OBJECT:
+        for (i = 0; i < a->length; ++i) {
+            const struct jsmnf_pair *field = a->fields + i, *match;
+
+            if ((ret = _jsmnf_diff_find(b, b_js, field, a_js, &match)) < 0)
+                return ret;
+            if (!match) return 0;
+            if ((ret = jsmnf_subtree_equal(a_hashes, field, b_hashes,
+                                           match))
+                <= 0)
+            {
+                return ret;
+            }
+        }
+        return 1;
+    case JSMN_STRING:
+        if (!((a->flags | b->flags) & JSMNF_VALUE_ESCAPED)) return 0;
+        return _jsmnf_same_unescaped(a->v, a_js, b->v, b_js);
+    default:
+        /* scalars with different bytes */
+        return 0;
+    }
+}
 
-    /* First byte is fully validated here */
-    trail_size = _jsmnf_utf8_trail_length(lead);
+/* data item kinds of the binary formats, valued as CBOR major types */
+enum _jsmnf_transcode_kind {
+    _JSMNF_TRANSCODE_UINT = 0,
+    _JSMNF_TRANSCODE_NEGINT = 1,
+    _JSMNF_TRANSCODE_STRING = 3,
+    _JSMNF_TRANSCODE_ARRAY = 4,
+    _JSMNF_TRANSCODE_MAP = 5
+};
 
-    if (trail_size < 0) return _JSMNF_UTF_ILLEGAL;
+struct _jsmnf_transcoder {
+    /** the JSON string */
+    const char *js;
+    /** `enum jsmnf_transcode_format` value */
+    int format;
+    /** the output buffer */
+    char *buf;
+    /** `buf` size */
+    size_t size;
+    /** amount of bytes written */
+    size_t len;
+};
 
-    /* Ok as only ASCII may be of size = 0 also optimize for ASCII text */
-    if (trail_size == 0) return lead;
+static int
+_jsmnf_transcoder_byte(struct _jsmnf_transcoder *t, unsigned char c)
+{
+    if (t->len == t->size) return JSMN_ERROR_NOMEM;
+    t->buf[t->len++] = (char)c;
+    return 0;
+}
 
-    c = lead & ((1 << (6 - trail_size)) - 1);
+/* write the `n` lowest bytes of `value`, big-endian */
+static int
+_jsmnf_transcoder_be(struct _jsmnf_transcoder *t,
+                     unsigned char tag,
+                     uint64_t value,
+                     size_t n)
+{
+    if (t->size - t->len < 1 + n) return JSMN_ERROR_NOMEM;
+    t->buf[t->len++] = (char)tag;
+    while (n--)
+        t->buf[t->len++] = (char)((value >> (8 * n)) & 0xFF);
+    return 0;
+}
 
-    /* Read the rest */
-    switch (trail_size) {
-    case 3:
-        if (*p == end) return _JSMNF_UTF_ILLEGAL;
-        tmp = **p;
-        (*p)++;
-        if (!_JSMNF_UTF8_IS_TRAIL(tmp)) return _JSMNF_UTF_ILLEGAL;
-        c = (c << 6) | (tmp & 0x3F);
-    /* fall-through */
-    case 2:
-        if (*p == end) return _JSMNF_UTF_ILLEGAL;
-        tmp = **p;
-        (*p)++;
-        if (!_JSMNF_UTF8_IS_TRAIL(tmp)) return _JSMNF_UTF_ILLEGAL;
-        c = (c << 6) | (tmp & 0x3F);
-    /* fall-through */
-    case 1:
-        if (*p == end) return _JSMNF_UTF_ILLEGAL;
-        tmp = **p;
-        (*p)++;
-        if (!_JSMNF_UTF8_IS_TRAIL(tmp)) return _JSMNF_UTF_ILLEGAL;
-        c = (c << 6) | (tmp & 0x3F);
-    }
+/* write the head of a data item, `arg` is the value of integers, minus one
+ *      for negative ones, or the length of strings and containers */
+static int
+_jsmnf_transcoder_head(struct _jsmnf_transcoder *t,
+                       enum _jsmnf_transcode_kind kind,
+                       uint64_t arg)
+{
+    /* MessagePack tags of 1, 2, 4 and 8 bytes arguments, if any */
+    static const unsigned char tags[][4] = {
+        { 0xCC, 0xCD, 0xCE, 0xCF }, /* uint */
+        { 0xD0, 0xD1, 0xD2, 0xD3 }, /* int */
+        { 0 },
+        { 0xD9, 0xDA, 0xDB, 0 }, /* str */
+        { 0, 0xDC, 0xDD, 0 }, /* array */
+        { 0, 0xDE, 0xDF, 0 }, /* map */
+    };
+    const unsigned char *tag = tags[kind];
 
-    /* Check code point validity: no surrogates and valid range */
-    if (!_JSMNF_UTF8_IS_VALID(c)) return _JSMNF_UTF_ILLEGAL;
+    if (JSMNF_TRANSCODE_CBOR == t->format) {
+        const unsigned char major = (unsigned char)(kind << 5);
 
-    /* make sure it is the most compact representation */
-    if (_jsmnf_utf8_width(c) != trail_size + 1) return _JSMNF_UTF_ILLEGAL;
+        if (arg < 24) return _jsmnf_transcoder_byte(t, major | (unsigned)arg);
+        if (arg <= 0xFF) return _jsmnf_transcoder_be(t, major | 24, arg, 1);
+        if (arg <= 0xFFFF) return _jsmnf_transcoder_be(t, major | 25, arg, 2);
+        if (arg <= 0xFFFFFFFF)
+            return _jsmnf_transcoder_be(t, major | 26, arg, 4);
+        return _jsmnf_transcoder_be(t, major | 27, arg, 8);
+    }
 
-    return c;
+    switch (kind) {
+    case _JSMNF_TRANSCODE_UINT:
+        if (arg < 0x80) return _jsmnf_transcoder_byte(t, (unsigned char)arg);
+        break;
+    case _JSMNF_TRANSCODE_NEGINT:
+        /* two's complement of the value */
+        if (arg < 0x20)
+            return _jsmnf_transcoder_byte(t, (unsigned char)~arg);
+        if (arg < 0x80) return _jsmnf_transcoder_be(t, tag[0], ~arg, 1);
+        if (arg < 0x8000) return _jsmnf_transcoder_be(t, tag[1], ~arg, 2);
+        if (arg < 0x80000000) return _jsmnf_transcoder_be(t, tag[2], ~arg, 4);
+        return _jsmnf_transcoder_be(t, tag[3], ~arg, 8);
+    case _JSMNF_TRANSCODE_STRING:
+        if (arg < 0x20)
+            return _jsmnf_transcoder_byte(t, (unsigned char)(0xA0 | arg));
+        break;
+    case _JSMNF_TRANSCODE_ARRAY:
+        if (arg < 0x10)
+            return _jsmnf_transcoder_byte(t, (unsigned char)(0x90 | arg));
+        break;
+    case _JSMNF_TRANSCODE_MAP:
+        if (arg < 0x10)
+            return _jsmnf_transcoder_byte(t, (unsigned char)(0x80 | arg));
+        break;
+    }
+    if (arg <= 0xFF && tag[0]) return _jsmnf_transcoder_be(t, tag[0], arg, 1);
+    if (arg <= 0xFFFF) return _jsmnf_transcoder_be(t, tag[1], arg, 2);
+    if (arg <= 0xFFFFFFFF) return _jsmnf_transcoder_be(t, tag[2], arg, 4);
+    return _jsmnf_transcoder_be(t, tag[3], arg, 8);
 }
 
-static long
-_jsmnf_utf8_validate(char *p, const char *end)
+static int
+_jsmnf_transcoder_double(struct _jsmnf_transcoder *t, double value)
 {
-    const char *start = p;
-    while (p != end) {
-        if (_jsmnf_utf8_next(&p, end) == _JSMNF_UTF_ILLEGAL)
-            return JSMN_ERROR_INVAL;
+    const int cbor = (JSMNF_TRANSCODE_CBOR == t->format);
+
+    /* infinities are kept by single precision floats as well */
+    if ((fabs(value) <= FLT_MAX && (double)(float)value == value)
+        || HUGE_VAL == fabs(value))
+    {
+        const float f = (float)value;
+        uint32_t bits;
+
+        memcpy(&bits, &f, sizeof bits);
+        return _jsmnf_transcoder_be(t, cbor ? 0xFA : 0xCA, bits, 4);
+    }
+    else {
+        uint64_t bits;
+
+        memcpy(&bits, &value, sizeof bits);
+        return _jsmnf_transcoder_be(t, cbor ? 0xFB : 0xCB, bits, 8);
     }
-    return (long)(end - start);
 }
 
-static unsigned
-_jsmnf_utf8_encode(unsigned long value, char utf8_seq[4])
+static int
+_jsmnf_transcoder_string(struct _jsmnf_transcoder *t,
+                         const struct jsmntok *tok)
 {
-    if (value <= 0x7F) {
-        utf8_seq[0] = value;
-        return 1;
-    }
-    if (value <= 0x7FF) {
-        utf8_seq[0] = (value >> 6) | 0xC0;
-        utf8_seq[1] = (value & 0x3F) | 0x80;
-        return 2;
+    const char *str = t->js + tok->start;
+    const size_t len = (size_t)(tok->end - tok->start);
+    struct _jsmnf_transcoder head = *t;
+    char head_buf[9];
+    long ret;
+
+    if (!_jsmnf_has_escapes(t->js, tok)) {
+        if ((ret = _jsmnf_transcoder_head(t, _JSMNF_TRANSCODE_STRING, len))
+            < 0)
+        {
+            return (int)ret;
+        }
+        if (t->size - t->len < len) return JSMN_ERROR_NOMEM;
+        memcpy(t->buf + t->len, str, len);
+        t->len += len;
+        return 0;
     }
-    if (value <= 0xFFFF) {
-        utf8_seq[0] = (value >> 12) | 0xE0;
-        utf8_seq[1] = ((value >> 6) & 0x3F) | 0x80;
-        utf8_seq[2] = (value & 0x3F) | 0x80;
-        return 3;
+
+    /* unescape right after the smallest head of a single byte, and shift
+     *      the string if the final head is longer */
+    if (t->size - t->len < 1) return JSMN_ERROR_NOMEM;
+    if ((ret = jsmnf_unescape(t->buf + t->len + 1, t->size - t->len - 1, str,
+                              len))
+        < 0)
+    {
+        return (int)ret;
     }
-    utf8_seq[0] = (value >> 18) | 0xF0;
-    utf8_seq[1] = ((value >> 12) & 0x3F) | 0x80;
-    utf8_seq[2] = ((value >> 6) & 0x3F) | 0x80;
-    utf8_seq[3] = (value & 0x3F) | 0x80;
-    return 4;
+    head.buf = head_buf;
+    head.size = sizeof(head_buf);
+    head.len = 0;
+    (void)_jsmnf_transcoder_head(&head, _JSMNF_TRANSCODE_STRING,
+                                 (uint64_t)ret);
+    if (t->size - t->len < head.len + (size_t)ret) return JSMN_ERROR_NOMEM;
+    if (head.len != 1)
+        memmove(t->buf + t->len + head.len, t->buf + t->len + 1, (size_t)ret);
+    memcpy(t->buf + t->len, head_buf, head.len);
+    t->len += head.len + (size_t)ret;
+    return 0;
 }
 
 static int
-_jsmnf_utf8_append(unsigned long hex, char *buf_tok, const char *buf_end)
+_jsmnf_transcoder_primitive(struct _jsmnf_transcoder *t,
+                            const struct jsmntok *tok)
 {
-    char utf8_seq[4];
-    unsigned utf8_seqlen = _jsmnf_utf8_encode(hex, utf8_seq);
-    unsigned i;
-
-    if ((buf_tok + utf8_seqlen) >= buf_end) return JSMN_ERROR_NOMEM;
+    const int cbor = (JSMNF_TRANSCODE_CBOR == t->format);
+    const char *str = t->js + tok->start;
+    const size_t len = (size_t)(tok->end - tok->start);
+    uint64_t magnitude;
+    double value;
+    int negative, ret;
 
-    for (i = 0; i < utf8_seqlen; ++i)
-        buf_tok[i] = utf8_seq[i];
-    return utf8_seqlen;
+    if (!len) return JSMN_ERROR_INVAL;
+    switch (*str) {
+    case 't':
+        if (len != 4 || memcmp(str, "true", 4)) return JSMN_ERROR_INVAL;
+        return _jsmnf_transcoder_byte(t, cbor ? 0xF5 : 0xC3);
+    case 'f':
+        if (len != 5 || memcmp(str, "false", 5)) return JSMN_ERROR_INVAL;
+        return _jsmnf_transcoder_byte(t, cbor ? 0xF4 : 0xC2);
+    case 'n':
+        if (len != 4 || memcmp(str, "null", 4)) return JSMN_ERROR_INVAL;
+        return _jsmnf_transcoder_byte(t, cbor ? 0xF6 : 0xC0);
+    }
+    /* integers are tried first, and fall back to doubles when they don't
+     *      fit or aren't integers at all */
+    if (0 == _jsmnf_parse_u64(str, str + len, &magnitude, &negative)) {
+        if (!negative || !magnitude)
+            return _jsmnf_transcoder_head(t, _JSMNF_TRANSCODE_UINT, magnitude);
+        if (cbor || magnitude <= (UINT64_C(1) << 63))
+            return _jsmnf_transcoder_head(t, _JSMNF_TRANSCODE_NEGINT,
+                                          magnitude - 1);
+    }
+    if ((ret = _jsmnf_parse_double(str, len, &value)) == JSMNF_ERROR_RANGE)
+        /* too large for a double, but not for the formats' infinities */
+        value = ('-' == *str) ? -HUGE_VAL : HUGE_VAL;
+    else if (ret < 0)
+        return ret;
+    return _jsmnf_transcoder_double(t, value);
 }
 
-#define BUF_PUSH(buf_tok, c, buf_end)                                         \
-    do {                                                                      \
-        if (buf_tok >= buf_end) return JSMN_ERROR_NOMEM;                      \
-        *buf_tok++ = c;                                                       \
-    } while (0)
+static int
+_jsmnf_transcoder_scalar(struct _jsmnf_transcoder *t,
+                         const struct jsmntok *tok)
+{
+    if (JSMN_STRING == tok->type) return _jsmnf_transcoder_string(t, tok);
+    if (JSMN_PRIMITIVE == tok->type)
+        return _jsmnf_transcoder_primitive(t, tok);
+    return JSMN_ERROR_INVAL;
+}
 
-JSMN_API long
-jsmnf_unescape(char buf[], size_t bufsize, const char src[], size_t len)
+static int
+_jsmnf_transcode_pair(struct _jsmnf_transcoder *t,
+                      const struct jsmnf_pair *pair)
 {
-    char *src_tok = (char *)src, *const src_end = src_tok + len;
-    char *buf_tok = buf, *const buf_end = buf + bufsize;
-    int second_surrogate_expected = 0;
-    unsigned first_surrogate = 0;
+    const struct jsmntok *v = pair->v;
+    size_t i;
+    int ret;
 
-    while (*src_tok && src_tok < src_end) {
-        char c = *src_tok++;
+    if (!v) /* empty array slot of a projection */
+        return _jsmnf_transcoder_byte(
+            t, JSMNF_TRANSCODE_CBOR == t->format ? 0xF6 : 0xC0);
+    if (JSMN_OBJECT != v->type && JSMN_ARRAY != v->type)
+        return _jsmnf_transcoder_scalar(t, v);
 
-        if (0 <= c && c <= 0x1F) return JSMN_ERROR_INVAL;
+    if ((ret = _jsmnf_transcoder_head(t,
+                                      JSMN_OBJECT == v->type
+                                          ? _JSMNF_TRANSCODE_MAP
+                                          : _JSMNF_TRANSCODE_ARRAY,
+                                      pair->length))
+        < 0)
+    {
+        return ret;
+    }
+    for (i = 0; i < pair->length; ++i) {
+        const struct jsmnf_pair *field = pair->fields + i;
 
-        if (c != '\\') {
-            if (second_surrogate_expected) return JSMN_ERROR_INVAL;
-            BUF_PUSH(buf_tok, c, buf_end);
-            continue;
+        if (JSMN_OBJECT == v->type
+            && (ret = _jsmnf_transcoder_string(t, field->k)) < 0)
+        {
+            return ret;
         }
+        if ((ret = _jsmnf_transcode_pair(t, field)) < 0) return ret;
+    }
+    return 0;
+}
 
-        /* expects escaping but src is a well-formed string */
-        if (!*src_tok || src_tok >= src_end) return JSMN_ERROR_PART;
-
-        c = *src_tok++;
-
-        if (second_surrogate_expected && c != 'u') return JSMN_ERROR_INVAL;
+/* transcode the subtree of `tokens[idx]`, returns the index past it */
+static long
+_jsmnf_transcode_token(struct _jsmnf_transcoder *t,
+                       const struct jsmntok tokens[],
+                       unsigned num_tokens,
+                       unsigned idx)
+{
+    const struct jsmntok *tok;
+    long next;
+    int i, ret;
 
-        switch (c) {
-        case '"':
-        case '\\':
-        case '/':
-            BUF_PUSH(buf_tok, c, buf_end);
-            break;
-        case 'b':
-            BUF_PUSH(buf_tok, '\b', buf_end);
-            break;
-        case 'f':
-            BUF_PUSH(buf_tok, '\f', buf_end);
-            break;
-        case 'n':
-            BUF_PUSH(buf_tok, '\n', buf_end);
-            break;
-        case 'r':
-            BUF_PUSH(buf_tok, '\r', buf_end);
-            break;
-        case 't':
-            BUF_PUSH(buf_tok, '\t', buf_end);
-            break;
-        case 'u': {
-            unsigned hex;
-            int ret = _jsmnf_read_4_digits(src_tok, src_end, &hex);
+    if (idx >= num_tokens) return JSMN_ERROR_PART;
 
-            if (ret != 4) return ret;
+    tok = tokens + idx++;
+    if (JSMN_OBJECT != tok->type && JSMN_ARRAY != tok->type) {
+        if ((ret = _jsmnf_transcoder_scalar(t, tok)) < 0) return ret;
+        return (long)idx;
+    }
 
-            src_tok += ret;
+    if ((ret = _jsmnf_transcoder_head(t,
+                                      JSMN_OBJECT == tok->type
+                                          ? _JSMNF_TRANSCODE_MAP
+                                          : _JSMNF_TRANSCODE_ARRAY,
+                                      (uint64_t)tok->size))
+        < 0)
+    {
+        return ret;
+    }
+    for (i = 0; i < tok->size; ++i) {
+        if (JSMN_OBJECT == tok->type) {
+            if (idx >= num_tokens) return JSMN_ERROR_PART;
+            if (JSMN_STRING != tokens[idx].type) return JSMN_ERROR_INVAL;
+            if ((ret = _jsmnf_transcoder_string(t, tokens + idx++)) < 0)
+                return ret;
+        }
+        if ((next = _jsmnf_transcode_token(t, tokens, num_tokens, idx)) < 0)
+            return next;
+        idx = (unsigned)next;
+    }
+    return (long)idx;
+}
 
-            if (second_surrogate_expected) {
-                if (!_JSMNF_UTF16_IS_SECOND_SURROGATE(hex))
-                    return JSMN_ERROR_INVAL;
+JSMN_API long
+jsmnf_transcode(const struct jsmnf_pair *pair,
+                const char js[],
+                enum jsmnf_transcode_format format,
+                char buf[],
+                size_t bufsize)
+{
+    struct _jsmnf_transcoder t;
+    int ret;
 
-                ret = _jsmnf_utf8_append(
-                    _JSMNF_UTF16_JOIN_SURROGATE(first_surrogate, hex), buf_tok,
-                    buf_end);
-                if (ret < 0) return ret;
+    if (!pair) return JSMN_ERROR_INVAL;
 
-                buf_tok += ret;
+    t.js = js;
+    t.format = format;
+    t.buf = buf;
+    t.size = bufsize;
+    t.len = 0;
+    if ((ret = _jsmnf_transcode_pair(&t, pair)) < 0) return ret;
+    return (long)t.len;
+}
 
-                second_surrogate_expected = 0;
-            }
-            else if (_JSMNF_UTF16_IS_FIRST_SURROGATE(hex)) {
-                second_surrogate_expected = 1;
-                first_surrogate = hex;
-            }
-            else {
-                ret = _jsmnf_utf8_append(hex, buf_tok, buf_end);
-                if (ret < 0) return ret;
+JSMN_API long
+jsmnf_transcode_tokens(const char js[],
+                       const struct jsmntok tokens[],
+                       unsigned num_tokens,
+                       enum jsmnf_transcode_format format,
+                       char buf[],
+                       size_t bufsize)
+{
+    struct _jsmnf_transcoder t;
+    long ret;
 
-                buf_tok += ret;
-            }
-        } break;
-        default:
-            return JSMN_ERROR_INVAL;
-        }
-    }
-    return _jsmnf_utf8_validate(buf, buf_tok);
+    t.js = js;
+    t.format = format;
+    t.buf = buf;
+    t.size = bufsize;
+    t.len = 0;
+    if ((ret = _jsmnf_transcode_token(&t, tokens, num_tokens, 0)) < 0)
+        return ret;
+    return (long)t.len;
 }
 
-#undef BUF_PUSH
-
 #endif /* JSMN_HEADER */
 #endif /* JSMN_H */
 
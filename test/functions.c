@@ -1,6 +1,8 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>
+#include <float.h>
 
 #define JSMN_STRICT
 #include "jsmn_1.1.0.h"
@@ -162,10 +164,295 @@ check_load_dynamic_pairs_and_tokens(void)
     PASS();
 }
 
+TEST
+check_load_file(void)
+{
+    /* an escape right at the end of the file, which isn't NUL-terminated */
+    const char js[] = "{\"a\":[1,2],\"b\":\"\\u263A\"}";
+    const char path[] = "check_load_file.tmp";
+    jsmnf_table *table = NULL;
+    size_t len, table_len = 0;
+    jsmnf_loader loader;
+    const jsmnf_pair *f;
+    const char *mapped;
+    const char *str;
+    char buf[8];
+    FILE *fp;
+    long ret;
+
+    ASSERT((fp = fopen(path, "wb")) != NULL);
+    fwrite(js, 1, sizeof(js) - 1, fp);
+    fclose(fp);
+
+    jsmnf_init(&loader);
+    ASSERT_GTm(print_jsmnerr(ret),
+               ret = jsmnf_load_file(&loader, path, &mapped, &len, &table,
+                                     &table_len),
+               0);
+    ASSERT_EQ(sizeof(js) - 1, len);
+    ASSERT((f = jsmnf_find(loader.root, "a", 1)) != NULL);
+    ASSERT_EQ(2, f->length);
+    ASSERT((f = jsmnf_find(loader.root, "b", 1)) != NULL);
+    ASSERT_EQm(print_jsmnerr(ret), 3,
+               ret = jsmnf_get_string(f, mapped, buf, sizeof(buf), &str));
+    ASSERT_MEM_EQ("\xe2\x98\xba", str, 3);
+    jsmnf_close_file(&loader, mapped, len, table);
+
+    remove(path);
+    jsmnf_init(&loader);
+    table = NULL;
+    table_len = 0;
+    ASSERT_EQ(JSMNF_ERROR_IO, jsmnf_load_file(&loader, path, &mapped, &len,
+                                              &table, &table_len));
+    ASSERT_EQ(NULL, mapped);
+    jsmnf_close_file(&loader, mapped, len, table);
+
+    PASS();
+}
+
+struct counting_allocator {
+    long allocs;
+    long releases;
+    size_t limit;
+};
+
+static void *
+counting_alloc(void *ctx, size_t size)
+{
+    struct counting_allocator *counter = ctx;
+
+    if (size > counter->limit) return NULL;
+    ++counter->allocs;
+    return malloc(size);
+}
+
+static void *
+counting_resize(void *ctx, void *ptr, size_t old_size, size_t new_size)
+{
+    struct counting_allocator *counter = ctx;
+
+    (void)old_size;
+    if (new_size > counter->limit) return NULL;
+    if (!ptr) ++counter->allocs;
+    return realloc(ptr, new_size);
+}
+
+static void
+counting_release(void *ctx, void *ptr)
+{
+    struct counting_allocator *counter = ctx;
+
+    if (ptr) ++counter->releases;
+    free(ptr);
+}
+
+TEST
+check_load_allocator(void)
+{
+    const char js[] = "{\"foo\":{\"bar\":{\"baz\":[true,false,null]}}}";
+    const char path[] = "check_load_allocator.tmp";
+    struct counting_allocator counter = { 0, 0, (size_t)-1 };
+    jsmnf_allocator allocator;
+    jsmnf_compact *compact = NULL;
+    jsmnf_table *table = NULL;
+    size_t table_len = 0, size = 0, len;
+    jsmnf_loader loader;
+    const char *mapped;
+    FILE *fp;
+    long ret;
+
+    allocator.alloc = &counting_alloc;
+    allocator.resize = &counting_resize;
+    allocator.release = &counting_release;
+    allocator.ctx = &counter;
+
+    jsmnf_init(&loader);
+    jsmnf_init_allocator(&loader, &allocator);
+    ASSERT_GTm(print_jsmnerr(ret),
+               ret = jsmnf_load_auto(&loader, js, sizeof(js) - 1, &table,
+                                     &table_len),
+               0);
+    ASSERT(jsmnf_find(loader.root, "foo", 3) != NULL);
+    ASSERT_EQ(1, counter.allocs);
+    allocator.release(allocator.ctx, table);
+    ASSERT_EQ(1, counter.releases);
+
+    ASSERT_GTm(print_jsmnerr(ret),
+               ret = jsmnf_compact_load_auto(&allocator, js, sizeof(js) - 1,
+                                             &compact, &size),
+               0);
+    ASSERT(jsmnf_compact_find(compact, jsmnf_compact_root(compact),
+                              jsmnf_compact_js(compact), "foo", 3)
+           != NULL);
+    allocator.release(allocator.ctx, compact);
+    ASSERT_EQ(counter.allocs, counter.releases);
+
+    /* a refused allocation surfaces as an error, not a crash */
+    counter.limit = 2 * sizeof *table;
+    table = NULL;
+    table_len = 0;
+    jsmnf_init(&loader);
+    jsmnf_init_allocator(&loader, &allocator);
+    ASSERT_EQ(JSMN_ERROR_NOMEM, jsmnf_load_auto(&loader, js, sizeof(js) - 1,
+                                                &table, &table_len));
+    allocator.release(allocator.ctx, table);
+    ASSERT_EQ(counter.allocs, counter.releases);
+
+    /* so is a file read into memory where it can't be mapped */
+    ASSERT((fp = fopen(path, "wb")) != NULL);
+    fwrite(js, 1, sizeof(js) - 1, fp);
+    fclose(fp);
+    counter.allocs = counter.releases = 0;
+    counter.limit = (size_t)-1;
+    table = NULL;
+    table_len = 0;
+    jsmnf_init(&loader);
+    jsmnf_init_allocator(&loader, &allocator);
+    ASSERT_GTm(print_jsmnerr(ret),
+               ret = jsmnf_load_file(&loader, path, &mapped, &len, &table,
+                                     &table_len),
+               0);
+#ifdef JSMNF_NO_MMAP
+    ASSERT_EQ(2, counter.allocs);
+#else
+    ASSERT_EQ(1, counter.allocs);
+#endif
+    jsmnf_close_file(&loader, mapped, len, table);
+    ASSERT_EQ(counter.allocs, counter.releases);
+    remove(path);
+
+    PASS();
+}
+
+TEST
+check_load_tokens(void)
+{
+    const char js[] = "{\"foo\":{\"bar\":{\"baz\":[true,false]}},\"n\":1}";
+    jsmn_parser parser;
+    jsmntok_t *toks = NULL;
+    jsmnf_index *index = NULL, small[2];
+    size_t index_len = 0;
+    unsigned num_tokens = 0;
+    jsmnf_loader loader;
+    const jsmnf_pair *f;
+    long ret;
+
+    jsmn_init(&parser);
+    ASSERT_GTm(print_jsmnerr(ret),
+               ret = jsmn_parse_auto(&parser, js, sizeof(js) - 1, &toks,
+                                     &num_tokens),
+               0);
+
+    jsmnf_init(&loader);
+    ASSERT_EQ(JSMN_ERROR_NOMEM,
+              jsmnf_load_tokens(&loader, js, toks, parser.toknext, small,
+                                sizeof(small) / sizeof *small));
+    ASSERT_EQ(NULL, loader.root);
+
+    /* the pairs point straight into the tokens, which are never copied */
+    ASSERT_GTm(print_jsmnerr(ret),
+               ret = jsmnf_load_tokens_auto(&loader, js, toks, parser.toknext,
+                                            &index, &index_len),
+               0);
+    ASSERT_EQ(toks, loader.root->v);
+    ASSERT((f = jsmnf_find(loader.root, "foo", 3)) != NULL);
+    ASSERT((f = jsmnf_find(f, "bar", 3)) != NULL);
+    ASSERT((f = jsmnf_find(f, "baz", 3)) != NULL);
+    ASSERT_EQ(2, f->length);
+    ASSERT((f = jsmnf_find(f, "1", 1)) != NULL);
+    ASSERT_STRN_EQ("false", js + f->v->start, f->v->end - f->v->start);
+    ASSERT(f->v > toks && f->v < toks + parser.toknext);
+    ASSERT((f = jsmnf_find(loader.root, "n", 1)) != NULL);
+    ASSERT_STRN_EQ("1", js + f->v->start, f->v->end - f->v->start);
+
+    free(index);
+    free(toks);
+
+    PASS();
+}
+
+/* load `js` from an exactly sized token array */
+static long
+load_exact_tokens(jsmnf_loader *loader,
+                  const char js[],
+                  size_t len,
+                  jsmntok_t **p_toks,
+                  jsmnf_index **p_index)
+{
+    size_t index_len = 0;
+    jsmn_parser parser;
+    int num_tokens;
+
+    *p_toks = NULL;
+    *p_index = NULL;
+    jsmn_init(&parser);
+    if ((num_tokens = jsmn_parse(&parser, js, len, NULL, 0)) <= 0)
+        return num_tokens;
+    if (!(*p_toks = malloc((size_t)num_tokens * sizeof **p_toks)))
+        return JSMN_ERROR_NOMEM;
+    jsmn_init(&parser);
+    if ((num_tokens = jsmn_parse(&parser, js, len, *p_toks,
+                                 (unsigned)num_tokens))
+        <= 0)
+    {
+        return num_tokens;
+    }
+    return jsmnf_load_tokens_auto(loader, js, *p_toks, (unsigned)num_tokens,
+                                  p_index, &index_len);
+}
+
+TEST
+check_load_tokens_duplicate_keys(void)
+{
+    const char dup[] = "{\"a\":1,\"a\":[2,3],\"b\":4}";
+    const char empty[] = "{\"\":1,\"b\":2}";
+    jsmntok_t *toks;
+    jsmnf_index *index;
+    jsmnf_loader loader;
+    const jsmnf_pair *f;
+    long ret;
+
+    /* the last duplicate is found, while every member is kept */
+    jsmnf_init(&loader);
+    ASSERT_GTm(print_jsmnerr(ret),
+               ret = load_exact_tokens(&loader, dup, sizeof(dup) - 1, &toks,
+                                       &index),
+               0);
+    ASSERT_EQ(3, loader.root->length);
+    ASSERT((f = jsmnf_find(loader.root, "a", 1)) != NULL);
+    ASSERT_EQ(JSMN_ARRAY, f->v->type);
+    ASSERT_EQ(2, f->length);
+    ASSERT((f = jsmnf_find(loader.root, "b", 1)) != NULL);
+    ASSERT_STRN_EQ("4", dup + f->v->start, f->v->end - f->v->start);
+    ASSERT_STRN_EQ("1", dup + loader.root->fields[0].v->start, 1);
+    free(index);
+    free(toks);
+
+    /* empty keys can't be found, but are kept */
+    jsmnf_init(&loader);
+    ASSERT_GTm(print_jsmnerr(ret),
+               ret = load_exact_tokens(&loader, empty, sizeof(empty) - 1,
+                                       &toks, &index),
+               0);
+    ASSERT_EQ(2, loader.root->length);
+    ASSERT_EQ(0, loader.root->fields[0].k->end
+                     - loader.root->fields[0].k->start);
+    ASSERT((f = jsmnf_find(loader.root, "b", 1)) != NULL);
+    ASSERT_STRN_EQ("2", empty + f->v->start, f->v->end - f->v->start);
+    free(index);
+    free(toks);
+
+    PASS();
+}
+
 SUITE(fn__jsmnf_load_auto)
 {
     RUN_TEST(check_load_dynamic_pairs);
     RUN_TEST(check_load_dynamic_pairs_and_tokens);
+    RUN_TEST(check_load_file);
+    RUN_TEST(check_load_tokens);
+    RUN_TEST(check_load_tokens_duplicate_keys);
+    RUN_TEST(check_load_allocator);
 }
 
 TEST
@@ -200,6 +487,122 @@ check_unescaping_not_enough_buffer_memory(void)
     PASS();
 }
 
+TEST
+check_unescaping_long_strings(void)
+{
+    char src[128], buf[128], expected[128];
+    size_t i;
+    long ret;
+
+    /* escapes and invalid bytes at every offset of a long ASCII run */
+    for (i = 0; i < 64; ++i) {
+        memset(src, 'a', 80);
+        memcpy(src + i, "\\n", 2);
+        memset(expected, 'a', 79);
+        expected[i] = '\n';
+        ASSERT_EQm(print_jsmnerr(ret), 79,
+                   ret = jsmnf_unescape(buf, sizeof(buf), src, 80));
+        ASSERT_MEM_EQ(expected, buf, 79);
+
+        memset(src, 'a', 80);
+        src[i] = '\t';
+        ASSERT_EQm(print_jsmnerr(ret), JSMN_ERROR_INVAL,
+                   ret = jsmnf_unescape(buf, sizeof(buf), src, 80));
+
+        memset(src, 'a', 80);
+        src[i] = '\0';
+        ASSERT_EQm(print_jsmnerr(ret), (long)i,
+                   ret = jsmnf_unescape(buf, sizeof(buf), src, 80));
+    }
+
+    memset(src, 'a', 80);
+    ASSERT_EQm(print_jsmnerr(ret), JSMN_ERROR_NOMEM,
+               ret = jsmnf_unescape(buf, 79, src, 80));
+
+    PASS();
+}
+
+TEST
+check_unescaping_inplace(void)
+{
+    char js[] = "\"a\\u263A\\n\\\"b\\\"\"";
+    jsmntok_t tok = { JSMN_STRING, 1, 0, 0 };
+    long ret;
+
+    tok.end = sizeof(js) - 2;
+    ASSERT_EQm(print_jsmnerr(ret), 8, ret = jsmnf_unescape_inplace(js, &tok));
+    ASSERT_EQ(9, tok.end);
+    ASSERT_MEM_EQ("a\xe2\x98\xba\n\"b\"", js + tok.start, 8);
+
+    tok.start = 2;
+    tok.end = 1;
+    ASSERT_EQm(print_jsmnerr(ret), JSMN_ERROR_INVAL,
+               ret = jsmnf_unescape_inplace(js, &tok));
+
+    PASS();
+}
+
+TEST
+check_unescaping_all(void)
+{
+    char js[] = "{\"k\\u0065y\":\"v\\/al\",\"arr\":[\"\\t\",1,{\"a\\\\\":\"b\"}]}";
+    jsmnf_loader loader;
+    jsmnf_table table[32];
+    const jsmnf_pair *f;
+    long ret;
+
+    jsmnf_init(&loader);
+    ASSERT_EQm(print_jsmnerr(ret), JSMN_ERROR_INVAL,
+               ret = jsmnf_unescape_all(&loader, js));
+
+    ASSERT_GTm(print_jsmnerr(ret),
+               ret = jsmnf_load(&loader, js, sizeof(js) - 1, table,
+                                sizeof(table) / sizeof *table),
+               0);
+    ASSERT_EQm(print_jsmnerr(ret), 4, ret = jsmnf_unescape_all(&loader, js));
+
+    /* rehashed keys are found by their unescaped form */
+    ASSERT(NULL == jsmnf_find(loader.root, "k\\u0065y", 8));
+    ASSERT((f = jsmnf_find(loader.root, "key", 3)) != NULL);
+    ASSERT_EQ(4, f->v->end - f->v->start);
+    ASSERT_MEM_EQ("v/al", js + f->v->start, 4);
+
+    ASSERT((f = jsmnf_find(loader.root, "arr", 3)) != NULL);
+    ASSERT_EQ(1, f->fields[0].v->end - f->fields[0].v->start);
+    ASSERT_EQ('\t', js[f->fields[0].v->start]);
+    ASSERT((f = jsmnf_find(&f->fields[2], "a\\", 2)) != NULL);
+    ASSERT_EQ('b', js[f->v->start]);
+
+    PASS();
+}
+
+TEST
+check_unescaping_all_duplicates(void)
+{
+    char js[] = "{\"a\":1,\"\\u0061\":2,\"\":3,\"\\u0062\":4,\"b\":5}";
+    jsmnf_loader loader;
+    jsmnf_table table[16];
+    const jsmnf_pair *f;
+    long ret;
+
+    jsmnf_init(&loader);
+    ASSERT_GTm(print_jsmnerr(ret),
+               ret = jsmnf_load(&loader, js, sizeof(js) - 1, table,
+                                sizeof(table) / sizeof *table),
+               0);
+    ASSERT_EQm(print_jsmnerr(ret), 2, ret = jsmnf_unescape_all(&loader, js));
+
+    /* keys that unescape into duplicates are still iterated over */
+    ASSERT_EQ(5, loader.root->length);
+    ASSERT_EQ('5', js[loader.root->fields[4].v->start]);
+    ASSERT((f = jsmnf_find(loader.root, "a", 1)) != NULL);
+    ASSERT_EQ('2', js[f->v->start]);
+    ASSERT((f = jsmnf_find(loader.root, "b", 1)) != NULL);
+    ASSERT_EQ('5', js[f->v->start]);
+
+    PASS();
+}
+
 SUITE(fn__jsmnf_unescape)
 {
     /* [0]: expected out ; [1]: input string ; [2]: test meaning */
@@ -224,6 +627,49 @@ SUITE(fn__jsmnf_unescape)
         RUN_TEST1(check_unescaping, accept + i);
 
     RUN_TEST(check_unescaping_not_enough_buffer_memory);
+    RUN_TEST(check_unescaping_long_strings);
+    RUN_TEST(check_unescaping_inplace);
+    RUN_TEST(check_unescaping_all);
+    RUN_TEST(check_unescaping_all_duplicates);
+}
+
+TEST
+check_utf8_validate(void)
+{
+    const char *accept[] = {
+        "plain ascii text that is long enough to take the word path",
+        "Latin: d\xc3\xa9j\xc3\xa0 vu, na\xc3\xafve caf\xc3\xa9",
+        "CJK: \xe6\x97\xa5\xe6\x9c\xac\xe8\xaa\x9e\xe4\xb8\xad\xe6\x96\x87",
+        "emoji: \xf0\x9f\x98\x80\xf0\x9f\x91\x8d\xf4\x8f\xbf\xbf",
+        "",
+    };
+    const char *reject[] = {
+        "\xc0\xaf", /* overlong 2 bytes */
+        "\xe0\x80\xaf", /* overlong 3 bytes */
+        "\xf0\x80\x80\xaf", /* overlong 4 bytes */
+        "\xed\xa0\x80", /* surrogate */
+        "\xf4\x90\x80\x80", /* too large */
+        "\xf5\x80\x80\x80", /* invalid lead */
+        "abcdefghijklmnopq\x80", /* lonely continuation */
+        "\xe6\x97", /* truncated */
+        "\xe6\x97 abcdefghijklmnopqrstuvwxyz", /* too short */
+        "\xf0\x9f\x98\x80\x80", /* too long */
+    };
+    size_t i;
+
+    for (i = 0; i < sizeof(accept) / sizeof *accept; ++i)
+        ASSERT_EQm(accept[i], (long)strlen(accept[i]),
+                   jsmnf_utf8_validate(accept[i], strlen(accept[i])));
+    for (i = 0; i < sizeof(reject) / sizeof *reject; ++i)
+        ASSERT_EQm(reject[i], JSMN_ERROR_INVAL,
+                   jsmnf_utf8_validate(reject[i], strlen(reject[i])));
+
+    PASS();
+}
+
+SUITE(fn__jsmnf_utf8_validate)
+{
+    RUN_TEST(check_utf8_validate);
 }
 
 TEST
@@ -312,11 +758,115 @@ check_load_array(void)
     PASS();
 }
 
+TEST
+check_load_too_large(void)
+{
+    /* lengths past jsmn's `int` offsets are refused before reading `js` */
+    const char js[] = "[1]";
+    const size_t len = (size_t)INT_MAX + 1;
+    static jsmnf_compact compact[16];
+    jsmntok_t *tokens = NULL;
+    unsigned num_tokens = 0;
+    jsmnf_table table[4];
+    jsmnf_cursor cursor;
+    jsmnf_loader loader;
+    jsmn_parser parser;
+
+    jsmnf_init(&loader);
+    ASSERT_EQ(JSMNF_ERROR_RANGE, jsmnf_load(&loader, js, len, table,
+                                            sizeof(table) / sizeof *table));
+    jsmn_init(&parser);
+    ASSERT_EQ(JSMNF_ERROR_RANGE,
+              jsmn_parse_auto(&parser, js, len, &tokens, &num_tokens));
+    ASSERT(NULL == tokens);
+    ASSERT_EQ(JSMNF_ERROR_RANGE,
+              jsmnf_compact_load(js, len, compact, sizeof(compact)));
+    ASSERT_EQ(JSMNF_ERROR_RANGE, jsmnf_cursor_init(&cursor, js, len));
+
+    /* still loads once given its actual length */
+    ASSERT_GT(jsmnf_load(&loader, js, sizeof(js) - 1, table,
+                         sizeof(table) / sizeof *table),
+              0);
+
+    PASS();
+}
+
 SUITE(fn__jsmnf_load)
 {
     RUN_TEST(check_load_not_enough_pairs_for_tokens);
     RUN_TEST(check_load_basic);
     RUN_TEST(check_load_array);
+    RUN_TEST(check_load_too_large);
+}
+
+TEST
+check_load_projected(void)
+{
+    const char js[] = "{\"id\":7,\"blob\":{\"a\":[1,2,3],\"b\":{\"c\":null}},"
+                      "\"items\":[{\"id\":1,\"x\":[true]},{\"id\":2,\"x\":[]}],"
+                      "\"user\":{\"name\":\"foo\",\"tags\":[\"a\",\"b\"]}}";
+    static char *p_id[] = { "id" }, *p_items[] = { "items", "*", "id" },
+                *p_user[] = { "user" };
+    static const jsmnf_keypath paths[] = { { p_id, 1 },
+                                           { p_items, 3 },
+                                           { p_user, 1 } };
+    jsmntok_t tokens[64];
+    jsmn_parser parser;
+    jsmnf_loader loader;
+    jsmnf_index index[64];
+    const jsmnf_pair *f;
+    long ret, num_tokens, used;
+
+    jsmn_init(&parser);
+    ASSERT_GTm(print_jsmnerr(num_tokens),
+               num_tokens = jsmn_parse(&parser, js, sizeof(js) - 1, tokens,
+                                       sizeof(tokens) / sizeof *tokens),
+               0);
+
+    jsmnf_init(&loader);
+    ASSERT_EQm(print_jsmnerr(ret), JSMN_ERROR_NOMEM,
+               ret = jsmnf_load_projected(&loader, js, tokens,
+                                          (unsigned)num_tokens, paths, 3,
+                                          index, 4));
+    ASSERT_GTm(print_jsmnerr(used),
+               used = jsmnf_load_projected(&loader, js, tokens,
+                                           (unsigned)num_tokens, paths, 3,
+                                           index, sizeof(index) / sizeof *index),
+               0);
+    ASSERT_EQ(3, loader.root->length);
+
+    ASSERT_NEQ(NULL, f = jsmnf_find(loader.root, "id", 2));
+    ASSERT_STRN_EQ("7", js + f->v->start, f->v->end - f->v->start);
+    ASSERTm("skipped subtree shouldn't be found",
+            NULL == jsmnf_find(loader.root, "blob", 4));
+
+    ASSERT_NEQ(NULL, f = jsmnf_find(loader.root, "items", 5));
+    ASSERT_EQ(2, f->length);
+    ASSERT_NEQ(NULL, f = jsmnf_find(f, "1", 1));
+    ASSERTm("skipped member shouldn't be found", NULL == jsmnf_find(f, "x", 1));
+    ASSERT_NEQ(NULL, f = jsmnf_find(f, "id", 2));
+    ASSERT_STRN_EQ("2", js + f->v->start, f->v->end - f->v->start);
+
+    /* kept subtrees are loaded whole */
+    ASSERT_NEQ(NULL, f = jsmnf_find(loader.root, "user", 4));
+    ASSERT_NEQ(NULL, f = jsmnf_find(f, "tags", 4));
+    ASSERT_NEQ(NULL, f = jsmnf_find(f, "1", 1));
+    ASSERT_STRN_EQ("b", js + f->v->start, f->v->end - f->v->start);
+
+    /* without a projection everything is loaded */
+    ASSERT_GTm(print_jsmnerr(ret),
+               ret = jsmnf_load_projected(&loader, js, tokens,
+                                          (unsigned)num_tokens, NULL, 0, index,
+                                          sizeof(index) / sizeof *index),
+               used);
+    ASSERT_NEQ(NULL, f = jsmnf_find(loader.root, "blob", 4));
+
+    PASS();
+}
+
+SUITE(fn__jsmnf_load_projected)
+{
+    RUN_TEST(check_load_projected);
 }
 
 TEST
@@ -459,12 +1009,103 @@ check_find_string_elements_in_array(void)
     PASS();
 }
 
+TEST
+check_find_escaped_keys(void)
+{
+    const char js[] = "{\"\\u0069d\":1,\"name\":{\"a\\/b\":2},\"x\\ny\":3}";
+    jsmnf_loader loader;
+    jsmnf_table table[16];
+    char keys[sizeof(js)];
+    const jsmnf_pair *f;
+    long ret;
+
+    /* without a key arena escaped keys are matched by their raw bytes */
+    jsmnf_init(&loader);
+    ASSERT_GTm(print_jsmnerr(ret),
+               ret = jsmnf_load(&loader, js, sizeof(js) - 1, table,
+                                sizeof(table) / sizeof *table),
+               0);
+    ASSERT(NULL == jsmnf_find(loader.root, "id", 2));
+    ASSERT(jsmnf_find(loader.root, "\\u0069d", 7) != NULL);
+
+    jsmnf_init(&loader);
+    jsmnf_init_keys(&loader, keys, sizeof(keys));
+    ASSERT_GTm(print_jsmnerr(ret),
+               ret = jsmnf_load(&loader, js, sizeof(js) - 1, table,
+                                sizeof(table) / sizeof *table),
+               0);
+    ASSERT(NULL == jsmnf_find(loader.root, "\\u0069d", 7));
+    ASSERT((f = jsmnf_find(loader.root, "id", 2)) != NULL);
+    ASSERT_EQ('1', js[f->v->start]);
+    ASSERT((f = jsmnf_find(loader.root, "x\ny", 3)) != NULL);
+    ASSERT_EQ('3', js[f->v->start]);
+    ASSERT((f = jsmnf_find(loader.root, "name", 4)) != NULL);
+    ASSERT((f = jsmnf_find(f, "a/b", 3)) != NULL);
+    ASSERT_EQ('2', js[f->v->start]);
+    /* only escaped keys take up arena space */
+    ASSERT_EQ(2 + 3 + 3, loader.keysnext);
+
+    /* not enough arena space */
+    jsmnf_init(&loader);
+    jsmnf_init_keys(&loader, keys, 4);
+    ASSERT_EQm(print_jsmnerr(ret), JSMN_ERROR_NOMEM,
+               ret = jsmnf_load(&loader, js, sizeof(js) - 1, table,
+                                sizeof(table) / sizeof *table));
+
+    PASS();
+}
+
+TEST
+check_find_escaped_duplicate_keys(void)
+{
+    const char js[] = "{\"a\":1,\"\\u0061\":2}";
+    const char plain[] = "{\"a\":1,\"b\":2}";
+    jsmnf_loader loader;
+    jsmnf_table table[16];
+    jsmntok_t *toks;
+    jsmnf_index *index;
+    char keys[sizeof(js)];
+    const jsmnf_pair *f;
+    long ret, expected;
+
+    jsmnf_init(&loader);
+    ASSERT_GT(expected = jsmnf_load(&loader, plain, sizeof(plain) - 1, table,
+                                    sizeof(table) / sizeof *table),
+              0);
+
+    /* keys turned into duplicates once unescaped */
+    jsmnf_init(&loader);
+    jsmnf_init_keys(&loader, keys, sizeof(keys));
+    ASSERT_EQm(print_jsmnerr(ret), expected,
+               ret = jsmnf_load(&loader, js, sizeof(js) - 1, table,
+                                sizeof(table) / sizeof *table));
+    ASSERT_EQ(2, loader.root->length);
+    ASSERT((f = jsmnf_find(loader.root, "a", 1)) != NULL);
+    ASSERT_EQ('2', js[f->v->start]);
+
+    jsmnf_init(&loader);
+    jsmnf_init_keys(&loader, keys, sizeof(keys));
+    ASSERT_GTm(print_jsmnerr(ret),
+               ret = load_exact_tokens(&loader, js, sizeof(js) - 1, &toks,
+                                       &index),
+               0);
+    ASSERT_EQ(2, loader.root->length);
+    ASSERT((f = jsmnf_find(loader.root, "a", 1)) != NULL);
+    ASSERT_EQ('2', js[f->v->start]);
+    free(index);
+    free(toks);
+
+    PASS();
+}
+
 SUITE(fn__jsmnf_find)
 {
     RUN_TEST(check_find_nested);
     RUN_TEST(check_find_array);
     RUN_TEST(check_find_string_elements_in_array);
     RUN_TEST(check_iterate_over_object_elements_in_array);
+    RUN_TEST(check_find_escaped_keys);
+    RUN_TEST(check_find_escaped_duplicate_keys);
 }
 
 TEST
@@ -499,6 +1140,1639 @@ SUITE(fn__jsmnf_find_path)
     RUN_TEST(check_find_path_nested);
 }
 
+TEST
+check_query_wildcard_and_descend(void)
+{
+    const char js[] = "{\"items\":[{\"id\":1,\"price\":10},{\"id\":2},"
+                      "{\"id\":3,\"meta\":{\"price\":30}}],\"price\":5}";
+    const char *exprs[] = { "$.items[*].id", "$..price", "$.items[-1].id",
+                            "$['items'][0]['price']" };
+    const long expected[] = { 3, 3, 1, 1 };
+    jsmnf_query_op ops[16];
+    const jsmnf_pair *results[8];
+    jsmnf_loader loader;
+    jsmnf_table table[64];
+    long ret, num_ops;
+    size_t i;
+
+    jsmnf_init(&loader);
+    ASSERT_GTm(print_jsmnerr(ret),
+               ret = jsmnf_load(&loader, js, sizeof(js) - 1, table,
+                                sizeof(table) / sizeof *table),
+               0);
+
+    for (i = 0; i < sizeof(exprs) / sizeof *exprs; ++i) {
+        ASSERT_GTm(exprs[i],
+                   num_ops = jsmnf_query_compile(exprs[i], strlen(exprs[i]),
+                                                 ops, sizeof(ops) / sizeof *ops),
+                   0);
+        ASSERT_EQm(exprs[i], expected[i],
+                   jsmnf_query(ops, num_ops, loader.root, js, results,
+                               sizeof(results) / sizeof *results));
+    }
+
+    /* results are reported in document order */
+    num_ops = jsmnf_query_compile(exprs[0], strlen(exprs[0]), ops,
+                                  sizeof(ops) / sizeof *ops);
+    jsmnf_query(ops, num_ops, loader.root, js, results, 3);
+    ASSERT_STRN_EQ("1", js + results[0]->v->start, 1);
+    ASSERT_STRN_EQ("2", js + results[1]->v->start, 1);
+    ASSERT_STRN_EQ("3", js + results[2]->v->start, 1);
+
+    /* not enough room for results */
+    ASSERT_EQm(print_jsmnerr(ret), JSMN_ERROR_NOMEM,
+               ret = jsmnf_query(ops, num_ops, loader.root, js, results, 2));
+    /* count only */
+    ASSERT_EQ(3, jsmnf_query(ops, num_ops, loader.root, js, NULL, 0));
+
+    PASS();
+}
+
+TEST
+check_query_filter(void)
+{
+    const char js[] = "[{\"name\":\"a\",\"qty\":0},{\"name\":\"b\",\"qty\":2},"
+                      "{\"name\":\"c\",\"qty\":5,\"ok\":true}]";
+    jsmnf_query_op ops[8];
+    const jsmnf_pair *results[4], *f;
+    jsmnf_loader loader;
+    jsmnf_table table[64];
+    long num_ops;
+
+    jsmnf_init(&loader);
+    jsmnf_load(&loader, js, sizeof(js) - 1, table,
+               sizeof(table) / sizeof *table);
+
+#define QUERY(_expr)                                                          \
+    (num_ops = jsmnf_query_compile(_expr, sizeof(_expr) - 1, ops,             \
+                                   sizeof(ops) / sizeof *ops),                \
+     jsmnf_query(ops, num_ops, loader.root, js, results,                      \
+                 sizeof(results) / sizeof *results))
+
+    ASSERT_EQ(2, QUERY("$[?(@.qty > 0)].name"));
+    ASSERT_STRN_EQ("b", js + results[0]->v->start, 1);
+    ASSERT_STRN_EQ("c", js + results[1]->v->start, 1);
+    ASSERT_EQ(1, QUERY("$[?(@.name == 'a')].qty"));
+    ASSERT_STRN_EQ("0", js + results[0]->v->start, 1);
+    ASSERT_EQ(2, QUERY("$[?(@.qty<=2)]"));
+    ASSERT_EQ(1, QUERY("$[?(@.ok)]"));
+    ASSERT_EQ(1, QUERY("$[?(@.ok == true)]"));
+    ASSERT_EQ(2, QUERY("$[?(@.name != \"c\")]"));
+    f = results[1];
+    ASSERT_EQ(f, jsmnf_find(loader.root, "1", 1));
+
+#undef QUERY
+
+    PASS();
+}
+
+TEST
+check_query_compile_invalid(void)
+{
+    const char *invalid[] = { "",         "items",   "$.",     "$..",
+                              "$[",       "$[?(@.a", "$[1x]",  "$['a]",
+                              "$[?(@ ~ 1)]", "$[99999999999999999999]",
+                              "$[-99999999999999999999]" };
+    jsmnf_query_op ops[8];
+    size_t i;
+
+    for (i = 0; i < sizeof(invalid) / sizeof *invalid; ++i)
+        ASSERT_EQm(invalid[i], JSMN_ERROR_INVAL,
+                   jsmnf_query_compile(invalid[i], strlen(invalid[i]), ops,
+                                       sizeof(ops) / sizeof *ops));
+
+    ASSERT_EQ(JSMN_ERROR_NOMEM, jsmnf_query_compile("$.a.b.c", 7, ops, 2));
+
+    PASS();
+}
+
+SUITE(fn__jsmnf_query)
+{
+    RUN_TEST(check_query_wildcard_and_descend);
+    RUN_TEST(check_query_filter);
+    RUN_TEST(check_query_compile_invalid);
+}
+
+TEST
+check_cursor_navigate(void)
+{
+    const char js[] =
+        "{ \"skip\": { \"a\": [1, \"}]\\\"\", {\"b\": []}] }, \"n\": 42,"
+        " \"list\": [ \"x\", {\"id\": \"y\"}, 3 ], \"last\": true }";
+    jsmnf_cursor cursor;
+    long ret;
+
+    ASSERT_EQ(1, jsmnf_cursor_init(&cursor, js, sizeof(js) - 1));
+    ASSERT_EQ(JSMN_OBJECT, cursor.tok.type);
+    ASSERT_EQ(1, jsmnf_cursor_enter(&cursor));
+
+    ASSERT_EQm(print_jsmnerr(ret), 1,
+               ret = jsmnf_cursor_find_field(&cursor, "n", 1));
+    ASSERT_EQ(JSMN_PRIMITIVE, cursor.pair.v->type);
+    ASSERT_STRN_EQ("n", js + cursor.pair.k->start,
+                   cursor.pair.k->end - cursor.pair.k->start);
+    ASSERT_STRN_EQ("42", js + cursor.pair.v->start,
+                   cursor.pair.v->end - cursor.pair.v->start);
+
+    ASSERT_EQ(1, jsmnf_cursor_find_field(&cursor, "list", 4));
+    ASSERT_EQ(1, jsmnf_cursor_enter(&cursor));
+    ASSERT_EQ(JSMN_STRING, cursor.tok.type);
+    ASSERT_STRN_EQ("x", js + cursor.tok.start,
+                   cursor.tok.end - cursor.tok.start);
+    ASSERT_EQ(1, jsmnf_cursor_skip(&cursor));
+    ASSERT_EQ(1, jsmnf_cursor_enter(&cursor));
+    ASSERT_EQ(1, jsmnf_cursor_find_field(&cursor, "id", 2));
+    ASSERT_STRN_EQ("y", js + cursor.tok.start,
+                   cursor.tok.end - cursor.tok.start);
+    ASSERT_EQ(0, jsmnf_cursor_skip(&cursor)); /* leave {"id":"y"} */
+    ASSERT_EQ(1, jsmnf_cursor_skip(&cursor));
+    ASSERT_STRN_EQ("3", js + cursor.tok.start,
+                   cursor.tok.end - cursor.tok.start);
+    ASSERT_EQ(0, jsmnf_cursor_skip(&cursor)); /* leave "list" */
+
+    /* forward-only: already passed members are not found */
+    ASSERT_EQ(0, jsmnf_cursor_find_field(&cursor, "skip", 4));
+    ASSERT_EQ(0, cursor.depth);
+    ASSERT_EQ(0, jsmnf_cursor_skip(&cursor));
+
+    PASS();
+}
+
+TEST
+check_cursor_load(void)
+{
+    const char js[] = "{\"big\":[[1,2],[3,4]],\"user\":{\"name\":\"foo\","
+                      "\"tags\":[\"a\",\"b\"]},\"tail\":null}";
+    jsmnf_cursor cursor;
+    jsmnf_loader loader;
+    jsmnf_table table[16];
+    const jsmnf_pair *f;
+    long ret;
+
+    ASSERT_EQ(1, jsmnf_cursor_init(&cursor, js, sizeof(js) - 1));
+    ASSERT_EQ(1, jsmnf_cursor_enter(&cursor));
+    ASSERT_EQ(1, jsmnf_cursor_find_field(&cursor, "user", 4));
+    ASSERT_EQ(-1, cursor.tok.end);
+    ASSERT_GTm(print_jsmnerr(ret),
+               ret = jsmnf_cursor_load(&cursor, &loader, table,
+                                       sizeof(table) / sizeof *table),
+               0);
+    ASSERT_EQ(2, cursor.tok.size);
+
+    /* loaded tokens are relative to the whole document */
+    ASSERT_NEQ(NULL, f = jsmnf_find(loader.root, "tags", 4));
+    ASSERT_NEQ(NULL, f = jsmnf_find(f, "1", 1));
+    ASSERT_STRN_EQ("b", js + f->v->start, f->v->end - f->v->start);
+
+    ASSERT_EQ(1, jsmnf_cursor_find_field(&cursor, "tail", 4));
+    ASSERT_STRN_EQ("null", js + cursor.tok.start,
+                   cursor.tok.end - cursor.tok.start);
+
+    PASS();
+}
+
+SUITE(fn__jsmnf_cursor)
+{
+    RUN_TEST(check_cursor_navigate);
+    RUN_TEST(check_cursor_load);
+}
+
+TEST
+check_get_integers(void)
+{
+    const char js[] = "[-9223372036854775808,-9223372036854775809,"
+                      "9223372036854775807,9223372036854775808,"
+                      "18446744073709551615,18446744073709551616,-0,1.0,1e6,"
+                      "\"1\",01]";
+    jsmnf_loader loader;
+    jsmnf_table table[16];
+    const jsmnf_pair *f;
+    int64_t i64;
+    uint64_t u64;
+
+    jsmnf_init(&loader);
+    jsmnf_load(&loader, js, sizeof(js) - 1, table,
+               sizeof(table) / sizeof *table);
+    f = loader.root->fields;
+
+    ASSERT_EQ(0, jsmnf_get_i64(&f[0], js, &i64));
+    ASSERT_EQ(INT64_MIN, i64);
+    ASSERT_EQ(JSMNF_ERROR_RANGE, jsmnf_get_i64(&f[1], js, &i64));
+    ASSERT_EQ(0, jsmnf_get_i64(&f[2], js, &i64));
+    ASSERT_EQ(INT64_MAX, i64);
+    ASSERT_EQ(JSMNF_ERROR_RANGE, jsmnf_get_i64(&f[3], js, &i64));
+    ASSERT_EQ(0, jsmnf_get_u64(&f[3], js, &u64));
+    ASSERT_EQ((uint64_t)INT64_MAX + 1, u64);
+    ASSERT_EQ(0, jsmnf_get_u64(&f[4], js, &u64));
+    ASSERT_EQ(UINT64_MAX, u64);
+    ASSERT_EQ(JSMNF_ERROR_RANGE, jsmnf_get_u64(&f[5], js, &u64));
+    ASSERT_EQ(JSMNF_ERROR_RANGE, jsmnf_get_u64(&f[0], js, &u64));
+    ASSERT_EQ(0, jsmnf_get_u64(&f[6], js, &u64));
+    ASSERT_EQ(0, u64);
+    ASSERT_EQ(JSMN_ERROR_INVAL, jsmnf_get_i64(&f[7], js, &i64));
+    ASSERT_EQ(JSMN_ERROR_INVAL, jsmnf_get_i64(&f[8], js, &i64));
+    ASSERT_EQ(JSMN_ERROR_INVAL, jsmnf_get_i64(&f[9], js, &i64));
+    ASSERT_EQ(JSMN_ERROR_INVAL, jsmnf_get_i64(&f[10], js, &i64));
+
+    PASS();
+}
+
+TEST
+check_get_double(void)
+{
+    const char *numbers[] = { "0",
+                              "-0.0",
+                              "1.0",
+                              "1e6",
+                              "-12.5e-3",
+                              "0.1",
+                              "3.141592653589793",
+                              "1.000000000000000005",
+                              "9007199254740993",
+                              "2.2250738585072014e-308",
+                              "1.7976931348623157e308",
+                              "4.9e-324",
+                              "1e-999",
+                              "123456789012345678901234567890",
+                              "0.0000000000000000000000000000001234",
+                              "1000000000000000000000000000000000000000000"
+                              "00000000000000000000000000000000000001e-70" };
+    jsmnf_loader loader;
+    jsmnf_table table[4];
+    double value;
+    size_t i;
+
+    for (i = 0; i < sizeof(numbers) / sizeof *numbers; ++i) {
+        char js[128];
+
+        sprintf(js, "[%s]", numbers[i]);
+        jsmnf_init(&loader);
+        jsmnf_load(&loader, js, strlen(js), table,
+                   sizeof(table) / sizeof *table);
+        ASSERT_EQm(numbers[i], 0,
+                   jsmnf_get_double(loader.root->fields, js, &value));
+        ASSERT_EQm(numbers[i], strtod(numbers[i], NULL), value);
+    }
+
+    PASS();
+}
+
+TEST
+check_get_double_long(void)
+{
+    /* 1 + 2^-53, halfway between 1 and the next double */
+    const char halfway[] =
+        "1.00000000000000011102230246251565404236316680908203125";
+    char js[1024], *p;
+    jsmnf_loader loader;
+    jsmnf_table table[4];
+    double value;
+
+    /* just below halfway, longer than 64 characters */
+    p = js;
+    memcpy(p, "[1.000000000000000111", 21);
+    memset(p += 21, '0', 70);
+    memcpy(p += 70, "]", 2);
+    jsmnf_init(&loader);
+    ASSERT_GT(jsmnf_load(&loader, js, strlen(js), table,
+                         sizeof(table) / sizeof *table),
+              0);
+    ASSERT_EQ(0, jsmnf_get_double(loader.root->fields, js, &value));
+    ASSERT_EQ(1.0, value);
+    ASSERT_EQ(strtod(js + 1, NULL), value);
+
+    /* halfway rounds to even, unless a digit past the ones kept says
+     *      otherwise */
+    p = js;
+    *p++ = '[';
+    memcpy(p, halfway, sizeof(halfway) - 1);
+    memset(p += sizeof(halfway) - 1, '0', 900);
+    memcpy(p += 900, "]", 2);
+    jsmnf_init(&loader);
+    ASSERT_GT(jsmnf_load(&loader, js, strlen(js), table,
+                         sizeof(table) / sizeof *table),
+              0);
+    ASSERT_EQ(0, jsmnf_get_double(loader.root->fields, js, &value));
+    ASSERT_EQ(1.0, value);
+
+    memcpy(p, "1]", 3);
+    jsmnf_init(&loader);
+    ASSERT_GT(jsmnf_load(&loader, js, strlen(js), table,
+                         sizeof(table) / sizeof *table),
+              0);
+    ASSERT_EQ(0, jsmnf_get_double(loader.root->fields, js, &value));
+    ASSERT_EQ(1.0 + DBL_EPSILON, value);
+    ASSERT_EQ(strtod(js + 1, NULL), value);
+
+    PASS();
+}
+
+TEST
+check_get_double_invalid(void)
+{
+    const char js[] = "[1e999,-1e999,1.,-,1e,true,\"1\"]";
+    jsmnf_loader loader;
+    jsmnf_table table[16];
+    const jsmnf_pair *f;
+    double value;
+
+    jsmnf_init(&loader);
+    jsmnf_load(&loader, js, sizeof(js) - 1, table,
+               sizeof(table) / sizeof *table);
+    f = loader.root->fields;
+
+    ASSERT_EQ(JSMNF_ERROR_RANGE, jsmnf_get_double(&f[0], js, &value));
+    ASSERT_EQ(JSMNF_ERROR_RANGE, jsmnf_get_double(&f[1], js, &value));
+    ASSERT_EQ(JSMN_ERROR_INVAL, jsmnf_get_double(&f[2], js, &value));
+    ASSERT_EQ(JSMN_ERROR_INVAL, jsmnf_get_double(&f[3], js, &value));
+    ASSERT_EQ(JSMN_ERROR_INVAL, jsmnf_get_double(&f[4], js, &value));
+    ASSERT_EQ(JSMN_ERROR_INVAL, jsmnf_get_double(&f[5], js, &value));
+    ASSERT_EQ(JSMN_ERROR_INVAL, jsmnf_get_double(&f[6], js, &value));
+
+    PASS();
+}
+
+TEST
+check_get_bool(void)
+{
+    const char js[] = "[true,false,null,\"true\"]";
+    jsmnf_loader loader;
+    jsmnf_table table[8];
+    const jsmnf_pair *f;
+    int value;
+
+    jsmnf_init(&loader);
+    jsmnf_load(&loader, js, sizeof(js) - 1, table,
+               sizeof(table) / sizeof *table);
+    f = loader.root->fields;
+
+    ASSERT_EQ(0, jsmnf_get_bool(&f[0], js, &value));
+    ASSERT_EQ(1, value);
+    ASSERT_EQ(0, jsmnf_get_bool(&f[1], js, &value));
+    ASSERT_EQ(0, value);
+    ASSERT_EQ(JSMN_ERROR_INVAL, jsmnf_get_bool(&f[2], js, &value));
+    ASSERT_EQ(JSMN_ERROR_INVAL, jsmnf_get_bool(&f[3], js, &value));
+
+    PASS();
+}
+
+TEST
+check_get_string(void)
+{
+    const char js[] = "{\"raw\":\"abc\",\"esc\\n\":\"a\\tb\",\"num\":1}";
+    jsmnf_loader loader;
+    jsmnf_table table[8];
+    const jsmnf_pair *f;
+    const char *str;
+    char buf[8];
+    long ret;
+
+    jsmnf_init(&loader);
+    jsmnf_load(&loader, js, sizeof(js) - 1, table,
+               sizeof(table) / sizeof *table);
+
+    /* raw values point straight into the JSON string */
+    ASSERT((f = jsmnf_find(loader.root, "raw", 3)) != NULL);
+    ASSERT(jsmnf_is_raw(f));
+    ASSERT_EQ(0, f->flags);
+    ASSERT_EQm(print_jsmnerr(ret), 3,
+               ret = jsmnf_get_string(f, js, buf, sizeof(buf), &str));
+    ASSERT_EQ(js + f->v->start, str);
+
+    ASSERT((f = jsmnf_find(loader.root, "esc\\n", 5)) != NULL);
+    ASSERT_FALSE(jsmnf_is_raw(f));
+    ASSERT_EQ(JSMNF_KEY_ESCAPED | JSMNF_VALUE_ESCAPED, f->flags);
+    ASSERT_EQm(print_jsmnerr(ret), 3,
+               ret = jsmnf_get_string(f, js, buf, sizeof(buf), &str));
+    ASSERT_EQ(buf, str);
+    ASSERT_MEM_EQ("a\tb", str, 3);
+    ASSERT_EQm(print_jsmnerr(ret), JSMN_ERROR_NOMEM,
+               ret = jsmnf_get_string(f, js, buf, 2, &str));
+
+    ASSERT((f = jsmnf_find(loader.root, "num", 3)) != NULL);
+    ASSERT(jsmnf_is_raw(f));
+    ASSERT_EQm(print_jsmnerr(ret), JSMN_ERROR_INVAL,
+               ret = jsmnf_get_string(f, js, buf, sizeof(buf), &str));
+
+    PASS();
+}
+
+SUITE(fn__jsmnf_get)
+{
+    RUN_TEST(check_get_integers);
+    RUN_TEST(check_get_double);
+    RUN_TEST(check_get_double_long);
+    RUN_TEST(check_get_double_invalid);
+    RUN_TEST(check_get_bool);
+    RUN_TEST(check_get_string);
+}
+
+TEST
+check_array_to_numbers(void)
+{
+    const char js[] = "[0, -1, 7, 12345678, -87654321, 123456789012, 42,"
+                      " 99999999, 3]";
+    const int64_t expected[] = { 0,         -1, 7,        12345678, -87654321,
+                                 123456789012, 42, 99999999, 3 };
+    jsmnf_loader loader;
+    jsmnf_table table[16];
+    int64_t i64[9];
+    int32_t i32[9];
+    double f64[9];
+    long ret;
+    int i;
+
+    jsmnf_init(&loader);
+    jsmnf_load(&loader, js, sizeof(js) - 1, table,
+               sizeof(table) / sizeof *table);
+
+    ASSERT_EQm(print_jsmnerr(ret), 9,
+               ret = jsmnf_array_to_i64(loader.root, js, i64, 9));
+    ASSERT_EQm(print_jsmnerr(ret), 9,
+               ret = jsmnf_array_to_f64(loader.root, js, f64, 9));
+    for (i = 0; i < 9; ++i) {
+        ASSERT_EQ(expected[i], i64[i]);
+        ASSERT_EQ((double)expected[i], f64[i]);
+    }
+    /* 123456789012 doesn't fit in 32 bits */
+    ASSERT_EQ(5, jsmnf_array_to_i32(loader.root, js, i32, 9));
+    ASSERT_EQ(-87654321, i32[4]);
+
+    ASSERT_EQ(JSMN_ERROR_NOMEM, jsmnf_array_to_i64(loader.root, js, i64, 8));
+    ASSERT_EQ(JSMN_ERROR_INVAL,
+              jsmnf_array_to_i64(&loader.root->fields[0], js, i64, 9));
+
+    PASS();
+}
+
+TEST
+check_array_to_numbers_stops_at_non_numeric(void)
+{
+    const char js[] = "[1.5,-2e3,0.25,01,\"4\",5]";
+    jsmnf_loader loader;
+    jsmnf_table table[16];
+    int64_t i64[6];
+    double f64[6];
+
+    jsmnf_init(&loader);
+    jsmnf_load(&loader, js, sizeof(js) - 1, table,
+               sizeof(table) / sizeof *table);
+
+    ASSERT_EQ(3, jsmnf_array_to_f64(loader.root, js, f64, 6));
+    ASSERT_EQ(1.5, f64[0]);
+    ASSERT_EQ(-2e3, f64[1]);
+    ASSERT_EQ(0.25, f64[2]);
+    ASSERT_EQ(0, jsmnf_array_to_i64(loader.root, js, i64, 6));
+
+    PASS();
+}
+
+SUITE(fn__jsmnf_array_to)
+{
+    RUN_TEST(check_array_to_numbers);
+    RUN_TEST(check_array_to_numbers_stops_at_non_numeric);
+}
+
+TEST
+check_compact_matches_table(void)
+{
+    static jsmnf_table table[1024];
+    static jsmnf_compact compact[2048];
+    static char *path[] = { "nested", "list", "2", "x" };
+    char js[2048], key[16];
+    const jsmnf_pair *f;
+    const jsmnf_node *node;
+    jsmnf_loader loader;
+    size_t len = 0;
+    long ret;
+    int i;
+
+    len += sprintf(js + len, "{\"nested\":{\"list\":[0,\"s\",{\"x\":true}]}");
+    for (i = 0; i < 100; ++i)
+        len += sprintf(js + len, ",\"k%d\":[%d,\"v%d\"]", i, i, i);
+    len += sprintf(js + len, "}");
+
+    jsmnf_init(&loader);
+    ASSERT_GTm(print_jsmnerr(ret),
+               ret = jsmnf_load(&loader, js, len, table,
+                                sizeof(table) / sizeof *table),
+               0);
+    ASSERT_GTm(print_jsmnerr(ret),
+               ret = jsmnf_compact_load(js, len, compact, sizeof(compact)),
+               0);
+    ASSERT_EQ(loader.parser.toknext, compact->num_nodes);
+    /* the footprint the compact index is meant for */
+    ASSERT((size_t)ret <= JSMNF_COMPACT_SIZE(compact->num_nodes));
+    ASSERT_LT((size_t)ret / compact->num_nodes, 32);
+    ASSERT_GT(sizeof(jsmnf_table), 3 * (size_t)ret / compact->num_nodes);
+
+    for (i = 0; i < 100; ++i) {
+        const size_t key_len = (size_t)sprintf(key, "k%d", i);
+
+        ASSERT((f = jsmnf_find(loader.root, key, key_len)) != NULL);
+        node = jsmnf_compact_find(compact, jsmnf_compact_root(compact), js,
+                                  key, key_len);
+        ASSERT(node != NULL);
+        ASSERT_EQ(f->v->start, (int)node->start);
+        ASSERT_EQ(f->v->end, (int)node->end);
+        ASSERT_EQ(JSMN_ARRAY, node->type);
+        ASSERT((node = jsmnf_compact_field(compact, node, 1)) != NULL);
+        ASSERT_EQ(f->fields[1].v->start, (int)node->start);
+    }
+    ASSERT(NULL
+           == jsmnf_compact_find(compact, jsmnf_compact_root(compact), js,
+                                 "k100", 4));
+
+    f = jsmnf_find_path(loader.root, path, 4);
+    node = jsmnf_compact_find_path(compact, jsmnf_compact_root(compact), js,
+                                   path, 4);
+    ASSERT(f != NULL && node != NULL);
+    ASSERT_EQ(f->v->start, (int)node->start);
+    ASSERT_EQ(JSMN_PRIMITIVE, node->type);
+
+    /* key is the node right before an object member value */
+    node = jsmnf_compact_field(compact, jsmnf_compact_root(compact), 0);
+    ASSERT_MEM_EQ("nested", js + node[-1].start, 6);
+
+    PASS();
+}
+
+TEST
+check_compact_not_enough_memory(void)
+{
+    static jsmnf_compact compact[32];
+    const char js[] = "{\"a\":[1,2,3],\"b\":{\"c\":\"\\n\"}}";
+    const jsmnf_node *node;
+    long ret;
+
+    ASSERT_EQm(print_jsmnerr(ret), JSMN_ERROR_NOMEM,
+               ret = jsmnf_compact_load(js, sizeof(js) - 1, compact, 64));
+    ASSERT_GTm(print_jsmnerr(ret),
+               ret = jsmnf_compact_load(js, sizeof(js) - 1, compact,
+                                        sizeof(compact)),
+               0);
+    node = jsmnf_compact_find(compact, jsmnf_compact_root(compact), js, "b",
+                              1);
+    ASSERT((node = jsmnf_compact_find(compact, node, js, "c", 1)) != NULL);
+    ASSERT_EQ(JSMNF_VALUE_ESCAPED, node->flags);
+
+    PASS();
+}
+
+TEST
+check_compact_relocate(void)
+{
+    static jsmnf_compact compact[64], moved[64];
+    char js[] = "{\"a\":[1,2,{\"b\":\"c\"}],\"d\":null}";
+    static char *path[] = { "a", "2", "b" };
+    const jsmnf_node *node;
+    const char *doc;
+    long ret;
+
+    ASSERT_EQm(print_jsmnerr(ret), JSMN_ERROR_NOMEM,
+               ret = jsmnf_compact_load_doc(js, sizeof(js) - 1, compact,
+                                            sizeof(jsmnf_compact) + 8));
+    ASSERT_GTm(print_jsmnerr(ret),
+               ret = jsmnf_compact_load_doc(js, sizeof(js) - 1, compact,
+                                            sizeof(compact)),
+               0);
+    ASSERT_EQ((size_t)ret, jsmnf_compact_size(compact));
+    ASSERT_EQ(sizeof(js) - 1, compact->js_len);
+
+    /* the document and its index move as a single block */
+    memcpy(moved, compact, jsmnf_compact_size(compact));
+    memset(compact, 0xFF, sizeof(compact));
+    memset(js, 0, sizeof(js));
+
+    ASSERT((doc = jsmnf_compact_js(moved)) != NULL);
+    node = jsmnf_compact_find_path(moved, jsmnf_compact_root(moved), doc,
+                                   path, 3);
+    ASSERT(node != NULL);
+    ASSERT_MEM_EQ("c", doc + node->start, 1);
+    node = jsmnf_compact_find(moved, jsmnf_compact_root(moved), doc, "d", 1);
+    ASSERT(node != NULL);
+    ASSERT_MEM_EQ("null", doc + node->start, 4);
+
+    PASS();
+}
+
+TEST
+check_compact_load_auto(void)
+{
+    char js[4096], key[16];
+    jsmnf_compact *compact = NULL;
+    const jsmnf_node *node;
+    size_t len = 0, size = 0;
+    long ret;
+    int i;
+
+    len += sprintf(js + len, "{");
+    for (i = 0; i < 200; ++i)
+        len += sprintf(js + len, "%s\"k%d\":[%d]", i ? "," : "", i, i);
+    len += sprintf(js + len, "}");
+
+    ASSERT_GTm(print_jsmnerr(ret),
+               ret = jsmnf_compact_load_auto(NULL, js, len, &compact, &size), 0);
+    ASSERT_GTE(size, (size_t)ret);
+    ASSERT_EQ(1 + 200 * 3, compact->num_nodes);
+    for (i = 0; i < 200; ++i) {
+        const size_t key_len = (size_t)sprintf(key, "k%d", i);
+        const char *doc = jsmnf_compact_js(compact);
+
+        node = jsmnf_compact_find(compact, jsmnf_compact_root(compact), doc,
+                                  key, key_len);
+        ASSERT(node != NULL);
+        ASSERT_EQ(i, atoi(doc + jsmnf_compact_field(compact, node, 0)->start));
+    }
+    free(compact);
+
+    PASS();
+}
+
+TEST
+check_compact_indexed_file(void)
+{
+    static jsmnf_compact compact[64];
+    const char js[] = "{\"a\":[1,2,{\"b\":\"c\"}],\"d\":null}";
+    const char path[] = "check_compact_indexed_file.tmp";
+    const jsmnf_compact *mapped;
+    const jsmnf_node *node;
+    uint32_t *words;
+    FILE *fp;
+    long ret;
+
+    ASSERT_GTm(print_jsmnerr(ret),
+               ret = jsmnf_compact_load(js, sizeof(js) - 1, compact,
+                                        sizeof(compact)),
+               0);
+    /* the JSON string must be embedded */
+    ASSERT_EQ(JSMN_ERROR_INVAL, jsmnf_save_indexed(compact, path));
+
+    ASSERT_GTm(print_jsmnerr(ret),
+               ret = jsmnf_compact_load_doc(js, sizeof(js) - 1, compact,
+                                            sizeof(compact)),
+               0);
+    ASSERT_EQ(0, jsmnf_save_indexed(compact, path));
+    ASSERT_EQ(0, jsmnf_open_indexed(path, &mapped));
+    ASSERT_EQ(jsmnf_compact_size(compact), jsmnf_compact_size(mapped));
+    node = jsmnf_compact_find(mapped, jsmnf_compact_root(mapped),
+                              jsmnf_compact_js(mapped), "a", 1);
+    ASSERT(node != NULL);
+    ASSERT_EQ(3, node->size);
+    jsmnf_close_indexed(mapped);
+
+    /* corrupted files are refused */
+    ASSERT((fp = fopen(path, "r+b")) != NULL);
+    fseek(fp, -3, SEEK_END);
+    fputc('X', fp);
+    fclose(fp);
+    ASSERT_EQ(JSMN_ERROR_INVAL, jsmnf_open_indexed(path, &mapped));
+
+    /* so are files whose checksum matches offsets out of the index */
+    words = (uint32_t *)((char *)(compact + 1) + compact->js_size
+                         + compact->num_nodes * sizeof(jsmnf_node));
+    words[0] = compact->num_nodes;
+    ASSERT_EQ(0, jsmnf_save_indexed(compact, path));
+    ASSERT_EQ(JSMN_ERROR_INVAL, jsmnf_open_indexed(path, &mapped));
+
+    remove(path);
+    ASSERT_EQ(JSMNF_ERROR_IO, jsmnf_open_indexed(path, &mapped));
+
+    PASS();
+}
+
+SUITE(fn__jsmnf_compact)
+{
+    RUN_TEST(check_compact_matches_table);
+    RUN_TEST(check_compact_not_enough_memory);
+    RUN_TEST(check_compact_relocate);
+    RUN_TEST(check_compact_load_auto);
+    RUN_TEST(check_compact_indexed_file);
+}
+
+TEST
+check_doc_load(void)
+{
+    const char js_small[] = "{\"a\":\"\\u263A\",\"b\\n\":[1,2]}";
+    char js_large[2048] = "[";
+    struct counting_allocator counter = { 0, 0, (size_t)-1 };
+    jsmnf_allocator allocator;
+    const jsmnf_pair *f;
+    const char *str;
+    const char *arena;
+    long allocs;
+    jsmnf_doc doc;
+    size_t i;
+    long ret;
+
+    for (i = 1; i < sizeof(js_large) - 8; i += 4)
+        memcpy(js_large + i, "[0],", 4);
+    memcpy(js_large + i, "0]", 3);
+
+    allocator.alloc = &counting_alloc;
+    allocator.resize = &counting_resize;
+    allocator.release = &counting_release;
+    allocator.ctx = &counter;
+    jsmnf_doc_init(&doc, &allocator);
+
+    ASSERT_GTm(print_jsmnerr(ret),
+               ret = jsmnf_doc_load(&doc, js_large, strlen(js_large), 0), 0);
+    ASSERT_EQ(js_large, doc.js);
+    ASSERT((f = jsmnf_find(doc.loader.root, "0", 1)) != NULL);
+    ASSERT_EQ(JSMN_ARRAY, f->v->type);
+
+    /* smaller documents reuse the arena with no further allocations */
+    allocs = counter.allocs;
+    arena = doc.arena;
+    for (i = 0; i < 3; ++i) {
+        jsmnf_doc_reset(&doc);
+        ASSERT_GTm(print_jsmnerr(ret),
+                   ret = jsmnf_doc_load(&doc, js_small, sizeof(js_small) - 1,
+                                        1),
+                   0);
+        ASSERT(doc.js != js_small);
+        ASSERT((f = jsmnf_find(doc.loader.root, "b\n", 2)) != NULL);
+        ASSERT_EQ(2, f->length);
+        ASSERT((f = jsmnf_find(doc.loader.root, "a", 1)) != NULL);
+        ASSERT_EQm(print_jsmnerr(ret), 3,
+                   ret = jsmnf_doc_string(&doc, f, &str));
+        ASSERT_MEM_EQ("\xe2\x98\xba", str, 3);
+    }
+    ASSERT_EQ(allocs, counter.allocs);
+    ASSERT_EQ(arena, doc.arena);
+
+    ASSERT_EQ(JSMN_ERROR_PART, jsmnf_doc_load(&doc, js_small, 4, 1));
+    ASSERT_EQ(NULL, doc.loader.root);
+    ASSERT_EQ(JSMN_ERROR_INVAL, jsmnf_doc_string(&doc, f, &str));
+
+    jsmnf_doc_free(&doc);
+    ASSERT_EQ(NULL, doc.arena);
+    ASSERT_EQ(counter.allocs, counter.releases);
+
+    PASS();
+}
+
+SUITE(fn__jsmnf_doc)
+{
+    RUN_TEST(check_doc_load);
+}
+
+TEST
+check_clone_subtree(void)
+{
+    char js[] = "{\"big\":[1,2,3,4,5,6,7,8],\"user\":{\"name\":\"\\u00e9\","
+                "\"k\\t\":[true,{\"x\":null}],\"n\":0}}";
+    struct counting_allocator counter = { 0, 0, (size_t)-1 };
+    jsmnf_allocator allocator;
+    jsmnf_table table[128];
+    jsmnf_loader loader;
+    jsmnf_clone *clone;
+    const jsmnf_pair *f;
+    const char *str;
+    char buf[8];
+    long ret;
+
+    allocator.alloc = &counting_alloc;
+    allocator.resize = &counting_resize;
+    allocator.release = &counting_release;
+    allocator.ctx = &counter;
+
+    jsmnf_init(&loader);
+    ASSERT_GTm(print_jsmnerr(ret),
+               ret = jsmnf_load(&loader, js, sizeof(js) - 1, table,
+                                sizeof(table) / sizeof *table),
+               0);
+    ASSERT((f = jsmnf_find(loader.root, "user", 4)) != NULL);
+    ASSERT_GTm(print_jsmnerr(ret),
+               ret = jsmnf_clone_subtree(f, js, &allocator, &clone), 0);
+    ASSERT_EQ(1, counter.allocs);
+    ASSERT_LT((size_t)ret, sizeof(table));
+
+    /* the clone outlives the document */
+    memset(js, 0, sizeof(js));
+    memset(table, 0, sizeof(table));
+
+    ASSERT_EQ(0, clone->root->v->start);
+    ASSERT_EQ(clone->len, (size_t)clone->root->v->end);
+    ASSERT_EQ(3, clone->root->length);
+    ASSERT((f = jsmnf_find(clone->root, "name", 4)) != NULL);
+    ASSERT(!jsmnf_is_raw(f));
+    ASSERT_EQm(print_jsmnerr(ret), 2,
+               ret = jsmnf_get_string(f, clone->js, buf, sizeof(buf), &str));
+    ASSERT_MEM_EQ("\xc3\xa9", str, 2);
+    ASSERT((f = jsmnf_find(clone->root, "k\t", 2)) != NULL);
+    ASSERT((f = jsmnf_find(f, "1", 1)) != NULL);
+    ASSERT((f = jsmnf_find(f, "x", 1)) != NULL);
+    ASSERT_STRN_EQ("null", clone->js + f->v->start, f->v->end - f->v->start);
+    ASSERT((f = jsmnf_find(clone->root, "n", 1)) != NULL);
+    ASSERT_STRN_EQ("0", clone->js + f->v->start, f->v->end - f->v->start);
+
+    jsmnf_clone_free(clone);
+    ASSERT_EQ(1, counter.releases);
+
+    PASS();
+}
+
+TEST
+check_clone_string_subtree(void)
+{
+    char js[] = "{\"a\":\"hello\"}";
+    jsmnf_table table[8];
+    jsmnf_loader loader;
+    jsmnf_clone *clone;
+    const jsmnf_pair *f;
+    char buf[16];
+    long ret;
+
+    jsmnf_init(&loader);
+    ASSERT_GT(jsmnf_load(&loader, js, sizeof(js) - 1, table,
+                         sizeof(table) / sizeof *table),
+              0);
+    ASSERT((f = jsmnf_find(loader.root, "a", 1)) != NULL);
+    ASSERT_GTm(print_jsmnerr(ret),
+               ret = jsmnf_clone_subtree(f, js, NULL, &clone), 0);
+    memset(js, 0, sizeof(js));
+
+    /* the quotes are cloned along */
+    ASSERT_EQ(7, clone->len);
+    ASSERT_STRN_EQ("\"hello\"", clone->js, clone->len);
+    ASSERT_EQ(1, clone->root->v->start);
+    ASSERT_EQm(print_jsmnerr(ret), 7,
+               ret = jsmnf_write_buf(clone->root, clone->js, 0, buf,
+                                     sizeof(buf)));
+    ASSERT_STRN_EQ("\"hello\"", buf, 7);
+
+    jsmnf_clone_free(clone);
+
+    PASS();
+}
+
+SUITE(fn__jsmnf_clone_subtree)
+{
+    RUN_TEST(check_clone_subtree);
+    RUN_TEST(check_clone_string_subtree);
+}
+
+struct collect_sink {
+    char buf[512];
+    size_t len;
+    unsigned calls;
+};
+
+static int
+collect(void *ctx, const char data[], size_t len)
+{
+    struct collect_sink *out = ctx;
+
+    if (len > sizeof(out->buf) - out->len) return JSMN_ERROR_NOMEM;
+    memcpy(out->buf + out->len, data, len);
+    out->len += len;
+    ++out->calls;
+    return 0;
+}
+
+TEST
+check_write(void)
+{
+    const char js[] = " { \"a\" : [ 1 , \"x\\\"y\" , {} ] ,\n\"b\":{\"c\":true,"
+                      "\"d\":[]}, \"e\" : null } ";
+    const char minified[] = "{\"a\":[1,\"x\\\"y\",{}],\"b\":{\"c\":true,"
+                            "\"d\":[]},\"e\":null}";
+    const char pretty[] = "{\n  \"a\": [\n    1,\n    \"x\\\"y\",\n    {}\n  ],\n"
+                          "  \"b\": {\n    \"c\": true,\n    \"d\": []\n  },\n"
+                          "  \"e\": null\n}";
+    struct collect_sink out = { "", 0, 0 };
+    jsmnf_table table[64];
+    jsmnf_loader loader;
+    const jsmnf_pair *f;
+    char buf[256];
+    long ret;
+
+    jsmnf_init(&loader);
+    ASSERT_GTm(print_jsmnerr(ret),
+               ret = jsmnf_load(&loader, js, sizeof(js) - 1, table,
+                                sizeof(table) / sizeof *table),
+               0);
+
+    ASSERT_EQm(print_jsmnerr(ret), (long)sizeof(minified) - 1,
+               ret = jsmnf_write_buf(loader.root, js, 0, buf, sizeof(buf)));
+    ASSERT_MEM_EQ(minified, buf, sizeof(minified) - 1);
+    ASSERT_EQm(print_jsmnerr(ret), (long)sizeof(pretty) - 1,
+               ret = jsmnf_write_buf(loader.root, js, JSMNF_WRITE_PRETTY, buf,
+                                     sizeof(buf)));
+    ASSERT_MEM_EQ(pretty, buf, sizeof(pretty) - 1);
+    ASSERT_EQ(JSMN_ERROR_NOMEM,
+              jsmnf_write_buf(loader.root, js, 0, buf, sizeof(minified) - 2));
+
+    /* an already minified subtree reaches the sink as a single span */
+    ASSERT((f = jsmnf_find(loader.root, "b", 1)) != NULL);
+    ASSERT_EQm(print_jsmnerr(ret), 17,
+               ret = jsmnf_write(f, js, 0, &collect, &out));
+    ASSERT_MEM_EQ("{\"c\":true,\"d\":[]}", out.buf, out.len);
+    ASSERT_EQ(1, out.calls);
+
+    /* and so does the whole document once minified */
+    jsmnf_init(&loader);
+    ASSERT_GTm(print_jsmnerr(ret),
+               ret = jsmnf_load(&loader, minified, sizeof(minified) - 1, table,
+                                sizeof(table) / sizeof *table),
+               0);
+    out.len = out.calls = 0;
+    ASSERT_EQm(print_jsmnerr(ret), (long)sizeof(minified) - 1,
+               ret = jsmnf_write(loader.root, minified, 0, &collect, &out));
+    ASSERT_MEM_EQ(minified, out.buf, out.len);
+
+    PASS();
+}
+
+TEST
+check_write_projected(void)
+{
+    const char js[] = "{\"id\":7,\"skip\":{\"x\":1},\"items\":[{\"name\":\"a\","
+                      "\"n\":1},{\"name\":\"b\",\"n\":2}]}";
+    char *id[] = { "id" }, *names[] = { "items", "*", "name" };
+    jsmnf_keypath paths[2];
+    jsmn_parser parser;
+    jsmntok_t tokens[64];
+    jsmnf_index index[64];
+    jsmnf_loader loader;
+    char buf[128];
+    long ret;
+    int num_tokens;
+
+    paths[0].keys = id;
+    paths[0].depth = 1;
+    paths[1].keys = names;
+    paths[1].depth = 3;
+
+    jsmn_init(&parser);
+    ASSERT_GT(num_tokens = jsmn_parse(&parser, js, sizeof(js) - 1, tokens,
+                                      sizeof(tokens) / sizeof *tokens),
+              0);
+    jsmnf_init(&loader);
+    ASSERT_GTm(print_jsmnerr(ret),
+               ret = jsmnf_load_projected(&loader, js, tokens,
+                                          (unsigned)num_tokens, paths, 2,
+                                          index,
+                                          sizeof(index) / sizeof *index),
+               0);
+    ASSERT_GTm(print_jsmnerr(ret),
+               ret = jsmnf_write_buf(loader.root, js, 0, buf, sizeof(buf)),
+               0);
+    ASSERT_STRN_EQ("{\"id\":7,\"items\":[{\"name\":\"a\"},{\"name\":\"b\"}]}",
+                   buf, ret);
+
+    PASS();
+}
+
+SUITE(fn__jsmnf_write)
+{
+    RUN_TEST(check_write);
+    RUN_TEST(check_write_projected);
+}
+
+TEST
+check_writer_roundtrip(void)
+{
+    static const double doubles[] = { 0.1,    0.30000000000000004,
+                                      1e300,  5e-324,
+                                      -2.5,   123456789.125,
+                                      1e21,   1.7976931348623157e308 };
+    const char str[] = "q\"b\\c\x01\x1f\n\t\xe2\x98\xba end of a long string";
+    jsmnf_table table[64];
+    jsmnf_writer writer;
+    jsmnf_loader loader;
+    const jsmnf_pair *f, *g;
+    const char *out;
+    char buf[64];
+    int64_t i64;
+    uint64_t u64;
+    double d;
+    long ret;
+    size_t i;
+
+    jsmnf_writer_init_auto(&writer, NULL);
+    jsmnf_writer_begin_object(&writer);
+    jsmnf_writer_key(&writer, "s", 1);
+    jsmnf_writer_string(&writer, str, sizeof(str) - 1);
+    jsmnf_writer_key(&writer, "min", 3);
+    jsmnf_writer_i64(&writer, INT64_MIN);
+    jsmnf_writer_key(&writer, "max", 3);
+    jsmnf_writer_u64(&writer, UINT64_MAX);
+    jsmnf_writer_key(&writer, "d", 1);
+    jsmnf_writer_begin_array(&writer);
+    for (i = 0; i < sizeof(doubles) / sizeof *doubles; ++i)
+        jsmnf_writer_double(&writer, doubles[i]);
+    jsmnf_writer_end_array(&writer);
+    jsmnf_writer_key(&writer, "e", 1);
+    jsmnf_writer_begin_object(&writer);
+    jsmnf_writer_end_object(&writer);
+    jsmnf_writer_key(&writer, "b", 1);
+    jsmnf_writer_bool(&writer, 1);
+    jsmnf_writer_key(&writer, "n", 1);
+    jsmnf_writer_null(&writer);
+    jsmnf_writer_end_object(&writer);
+    ASSERT_GTm(print_jsmnerr(ret), ret = jsmnf_writer_finish(&writer), 0);
+
+    jsmnf_init(&loader);
+    ASSERT_GTm(print_jsmnerr(ret),
+               ret = jsmnf_load(&loader, writer.buf, writer.len, table,
+                                sizeof(table) / sizeof *table),
+               0);
+    ASSERT_EQ(7, loader.root->length);
+    ASSERT((f = jsmnf_find(loader.root, "s", 1)) != NULL);
+    ASSERT_EQm(print_jsmnerr(ret), (long)sizeof(str) - 1,
+               ret = jsmnf_get_string(f, writer.buf, buf, sizeof(buf), &out));
+    ASSERT_MEM_EQ(str, out, sizeof(str) - 1);
+    ASSERT((f = jsmnf_find(loader.root, "min", 3)) != NULL);
+    ASSERT_EQ(0, jsmnf_get_i64(f, writer.buf, &i64));
+    ASSERT(INT64_MIN == i64);
+    ASSERT((f = jsmnf_find(loader.root, "max", 3)) != NULL);
+    ASSERT_EQ(0, jsmnf_get_u64(f, writer.buf, &u64));
+    ASSERT(UINT64_MAX == u64);
+    ASSERT((f = jsmnf_find(loader.root, "d", 1)) != NULL);
+    ASSERT_EQ(sizeof(doubles) / sizeof *doubles, f->length);
+    for (i = 0; i < sizeof(doubles) / sizeof *doubles; ++i) {
+        g = f->fields + i;
+        ASSERT_EQ(0, jsmnf_get_double(g, writer.buf, &d));
+        ASSERT_EQ(doubles[i], d);
+    }
+    /* the shortest representation is chosen */
+    ASSERT_STRN_EQ("0.1", writer.buf + f->fields[0].v->start,
+                   f->fields[0].v->end - f->fields[0].v->start);
+    ASSERT_STRN_EQ("5e-324", writer.buf + f->fields[3].v->start,
+                   f->fields[3].v->end - f->fields[3].v->start);
+    ASSERT((f = jsmnf_find(loader.root, "e", 1)) != NULL);
+    ASSERT_EQ(JSMN_OBJECT, f->v->type);
+    ASSERT((f = jsmnf_find(loader.root, "n", 1)) != NULL);
+    ASSERT_STRN_EQ("null", writer.buf + f->v->start, 4);
+
+    jsmnf_writer_free(&writer);
+    ASSERT_EQ(NULL, writer.buf);
+
+    PASS();
+}
+
+TEST
+check_writer_errors(void)
+{
+    jsmnf_writer writer;
+    char buf[16];
+    double zero = 0.0;
+    int i;
+
+    jsmnf_writer_init(&writer, buf, sizeof(buf));
+    jsmnf_writer_begin_array(&writer);
+    jsmnf_writer_string(&writer, "0123456789", 10);
+    ASSERT_EQ(JSMN_ERROR_PART, jsmnf_writer_finish(&writer));
+    ASSERT_EQ(JSMN_ERROR_NOMEM, jsmnf_writer_string(&writer, "abc", 3));
+    /* the first error sticks */
+    ASSERT_EQ(JSMN_ERROR_NOMEM, jsmnf_writer_end_array(&writer));
+    ASSERT_EQ(JSMN_ERROR_NOMEM, jsmnf_writer_finish(&writer));
+
+    jsmnf_writer_init(&writer, buf, sizeof(buf));
+    ASSERT_EQ(JSMN_ERROR_INVAL, jsmnf_writer_end_object(&writer));
+
+    /* closing types must match their containers */
+    jsmnf_writer_init(&writer, buf, sizeof(buf));
+    jsmnf_writer_begin_object(&writer);
+    jsmnf_writer_key(&writer, "a", 1);
+    jsmnf_writer_begin_array(&writer);
+    ASSERT_EQ(0, jsmnf_writer_end_array(&writer));
+    ASSERT_EQ(0, jsmnf_writer_end_object(&writer));
+    ASSERT_EQ(8, jsmnf_writer_finish(&writer));
+    jsmnf_writer_init(&writer, buf, sizeof(buf));
+    jsmnf_writer_begin_array(&writer);
+    ASSERT_EQ(JSMN_ERROR_INVAL, jsmnf_writer_end_object(&writer));
+    ASSERT_EQ(JSMN_ERROR_INVAL, jsmnf_writer_finish(&writer));
+
+    jsmnf_writer_init_auto(&writer, NULL);
+    for (i = 0; i < JSMNF_WRITER_MAX_DEPTH; ++i)
+        ASSERT_EQ(0, jsmnf_writer_begin_array(&writer));
+    ASSERT_EQ(JSMN_ERROR_NOMEM, jsmnf_writer_begin_object(&writer));
+    jsmnf_writer_free(&writer);
+
+    jsmnf_writer_init(&writer, buf, sizeof(buf));
+    ASSERT_EQ(JSMN_ERROR_INVAL, jsmnf_writer_double(&writer, zero / zero));
+    ASSERT_EQ(JSMN_ERROR_INVAL, jsmnf_writer_double(&writer, 1.0 / zero));
+
+    jsmnf_writer_init(&writer, buf, sizeof(buf));
+    jsmnf_writer_i64(&writer, -42);
+    ASSERT_EQ(3, jsmnf_writer_finish(&writer));
+    ASSERT_MEM_EQ("-42", buf, 3);
+
+    PASS();
+}
+
+SUITE(fn__jsmnf_writer)
+{
+    RUN_TEST(check_writer_roundtrip);
+    RUN_TEST(check_writer_errors);
+}
+
+TEST
+check_overlay(void)
+{
+    const char js[] = "{\n  \"a\": 1,\n  \"b\": [1, 2, 3],\n  \"c\": {\"d\": \"x\"},"
+                      "\n  \"e\": null,\n  \"keep\": {\"big\": [1, 2, 3]}\n}";
+    const char expected[] = "{\n  \"a\":42,\n  \"b\": [1,3,9],\n  \"c\": {\"d\": "
+                            "\"x\",\"f\":[true]},\"keep\": {\"big\": [1, 2, 3]},"
+                            "\"z\":\"new\"\n}";
+    const char arr[] = "[true]";
+    jsmnf_table table[64], arr_table[8];
+    jsmnf_loader loader, arr_loader;
+    jsmnf_scalar s42, s9, snew;
+    jsmnf_edit edits[7];
+    jsmnf_overlay overlay;
+    const jsmnf_pair *b, *c, *f;
+    const char *f_js;
+    char buf[256];
+    long ret;
+
+    jsmnf_init(&loader);
+    ASSERT_GT(jsmnf_load(&loader, js, sizeof(js) - 1, table,
+                         sizeof(table) / sizeof *table),
+              0);
+    jsmnf_init(&arr_loader);
+    ASSERT_GT(jsmnf_load(&arr_loader, arr, sizeof(arr) - 1, arr_table,
+                         sizeof(arr_table) / sizeof *arr_table),
+              0);
+    ASSERT(jsmnf_scalar_init(&s42, "42", 2) != NULL);
+    ASSERT(jsmnf_scalar_init(&s9, "9", 1) != NULL);
+    ASSERT(jsmnf_scalar_init(&snew, "\"new\"", 5) != NULL);
+    ASSERT_EQ(NULL, jsmnf_scalar_init(&snew, "[1]", 3));
+    ASSERT(jsmnf_scalar_init(&snew, "\"new\"", 5) != NULL);
+
+    jsmnf_overlay_init(&overlay, loader.root, js, edits,
+                       sizeof(edits) / sizeof *edits);
+    b = jsmnf_find(loader.root, "b", 1);
+    c = jsmnf_find(loader.root, "c", 1);
+    ASSERT_EQ(0, jsmnf_overlay_set(&overlay, loader.root, "a", 1, &s42.pair,
+                                   "42"));
+    ASSERT_EQ(0, jsmnf_overlay_delete(&overlay, b, "1", 1));
+    ASSERT_EQ(0, jsmnf_overlay_append(&overlay, b, &s9.pair, "9"));
+    ASSERT_EQ(0, jsmnf_overlay_insert(&overlay, c, "f", 1, arr_loader.root,
+                                      arr));
+    ASSERT_EQ(0, jsmnf_overlay_delete(&overlay, loader.root, "e", 1));
+    ASSERT_EQ(0, jsmnf_overlay_insert(&overlay, loader.root, "y", 1,
+                                      &s9.pair, "9"));
+    ASSERT_EQ(0, jsmnf_overlay_delete(&overlay, loader.root, "y", 1));
+    ASSERT_EQ(0, jsmnf_overlay_insert(&overlay, loader.root, "z", 1,
+                                      &snew.pair, "\"new\""));
+    ASSERT_EQ(JSMN_ERROR_INVAL, jsmnf_overlay_set(&overlay, loader.root, "e",
+                                                  1, &s9.pair, "9"));
+    ASSERT_EQ(JSMN_ERROR_NOMEM, jsmnf_overlay_append(&overlay, b, &s9.pair,
+                                                     "9"));
+
+    /* the document itself is left untouched */
+    ASSERT(jsmnf_find(loader.root, "e", 1) != NULL);
+    ASSERT_EQ(NULL, jsmnf_overlay_find(&overlay, loader.root, "e", 1, &f_js));
+    ASSERT_EQ(NULL, jsmnf_overlay_find(&overlay, loader.root, "y", 1, &f_js));
+    f_js = js;
+    ASSERT((f = jsmnf_overlay_find(&overlay, loader.root, "a", 1, &f_js))
+           != NULL);
+    ASSERT_STRN_EQ("42", f_js + f->v->start, f->v->end - f->v->start);
+    f_js = js;
+    ASSERT((f = jsmnf_overlay_find(&overlay, b, "1", 1, &f_js)) != NULL);
+    ASSERT_EQ(js, f_js);
+    ASSERT_STRN_EQ("3", f_js + f->v->start, f->v->end - f->v->start);
+    ASSERT((f = jsmnf_overlay_find(&overlay, b, "2", 1, &f_js)) != NULL);
+    ASSERT_STRN_EQ("9", f_js + f->v->start, f->v->end - f->v->start);
+    ASSERT_EQ(NULL, jsmnf_overlay_find(&overlay, b, "3", 1, &f_js));
+    f_js = js;
+    ASSERT((f = jsmnf_overlay_find(&overlay, c, "f", 1, &f_js)) != NULL);
+    ASSERT_EQ(arr, f_js);
+    ASSERT((f = jsmnf_overlay_find(&overlay, f, "0", 1, &f_js)) != NULL);
+    ASSERT_STRN_EQ("true", f_js + f->v->start, f->v->end - f->v->start);
+
+    ASSERT_EQm(print_jsmnerr(ret), (long)sizeof(expected) - 1,
+               ret = jsmnf_overlay_write_buf(&overlay, buf, sizeof(buf)));
+    ASSERT_MEM_EQ(expected, buf, sizeof(expected) - 1);
+    jsmnf_init(&loader);
+    ASSERT_GT(jsmnf_load(&loader, buf, (size_t)ret, table,
+                         sizeof(table) / sizeof *table),
+              0);
+
+    PASS();
+}
+
+SUITE(fn__jsmnf_overlay)
+{
+    RUN_TEST(check_overlay);
+}
+
+struct diff_log {
+    char buf[512];
+    size_t len;
+    int calls;
+    int stop_at;
+};
+
+static int
+diff_log(void *ctx,
+         enum jsmnf_diff_op op,
+         const jsmnf_path *path,
+         const jsmnf_pair *a,
+         const jsmnf_pair *b)
+{
+    static const char ops[] = { '+', '-', '~' };
+    struct diff_log *log = ctx;
+    long ret;
+
+    if (++log->calls == log->stop_at) return -42;
+    if (JSMNF_DIFF_ADD == op && (a || !b)) return -1;
+    if (JSMNF_DIFF_REMOVE == op && (!a || b)) return -1;
+    if (JSMNF_DIFF_CHANGE == op && (!a || !b)) return -1;
+
+    log->buf[log->len++] = ops[op];
+    ret = jsmnf_path_format(path, log->buf + log->len,
+                            sizeof(log->buf) - log->len);
+    if (ret < 0) return (int)ret;
+    log->len += (size_t)ret;
+    log->buf[log->len++] = ' ';
+    log->buf[log->len] = '\0';
+    return 0;
+}
+
+TEST
+check_diff(void)
+{
+    const char a_js[] = "{\"id\":1,\"name\":\"x\",\"tags\":[\"a\",\"b\"],"
+                        "\"same\":{\"deep\":[1,2,3]},\"gone\":true,"
+                        "\"list\":[1,[2,3],4]}";
+    const char b_js[] = "{ \"id\": 1, \"new\": null, \"name\": \"y\", "
+                        "\"tags\": [\"a\", \"b\", \"c\"], \"same\": "
+                        "{\"deep\":[1,2,3]}, \"list\": [1,[2,5]] }";
+    jsmnf_table a_table[64], b_table[64];
+    jsmnf_loader a_loader, b_loader;
+    struct diff_log log;
+    char path[8];
+
+    jsmnf_init(&a_loader);
+    ASSERT_GT(jsmnf_load(&a_loader, a_js, sizeof(a_js) - 1, a_table,
+                         sizeof(a_table) / sizeof *a_table),
+              0);
+    jsmnf_init(&b_loader);
+    ASSERT_GT(jsmnf_load(&b_loader, b_js, sizeof(b_js) - 1, b_table,
+                         sizeof(b_table) / sizeof *b_table),
+              0);
+
+    memset(&log, 0, sizeof(log));
+    ASSERT_EQ(0, jsmnf_diff(a_loader.root, a_js, b_loader.root, b_js,
+                            &diff_log, &log));
+    ASSERT_STR_EQ("~$.name +$.tags[2] -$.gone ~$.list[1][1] -$.list[2] "
+                  "+$.new ",
+                  log.buf);
+
+    /* identical spans are skipped as a whole */
+    memset(&log, 0, sizeof(log));
+    ASSERT_EQ(0, jsmnf_diff(a_loader.root, a_js, a_loader.root, a_js,
+                            &diff_log, &log));
+    ASSERT_EQ(0, log.calls);
+    memset(&log, 0, sizeof(log));
+    ASSERT_EQ(0, jsmnf_diff(jsmnf_find(a_loader.root, "same", 4), a_js,
+                            jsmnf_find(b_loader.root, "same", 4), b_js,
+                            &diff_log, &log));
+    ASSERT_EQ(0, log.calls);
+
+    /* a root of a different type changes as a whole */
+    memset(&log, 0, sizeof(log));
+    ASSERT_EQ(0, jsmnf_diff(a_loader.root, a_js,
+                            jsmnf_find(b_loader.root, "tags", 4), b_js,
+                            &diff_log, &log));
+    ASSERT_STR_EQ("~$ ", log.buf);
+
+    /* the callback stops the walk */
+    memset(&log, 0, sizeof(log));
+    log.stop_at = 2;
+    ASSERT_EQ(-42, jsmnf_diff(a_loader.root, a_js, b_loader.root, b_js,
+                              &diff_log, &log));
+    ASSERT_EQ(2, log.calls);
+
+    ASSERT_EQ(JSMN_ERROR_NOMEM, jsmnf_path_format(NULL, path, 1));
+    ASSERT_EQ(1, jsmnf_path_format(NULL, path, 2));
+    ASSERT_STR_EQ("$", path);
+
+    PASS();
+}
+
+TEST
+check_diff_escaped_keys(void)
+{
+    char a_js[320], b_js[320], keys[320];
+    jsmnf_table a_table[8], b_table[8];
+    jsmnf_loader a_loader, b_loader;
+    struct diff_log log;
+    size_t len = 0;
+
+    /* an escaped key longer than any fixed-size buffer */
+    memcpy(a_js, "{\"\\u0061", 8);
+    len += 8;
+    memset(a_js + len, 'k', 300);
+    len += 300;
+    memcpy(a_js + len, "\":1}", 4);
+    len += 4;
+    memcpy(b_js, a_js, len);
+    b_js[len - 2] = '2';
+
+    jsmnf_init(&a_loader);
+    ASSERT_GT(jsmnf_load(&a_loader, a_js, len, a_table,
+                         sizeof(a_table) / sizeof *a_table),
+              0);
+    jsmnf_init(&b_loader);
+    jsmnf_init_keys(&b_loader, keys, sizeof(keys));
+    ASSERT_GT(jsmnf_load(&b_loader, b_js, len, b_table,
+                         sizeof(b_table) / sizeof *b_table),
+              0);
+
+    /* matched through its unescaped form rather than removed and added */
+    memset(&log, 0, sizeof(log));
+    ASSERT_EQ(0, jsmnf_diff(a_loader.root, a_js, b_loader.root, b_js,
+                            &diff_log, &log));
+    ASSERT_EQ(1, log.calls);
+    ASSERT_EQ('~', log.buf[0]);
+
+    /* without a key arena, in both directions */
+    {
+        const char esc_js[] = "{\"\\u0061\":1}", raw_js[] = "{\"a\":1}";
+
+        jsmnf_init(&a_loader);
+        ASSERT_GT(jsmnf_load(&a_loader, esc_js, sizeof(esc_js) - 1, a_table,
+                             sizeof(a_table) / sizeof *a_table),
+                  0);
+        jsmnf_init(&b_loader);
+        ASSERT_GT(jsmnf_load(&b_loader, raw_js, sizeof(raw_js) - 1, b_table,
+                             sizeof(b_table) / sizeof *b_table),
+                  0);
+        memset(&log, 0, sizeof(log));
+        ASSERT_EQ(0, jsmnf_diff(a_loader.root, esc_js, b_loader.root, raw_js,
+                                &diff_log, &log));
+        ASSERT_EQ(0, log.calls);
+        ASSERT_EQ(0, jsmnf_diff(b_loader.root, raw_js, a_loader.root, esc_js,
+                                &diff_log, &log));
+        ASSERT_EQ(0, log.calls);
+    }
+
+    PASS();
+}
+
+SUITE(fn__jsmnf_diff)
+{
+    RUN_TEST(check_diff);
+    RUN_TEST(check_diff_escaped_keys);
+}
+
+TEST
+check_subtree_hash(void)
+{
+    const char a_js[] = "{\"x\":[1,{\"k\":\"v\",\"n\":null}],\"y\":true}";
+    const char b_js[] = "{ \"y\" : true, \"x\" : [ 1 , "
+                        "{ \"n\":null, \"k\":\"v\" } ] }";
+    const char c_js[] = "[{\"a\":1,\"b\":2},{\"b\":2,\"a\":1},{\"a\":1,"
+                        "\"b\":3},{\"x\":[1,{\"k\":\"v\",\"n\":null}],"
+                        "\"y\":true}]";
+    jsmnf_table a_table[64], b_table[64], c_table[64];
+    jsmnf_loader a_loader, b_loader, c_loader;
+    jsmnf_hashes a_hashes, b_hashes, c_hashes;
+    uint64_t a_values[64], b_values[64], c_values[64];
+    const jsmnf_pair *c0, *c1, *c2, *c3;
+    long a_len, ret;
+
+    jsmnf_init(&a_loader);
+    ASSERT_GT(a_len = jsmnf_load(&a_loader, a_js, sizeof(a_js) - 1, a_table,
+                                 sizeof(a_table) / sizeof *a_table),
+              0);
+    jsmnf_init(&b_loader);
+    ASSERT_GT(jsmnf_load(&b_loader, b_js, sizeof(b_js) - 1, b_table,
+                         sizeof(b_table) / sizeof *b_table),
+              0);
+    jsmnf_init(&c_loader);
+    ASSERT_GT(jsmnf_load(&c_loader, c_js, sizeof(c_js) - 1, c_table,
+                         sizeof(c_table) / sizeof *c_table),
+              0);
+
+    ASSERT_EQ(JSMN_ERROR_NOMEM,
+              jsmnf_hashes_init(&a_hashes, a_loader.root, a_js, a_values, 1));
+    ASSERT_GT(ret = jsmnf_hashes_init(&a_hashes, a_loader.root, a_js,
+                                      a_values, (size_t)a_len),
+              0);
+    ASSERT(ret <= a_len);
+    ASSERT_GT(jsmnf_hashes_init(&b_hashes, b_loader.root, b_js, b_values,
+                                sizeof(b_values) / sizeof *b_values),
+              0);
+    ASSERT_GT(jsmnf_hashes_init(&c_hashes, c_loader.root, c_js, c_values,
+                                sizeof(c_values) / sizeof *c_values),
+              0);
+
+    /* whitespace and member order are ignored */
+    ASSERT(jsmnf_hash(a_loader.root, a_js)
+           == jsmnf_hash(b_loader.root, b_js));
+    ASSERT(jsmnf_hashes_get(&a_hashes, a_loader.root)
+           == jsmnf_hash(a_loader.root, a_js));
+    ASSERT(jsmnf_subtree_equal(&a_hashes, a_loader.root, &b_hashes,
+                               b_loader.root));
+
+    /* repeated sub-documents */
+    c0 = jsmnf_find(c_loader.root, "0", 1);
+    c1 = jsmnf_find(c_loader.root, "1", 1);
+    c2 = jsmnf_find(c_loader.root, "2", 1);
+    c3 = jsmnf_find(c_loader.root, "3", 1);
+    ASSERT(jsmnf_hashes_get(&c_hashes, c0) == jsmnf_hashes_get(&c_hashes, c1));
+    ASSERT(jsmnf_hashes_get(&c_hashes, c0) != jsmnf_hashes_get(&c_hashes, c2));
+    ASSERT(jsmnf_subtree_equal(&c_hashes, c0, &c_hashes, c1));
+    ASSERT_FALSE(jsmnf_subtree_equal(&c_hashes, c0, &c_hashes, c2));
+    ASSERT_FALSE(jsmnf_subtree_equal(&c_hashes, c0, &c_hashes, c3));
+    ASSERT(jsmnf_subtree_equal(&c_hashes, c3, &b_hashes, b_loader.root));
+
+    /* array elements are ordered */
+    ASSERT(jsmnf_hash(jsmnf_find(a_loader.root, "x", 1), a_js)
+           != jsmnf_hash(c_loader.root, c_js));
+    ASSERT_FALSE(jsmnf_subtree_equal(&a_hashes, a_loader.root, &c_hashes,
+                                     c_loader.root));
+
+    PASS();
+}
+
+TEST
+check_subtree_hash_escaped(void)
+{
+    const char a_js[] = "{\"k\\u0065y\":\"v\\u00e9 \\ud83d\\ude00\\/\"}";
+    const char b_js[] = "{\"key\":\"v\xc3\xa9 \xf0\x9f\x98\x80/\"}";
+    const char c_js[] = "{\"key\":\"v\\u00e9 \\ud83d\\ude01/\"}";
+    jsmnf_table a_table[8], b_table[8], c_table[8];
+    jsmnf_loader a_loader, b_loader, c_loader;
+    jsmnf_hashes a_hashes, b_hashes, c_hashes;
+    uint64_t a_values[8], b_values[8], c_values[8];
+
+    jsmnf_init(&a_loader);
+    ASSERT_GT(jsmnf_load(&a_loader, a_js, sizeof(a_js) - 1, a_table,
+                         sizeof(a_table) / sizeof *a_table),
+              0);
+    jsmnf_init(&b_loader);
+    ASSERT_GT(jsmnf_load(&b_loader, b_js, sizeof(b_js) - 1, b_table,
+                         sizeof(b_table) / sizeof *b_table),
+              0);
+    jsmnf_init(&c_loader);
+    ASSERT_GT(jsmnf_load(&c_loader, c_js, sizeof(c_js) - 1, c_table,
+                         sizeof(c_table) / sizeof *c_table),
+              0);
+    ASSERT_GT(jsmnf_hashes_init(&a_hashes, a_loader.root, a_js, a_values,
+                                sizeof(a_values) / sizeof *a_values),
+              0);
+    ASSERT_GT(jsmnf_hashes_init(&b_hashes, b_loader.root, b_js, b_values,
+                                sizeof(b_values) / sizeof *b_values),
+              0);
+    ASSERT_GT(jsmnf_hashes_init(&c_hashes, c_loader.root, c_js, c_values,
+                                sizeof(c_values) / sizeof *c_values),
+              0);
+
+    /* keys and strings are hashed and compared unescaped */
+    ASSERT(jsmnf_hash(a_loader.root, a_js)
+           == jsmnf_hash(b_loader.root, b_js));
+    ASSERT_EQ(1, jsmnf_subtree_equal(&a_hashes, a_loader.root, &b_hashes,
+                                     b_loader.root));
+    ASSERT_EQ(1, jsmnf_subtree_equal(&b_hashes, b_loader.root, &a_hashes,
+                                     a_loader.root));
+    ASSERT(jsmnf_hash(a_loader.root, a_js)
+           != jsmnf_hash(c_loader.root, c_js));
+    ASSERT_EQ(0, jsmnf_subtree_equal(&a_hashes, a_loader.root, &c_hashes,
+                                     c_loader.root));
+
+    PASS();
+}
+
+SUITE(fn__jsmnf_subtree_hash)
+{
+    RUN_TEST(check_subtree_hash);
+    RUN_TEST(check_subtree_hash_escaped);
+}
+
+TEST
+check_transcode(void)
+{
+    const char js[] = "{\"a\":1,\"b\":[true,null,-2,\"\\u00e9\"],\"c\":1.5,"
+                      "\"d\":300,\"e\":-200,\"f\":-100}";
+    const char cbor[] = "\xA6"
+                        "\x61\x61\x01"
+                        "\x61\x62\x84\xF5\xF6\x21\x62\xC3\xA9"
+                        "\x61\x63\xFA\x3F\xC0\x00\x00"
+                        "\x61\x64\x19\x01\x2C"
+                        "\x61\x65\x38\xC7"
+                        "\x61\x66\x38\x63";
+    const char msgpack[] = "\x86"
+                           "\xA1\x61\x01"
+                           "\xA1\x62\x94\xC3\xC0\xFE\xA2\xC3\xA9"
+                           "\xA1\x63\xCA\x3F\xC0\x00\x00"
+                           "\xA1\x64\xCD\x01\x2C"
+                           "\xA1\x65\xD1\xFF\x38"
+                           "\xA1\x66\xD0\x9C";
+    const char big[] = "[18446744073709551615,-9223372036854775809,"
+                       "\"\\u0041\\u0041\\u0041\\u0041\\u0041\",0.1,"
+                       "1e400,-1e400]";
+    const char big_cbor[] = "\x86"
+                            "\x1B\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF"
+                            "\x3B\x80\x00\x00\x00\x00\x00\x00\x00"
+                            "\x65\x41\x41\x41\x41\x41"
+                            "\xFB\x3F\xB9\x99\x99\x99\x99\x99\x9A"
+                            "\xFA\x7F\x80\x00\x00"
+                            "\xFA\xFF\x80\x00\x00";
+    const char big_msgpack[] = "\x96"
+                               "\xCF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF"
+                               "\xCA\xDF\x00\x00\x00"
+                               "\xA5\x41\x41\x41\x41\x41"
+                               "\xCB\x3F\xB9\x99\x99\x99\x99\x99\x9A"
+                               "\xCA\x7F\x80\x00\x00"
+                               "\xCA\xFF\x80\x00\x00";
+    /* escaped strings whose head takes a single byte, and two bytes */
+    const char *const strings[] = {
+        "[\"\\u0041\\u0041\\u0041\\u0041"
+        "\\u0041\\u0041\\u0041\\u0041\"]",
+        "[\"\\u00e9\\u00e9\\u00e9\\u00e9\\u00e9\\u00e9"
+        "\\u00e9\\u00e9\\u00e9\\u00e9\\u00e9\\u00e9\"]"
+    };
+    const long strings_cbor_len[] = { 10, 27 };
+    unsigned i;
+    jsmntok_t tokens[32];
+    jsmnf_table table[32];
+    jsmnf_loader loader;
+    jsmn_parser parser;
+    char buf[64];
+    long ret;
+    int num_tokens;
+
+    jsmnf_init(&loader);
+    ASSERT_GT(jsmnf_load(&loader, js, sizeof(js) - 1, table,
+                         sizeof(table) / sizeof *table),
+              0);
+    ASSERT_EQm(print_jsmnerr(ret), (long)sizeof(cbor) - 1,
+               ret = jsmnf_transcode(loader.root, js, JSMNF_TRANSCODE_CBOR,
+                                     buf, sizeof(buf)));
+    ASSERT_MEM_EQ(cbor, buf, sizeof(cbor) - 1);
+    ASSERT_EQm(print_jsmnerr(ret), (long)sizeof(msgpack) - 1,
+               ret = jsmnf_transcode(loader.root, js,
+                                     JSMNF_TRANSCODE_MSGPACK, buf,
+                                     sizeof(buf)));
+    ASSERT_MEM_EQ(msgpack, buf, sizeof(msgpack) - 1);
+    ASSERT_EQ(JSMN_ERROR_NOMEM,
+              jsmnf_transcode(loader.root, js, JSMNF_TRANSCODE_CBOR, buf,
+                              sizeof(cbor) - 2));
+
+    /* straight from the tokens */
+    jsmn_init(&parser);
+    ASSERT_GT(num_tokens = jsmn_parse(&parser, js, sizeof(js) - 1, tokens,
+                                      sizeof(tokens) / sizeof *tokens),
+              0);
+    ASSERT_EQm(print_jsmnerr(ret), (long)sizeof(cbor) - 1,
+               ret = jsmnf_transcode_tokens(js, tokens, (unsigned)num_tokens,
+                                            JSMNF_TRANSCODE_CBOR, buf,
+                                            sizeof(buf)));
+    ASSERT_MEM_EQ(cbor, buf, sizeof(cbor) - 1);
+    ASSERT_EQ(JSMN_ERROR_PART,
+              jsmnf_transcode_tokens(js, tokens, (unsigned)num_tokens - 1,
+                                     JSMNF_TRANSCODE_MSGPACK, buf,
+                                     sizeof(buf)));
+
+    /* integers out of range and shrinking escaped strings */
+    jsmnf_init(&loader);
+    ASSERT_GT(jsmnf_load(&loader, big, sizeof(big) - 1, table,
+                         sizeof(table) / sizeof *table),
+              0);
+    ASSERT_EQm(print_jsmnerr(ret), (long)sizeof(big_cbor) - 1,
+               ret = jsmnf_transcode(loader.root, big, JSMNF_TRANSCODE_CBOR,
+                                     buf, sizeof(buf)));
+    ASSERT_MEM_EQ(big_cbor, buf, sizeof(big_cbor) - 1);
+    ASSERT_EQm(print_jsmnerr(ret), (long)sizeof(big_msgpack) - 1,
+               ret = jsmnf_transcode(loader.root, big,
+                                     JSMNF_TRANSCODE_MSGPACK, buf,
+                                     sizeof(buf)));
+    ASSERT_MEM_EQ(big_msgpack, buf, sizeof(big_msgpack) - 1);
+
+    /* escaped strings fit a buffer of the exact output size */
+    for (i = 0; i < sizeof(strings) / sizeof *strings; ++i) {
+        const size_t len = strlen(strings[i]);
+
+        jsmnf_init(&loader);
+        ASSERT_GT(jsmnf_load(&loader, strings[i], len, table,
+                             sizeof(table) / sizeof *table),
+                  0);
+        ASSERT_EQm(print_jsmnerr(ret), strings_cbor_len[i],
+                   ret = jsmnf_transcode(loader.root, strings[i],
+                                         JSMNF_TRANSCODE_CBOR, buf,
+                                         (size_t)strings_cbor_len[i]));
+        ASSERT_EQ(JSMN_ERROR_NOMEM,
+                  jsmnf_transcode(loader.root, strings[i],
+                                  JSMNF_TRANSCODE_CBOR, buf,
+                                  (size_t)strings_cbor_len[i] - 1));
+    }
+
+    PASS();
+}
+
+SUITE(fn__jsmnf_transcode)
+{
+    RUN_TEST(check_transcode);
+}
+
 GREATEST_MAIN_DEFS();
 
 int
@@ -508,9 +2782,24 @@ main(int argc, char *argv[])
 
     RUN_SUITE(fn__jsmnf_load_auto);
     RUN_SUITE(fn__jsmnf_unescape);
+    RUN_SUITE(fn__jsmnf_utf8_validate);
     RUN_SUITE(fn__jsmnf_load);
+    RUN_SUITE(fn__jsmnf_load_projected);
     RUN_SUITE(fn__jsmnf_find);
     RUN_SUITE(fn__jsmnf_find_path);
+    RUN_SUITE(fn__jsmnf_query);
+    RUN_SUITE(fn__jsmnf_cursor);
+    RUN_SUITE(fn__jsmnf_get);
+    RUN_SUITE(fn__jsmnf_array_to);
+    RUN_SUITE(fn__jsmnf_compact);
+    RUN_SUITE(fn__jsmnf_doc);
+    RUN_SUITE(fn__jsmnf_clone_subtree);
+    RUN_SUITE(fn__jsmnf_write);
+    RUN_SUITE(fn__jsmnf_writer);
+    RUN_SUITE(fn__jsmnf_overlay);
+    RUN_SUITE(fn__jsmnf_diff);
+    RUN_SUITE(fn__jsmnf_subtree_hash);
+    RUN_SUITE(fn__jsmnf_transcode);
 
     GREATEST_MAIN_END();
 }